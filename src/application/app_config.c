@@ -0,0 +1,247 @@
+/**
+ * @file app_config.c
+ * @brief Runtime configuration backed by the settings subsystem.
+ *
+ * Values are stored under "cfg/<key>". They are loaded once by settings_load() into a staging
+ * copy which is published on commit. Later updates (the NUS "cfg" command, executed by the
+ * main loop) are published and then persisted from the calling thread.
+ *
+ * The active configuration is guarded by a sequence counter: the writer makes it odd while it
+ * copies a new configuration, and readers retry their copy if the counter was odd or changed.
+ * The writer holds a spinlock meanwhile, so a reader can never preempt it in the middle of an
+ * update and spin.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/settings/settings.h>
+
+#include "app_config.h"
+
+#define DEFAULT_CONFIG {                                    \
+    .sample_interval_ms = CONFIG_APP_SAMPLE_INTERVAL_MS,    \
+    .r1_ohm             = CONFIG_APP_R1_OHM,                \
+    .r2_ohm             = CONFIG_APP_R2_OHM,                \
+    .max_samples        = CONFIG_APP_MAX_SAMPLES,           \
+    .settle_us          = CONFIG_APP_SETTLE_US,             \
+    .cell_low_cv        = CONFIG_APP_CELL_LOW_CV,           \
+    .cell_high_cv       = CONFIG_APP_CELL_HIGH_CV,          \
+    .imbalance_cv       = CONFIG_APP_IMBALANCE_CV,          \
+    .temp_high_dc       = CONFIG_APP_TEMP_HIGH_DC,          \
+}
+
+/**
+ * @brief Description of a single tunable.
+ */
+struct config_key {
+    const char *name; ///< Name used in settings and commands
+    size_t offset;    ///< Offset of the field in struct app_config
+    size_t size;      ///< Size of the field in bytes (2 or 4)
+    uint32_t min;     ///< Smallest accepted value
+    uint32_t max;     ///< Largest accepted value
+};
+
+#define CFG_KEY(_name, _field, _min, _max) {                     \
+    .name   = _name,                                             \
+    .offset = offsetof(struct app_config, _field),               \
+    .size   = sizeof(((struct app_config *)0)->_field),          \
+    .min    = _min,                                              \
+    .max    = _max,                                              \
+}
+
+static const struct config_key config_keys[] = {
+    CFG_KEY("interval",  sample_interval_ms, 10, 3600000),
+    CFG_KEY("r1",        r1_ohm,             1,  10000000),
+    CFG_KEY("r2",        r2_ohm,             1,  10000000),
+    CFG_KEY("samples",   max_samples,        1,  CONFIG_APP_MAX_SAMPLES),
+    CFG_KEY("settle",    settle_us,          0,  10000),
+    CFG_KEY("cell_low",  cell_low_cv,        0,  UINT16_MAX),
+    CFG_KEY("cell_high", cell_high_cv,       0,  UINT16_MAX),
+    CFG_KEY("imbalance", imbalance_cv,       0,  UINT16_MAX),
+    CFG_KEY("temp_high", temp_high_dc,       0,  1250),
+};
+
+// Active configuration and its sequence counter, odd while an update is in progress.
+static struct app_config active = DEFAULT_CONFIG;
+static atomic_t active_seq;
+static struct k_spinlock active_lock;
+
+// Values read by settings_load(), published on commit.
+static struct app_config staging = DEFAULT_CONFIG;
+
+// Serializes writers and protects staging, readers never take it.
+static K_MUTEX_DEFINE(config_lock);
+
+static const struct config_key *find_key(const char *name)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(config_keys); i++) {
+        if (strcmp(config_keys[i].name, name) == 0) {
+            return &config_keys[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t read_field(const struct app_config *cfg, const struct config_key *key)
+{
+    const uint8_t *field = (const uint8_t *)cfg + key->offset;
+
+    if (key->size == sizeof(uint16_t)) {
+        return *(const uint16_t *)field;
+    }
+    return *(const uint32_t *)field;
+}
+
+static void write_field(struct app_config *cfg, const struct config_key *key, uint32_t value)
+{
+    uint8_t *field = (uint8_t *)cfg + key->offset;
+
+    if (key->size == sizeof(uint16_t)) {
+        *(uint16_t *)field = (uint16_t)value;
+    } else {
+        *(uint32_t *)field = value;
+    }
+}
+
+/**
+ * @brief Publish a new configuration.
+ *
+ * Must be called with config_lock held.
+ */
+static void publish(const struct app_config *next)
+{
+    k_spinlock_key_t key = k_spin_lock(&active_lock);
+
+    atomic_inc(&active_seq);
+    active = *next;
+    atomic_inc(&active_seq);
+    k_spin_unlock(&active_lock, key);
+}
+
+void app_config_read(struct app_config *cfg)
+{
+    atomic_val_t seq;
+
+    do {
+        seq = atomic_get(&active_seq);
+        *cfg = active;
+    } while ((seq & 1) || atomic_get(&active_seq) != seq);
+}
+
+/**
+ * @brief Settings handler for a single "cfg/<key>" entry read from storage.
+ */
+static int config_settings_set(const char *name, size_t len,
+                               settings_read_cb read_cb, void *cb_arg)
+{
+    const struct config_key *key = find_key(name);
+    uint32_t value;
+    int rc;
+
+    if (key == NULL) {
+        return -ENOENT;
+    }
+    if (len != key->size) {
+        return -EINVAL;
+    }
+
+    if (key->size == sizeof(uint16_t)) {
+        uint16_t value16;
+
+        rc = read_cb(cb_arg, &value16, sizeof(value16));
+        value = value16;
+    } else {
+        rc = read_cb(cb_arg, &value, sizeof(value));
+    }
+    if (rc < 0) {
+        return rc;
+    }
+    if (value < key->min || value > key->max) {
+        printk("Ignoring stored cfg/%s=%u (out of range)\n", name, value);
+        return 0;
+    }
+
+    write_field(&staging, key, value);
+    return 0;
+}
+
+/**
+ * @brief Settings commit handler, publishes the values loaded from storage.
+ */
+static int config_settings_commit(void)
+{
+    k_mutex_lock(&config_lock, K_FOREVER);
+    publish(&staging);
+    k_mutex_unlock(&config_lock);
+
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(app_cfg, "cfg", NULL, config_settings_set,
+                               config_settings_commit, NULL);
+
+int app_config_set(const char *name, uint32_t value)
+{
+    const struct config_key *key = find_key(name);
+    struct app_config next;
+    char path[24];
+    int rc;
+
+    if (key == NULL) {
+        return -ENOENT;
+    }
+    if (value < key->min || value > key->max) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&config_lock, K_FOREVER);
+    app_config_read(&next);
+    write_field(&next, key, value);
+    publish(&next);
+    staging = next;
+    k_mutex_unlock(&config_lock);
+
+    snprintf(path, sizeof(path), "cfg/%s", key->name);
+    if (key->size == sizeof(uint16_t)) {
+        uint16_t value16 = (uint16_t)value;
+
+        rc = settings_save_one(path, &value16, sizeof(value16));
+    } else {
+        rc = settings_save_one(path, &value, sizeof(value));
+    }
+    if (rc) {
+        printk("Failed to persist %s (err %d)\n", path, rc);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int app_config_format(char *buf, size_t buf_size)
+{
+    struct app_config cfg;
+    size_t offset = 0;
+
+    if (buf == NULL || buf_size == 0) {
+        return -EINVAL;
+    }
+    buf[0] = '\0';
+    app_config_read(&cfg);
+
+    for (size_t i = 0; i < ARRAY_SIZE(config_keys); i++) {
+        int written = snprintf(buf + offset, buf_size - offset, "%s%s=%u",
+                               i ? " " : "", config_keys[i].name,
+                               read_field(&cfg, &config_keys[i]));
+
+        if (written < 0 || (size_t)written >= buf_size - offset) {
+            return -ENOMEM;
+        }
+        offset += written;
+    }
+
+    return offset;
+}
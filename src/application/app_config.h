@@ -0,0 +1,75 @@
+/**
+ * @file app_config.h
+ * @brief Runtime configuration of the battery monitor.
+ *
+ * The tunables are persisted through the settings subsystem under the "cfg" subtree. Readers
+ * copy the whole configuration with app_config_read(), which never blocks and always returns
+ * a consistent set of values, even across concurrent updates.
+ */
+
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+/** @brief Alignment of a configuration snapshot, one cache line. */
+#define APP_CONFIG_ALIGN 32
+
+/**
+ * @brief Configuration values.
+ */
+struct app_config {
+    uint32_t sample_interval_ms; ///< Delay between two scans in milliseconds
+    uint32_t r1_ohm;             ///< Voltage divider resistor R1 (in ohms)
+    uint32_t r2_ohm;             ///< Voltage divider resistor R2 (in ohms)
+    uint16_t max_samples;        ///< Number of buffered samples before the buffer is full
+    uint16_t settle_us;          ///< Multiplexer settling time in microseconds
+    uint16_t cell_low_cv;        ///< Battery undervoltage alarm threshold in cV
+    uint16_t cell_high_cv;       ///< Battery overvoltage alarm threshold in cV
+    uint16_t imbalance_cv;       ///< Battery imbalance alarm threshold in cV
+    uint16_t temp_high_dc;       ///< Overtemperature alarm threshold in 1/10 °C
+} __aligned(APP_CONFIG_ALIGN);
+
+/**
+ * @brief Copy the active configuration.
+ *
+ * Retries the copy if an update ran concurrently, so all values come from the same update.
+ * Callers copy it once per scan rather than per value.
+ *
+ * @param cfg Destination for the configuration.
+ */
+void app_config_read(struct app_config *cfg);
+
+/**
+ * @brief Update a single configuration value and persist it.
+ *
+ * Persisting writes to flash: call it from the main loop (where NUS commands run), not from
+ * the Bluetooth RX thread.
+ *
+ * @param key Name of the value, e.g. "interval" (see app_config.c for the list).
+ * @param value New value.
+ * @return 0 on success, -ENOENT for an unknown key, -EINVAL for an out-of-range value, or
+ *         -EIO if the value is applied but could not be persisted.
+ */
+int app_config_set(const char *key, uint32_t value);
+
+/**
+ * @brief Print the active configuration into a buffer as "key=value" pairs.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int app_config_format(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APP_CONFIG_H */
@@ -2,11 +2,111 @@
 #include "../bluetooth/bluetooth.h"
 #include <zephyr/kernel.h>
 #include <zephyr/sys/printk.h>
+#include <errno.h>
 #include <stdint.h>
 #include "../bluetooth/service.h"
 #include "../sensor/main_voltage.h"
 #include "../sensor/internal_temp.h"
+#include "../sensor/radio_quiet.h"
 #include "../hardware/led.h"
+#include "app_config.h"
+#include "../gateway/gateway.h"
+#include "../gateway/observer.h"
+#include "../output/usb_export.h"
+#include "../output/uart_stream.h"
+#include "../output/modbus_server.h"
+#include "../output/can_output.h"
+#include "../bluetooth/long_range.h"
+#include "../bluetooth/dfu_fast.h"
+#include "command.h"
+#include "../sensor/on_demand.h"
+
+/** @brief Events of the main loop, in the order they are handled. */
+enum app_event {
+    EVENT_SAMPLE,    ///< Sampling interval elapsed
+    EVENT_SCAN,      ///< Step of the scan in progress ended (settling or conversion)
+    EVENT_COMMAND,   ///< Command line received
+    EVENT_TRANSFER,  ///< Samples to transfer, or a client to transfer them to
+    EVENT_COUNT,
+};
+
+static struct k_poll_signal sample_signal = K_POLL_SIGNAL_INITIALIZER(sample_signal);
+static struct k_poll_signal scan_signal = K_POLL_SIGNAL_INITIALIZER(scan_signal);
+static struct k_poll_signal transfer_signal = K_POLL_SIGNAL_INITIALIZER(transfer_signal);
+
+static void sample_timer_expiry(struct k_timer *timer)
+{
+    k_poll_signal_raise(&sample_signal, 0);
+}
+
+static K_TIMER_DEFINE(sample_timer, sample_timer_expiry, NULL);
+
+void application_request_transfer(void)
+{
+    k_poll_signal_raise(&transfer_signal, 0);
+}
+
+void application_request_scan(void)
+{
+    k_poll_signal_raise(&sample_signal, 0);
+}
+
+/**
+ * @brief Handle the end of a scan, completed or aborted.
+ */
+static void scan_ended(void)
+{
+    application_request_transfer();
+
+    if (IS_ENABLED(CONFIG_APP_ON_DEMAND)) {
+        on_demand_scan_ended();
+    }
+}
+
+/**
+ * @brief Check whether a signal event fired, and re-arm it.
+ *
+ * @param event The event.
+ * @param result Destination for the result of the signal, may be NULL.
+ * @return true if the signal was raised.
+ */
+static bool signal_consume(struct k_poll_event *event, int *result)
+{
+    unsigned int signaled;
+    int value;
+
+    if (event->state != K_POLL_STATE_SIGNALED) {
+        return false;
+    }
+
+    k_poll_signal_check(event->signal, &signaled, &value);
+    k_poll_signal_reset(event->signal);
+    event->state = K_POLL_STATE_NOT_READY;
+    if (result != NULL) {
+        *result = value;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Check whether the step of the scan in progress ended, and re-arm the event.
+ *
+ * @param event The event, see sample_scan_poll_event_init().
+ * @param result Destination for the result of the step.
+ * @return true if the step ended.
+ */
+static bool scan_event_consume(struct k_poll_event *event, int *result)
+{
+    // The pack monitor read ends in its completion queue, taken by sample_scan_continue()
+    if (event->state == K_POLL_STATE_SEM_AVAILABLE) {
+        event->state = K_POLL_STATE_NOT_READY;
+        *result = 0;
+        return true;
+    }
+
+    return signal_consume(event, result);
+}
 
 /**
  * @brief Main application loop to initialize peripherals and run the core functionality.
@@ -14,10 +114,12 @@
  * This function performs the following steps:
  * - Initializes GPIO pins (e.g., LEDs).
  * - Initializes Bluetooth functionality and starts advertising.
+ * - In gateway builds, starts collecting the scans or broadcast telemetry of other monitors.
  * - Sets up the ADC for voltage sensing.
  * - Initializes the internal temperature sensor.
- * - Continuously reads the internal temperature, sends the temperature data over Bluetooth, 
- *   and introduces a 1-second delay between iterations.
+ * - Waits in k_poll() for the next event and handles it as soon as it arrives: sampling
+ *   interval (start a scan), end of a settling time or ADC conversion (next scan step),
+ *   command lines, and samples ready to transfer. The thread idles in the kernel in between.
  */
 void run_application()
 {
@@ -28,24 +130,112 @@ void run_application()
     bluetooth_init();
     bluetooth_start_advertising();
 
+    // Advertise on the Coded PHY as well in the long range profile
+    if (IS_ENABLED(CONFIG_APP_CODED_PHY)) {
+        long_range_init();
+    }
+
+    // Speed up the links while a firmware image is uploaded
+    if (IS_ENABLED(CONFIG_APP_DFU_FAST)) {
+        dfu_fast_init();
+    }
+
+    // Connect to other monitors when built as a gateway
+    if (IS_ENABLED(CONFIG_APP_GATEWAY)) {
+        gateway_init();
+    }
+
+    // Collect the telemetry broadcast by other monitors when built as an observer gateway
+    if (IS_ENABLED(CONFIG_APP_GATEWAY_OBSERVER)) {
+        observer_init();
+    }
+
     // Initialize ADC for voltage measurement
     init_adc();
 
+    // Keep the conversions out of the radio events
+    if (IS_ENABLED(CONFIG_APP_RADIO_QUIET)) {
+        radio_quiet_init();
+    }
+
     // Initialize internal temperature sensor
     init_temp();
 
     flash_init();
 
-    // Main loop: Read and send temperature data over Bluetooth
-    for (;;) 
-    {
-        //int32_t temp = read_temperature_int();  // Read the temperature in integer format
-        //bt_send_temp(temp);                    // Send temperature data over Bluetooth
-        //load_samples_from_nvs();
-        //flash_init();
-        //nvs_debug();
-        store_sample_nvs();
-        attempt_send();
-        k_sleep(K_MSEC(1000));                 // Wait for 1 second
+    // Export the storage log over USB once it is mounted
+    if (IS_ENABLED(CONFIG_APP_USB_EXPORT)) {
+        usb_export_init();
+    }
+
+    // Stream every scan on the wired telemetry UART
+    if (IS_ENABLED(CONFIG_APP_UART_STREAM)) {
+        uart_stream_init();
+    }
+
+    // Serve the latest scan to Modbus clients
+    if (IS_ENABLED(CONFIG_APP_MODBUS)) {
+        modbus_server_init();
+    }
+
+    // Send the CAN telemetry frames
+    if (IS_ENABLED(CONFIG_APP_CAN_OUTPUT)) {
+        can_output_init();
+    }
+
+    struct k_poll_event events[EVENT_COUNT] = {
+        [EVENT_SAMPLE] = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY,
+                                                  &sample_signal),
+        [EVENT_TRANSFER] = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY,
+                                                    &transfer_signal),
+    };
+    struct app_config cfg;
+    uint32_t interval_ms;
+    int result;
+    int err;
+
+    app_config_read(&cfg);
+    interval_ms = cfg.sample_interval_ms;
+
+    sample_scan_poll_event_init(&events[EVENT_SCAN], &scan_signal);
+    command_poll_event_init(&events[EVENT_COMMAND]);
+
+    // First scan right away, then one per sampling interval. On demand, client reads scan
+    if (!IS_ENABLED(CONFIG_APP_ON_DEMAND)) {
+        k_timer_start(&sample_timer, K_NO_WAIT, K_MSEC(interval_ms));
+    }
+
+    // Main loop: handle every event as soon as it arrives
+    for (;;) {
+        k_poll(events, ARRAY_SIZE(events), K_FOREVER);
+
+        // A scan still running when the interval elapses (interval shorter than a scan) skips it
+        if (signal_consume(&events[EVENT_SAMPLE], NULL)) {
+            err = sample_scan_start(&scan_signal);
+            // A scan that could not start has ended, on demand readers get their reply
+            if (err && err != -EBUSY) {
+                scan_ended();
+            }
+        }
+
+        if (scan_event_consume(&events[EVENT_SCAN], &result) && sample_scan_continue(result)) {
+            scan_ended();
+        }
+
+        if (events[EVENT_COMMAND].state == K_POLL_STATE_MSGQ_DATA_AVAILABLE) {
+            events[EVENT_COMMAND].state = K_POLL_STATE_NOT_READY;
+            command_process();
+
+            // "cfg interval <ms>" takes effect now, not after the old interval
+            app_config_read(&cfg);
+            if (!IS_ENABLED(CONFIG_APP_ON_DEMAND) && cfg.sample_interval_ms != interval_ms) {
+                interval_ms = cfg.sample_interval_ms;
+                k_timer_start(&sample_timer, K_MSEC(interval_ms), K_MSEC(interval_ms));
+            }
+        }
+
+        if (signal_consume(&events[EVENT_TRANSFER], NULL)) {
+            attempt_send();
+        }
     }
 }
@@ -4,4 +4,18 @@
 // Function Prototypes
 void run_application(void);
 
+/**
+ * @brief Ask the main loop to transfer the stored samples.
+ *
+ * Safe to call from any context.
+ */
+void application_request_transfer(void);
+
+/**
+ * @brief Ask the main loop to start a scan, if none is running.
+ *
+ * Safe to call from any context.
+ */
+void application_request_scan(void);
+
 #endif // APPLICATION_H
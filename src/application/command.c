@@ -0,0 +1,502 @@
+/**
+ * @file command.c
+ * @brief Dispatcher for text commands received over NUS.
+ *
+ * Supported commands:
+ * - "cfg": print the active configuration.
+ * - "cfg <key> <value>": update and persist a configuration value.
+ * - "time": print the current time and the estimated RTC drift.
+ * - "time <ms>": synchronize to a wall-clock time in milliseconds since the Unix epoch.
+ * - "gw": print the gateway status (gateway builds only).
+ * - "obs": print the observer counters (observer gateway builds only).
+ * - "uart": print the UART stream counters (UART stream builds only).
+ * - "reconn": print the reconnection counters and times.
+ * - "adv": print the advertising interval and the estimated radio on-time.
+ * - "txp": print the TX power and RSSI of each connection.
+ * - "can": print the CAN frame rate and queueing latency since the last "can" (CAN builds only).
+ * - "notify": print the batching, airtime efficiency and latency of each subscriber.
+ * - "hist [from]": send the storage log to this client, from sequence number "from" (default:
+ *   the oldest sample).
+ * - "share <n>": set the bandwidth share of this client, 1 to CONFIG_APP_BW_SCHED_MAX_SHARE.
+ * - "bw": print the throughput and queueing delay of each client and stream class.
+ * - "buf": print the notification outcomes and the usage of each buffer pool.
+ * - "buf prof <s>": profile the buffer pools for s seconds.
+ * - "buf rec": print the buffer sizes recommended by the last profile.
+ * - "dfu": print the throughput and flash write time of the last firmware upload.
+ * - "scan": reply with a fresh scan (on-demand builds only).
+ * - "scan stat": print the on-demand request counters.
+ * - "quiet [on|off]": print the ADC noise with the radio-quiet placement on and off, or switch it.
+ *
+ * Command lines are queued by the Bluetooth RX thread and executed by the main loop.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/conn.h>
+#include <bluetooth/services/nus.h>
+
+#include "command.h"
+#include "app_config.h"
+#include "time_sync.h"
+#include "../gateway/gateway.h"
+#include "../gateway/observer.h"
+#include "../output/uart_stream.h"
+#include "../output/can_output.h"
+#include "../bluetooth/reconnect.h"
+#include "../bluetooth/adv_sched.h"
+#include "../bluetooth/tx_power.h"
+#include "../bluetooth/notify_sched.h"
+#include "../bluetooth/bw_sched.h"
+#include "../bluetooth/history_pull.h"
+#include "../bluetooth/buf_stats.h"
+#include "../bluetooth/dfu_fast.h"
+#include "../sensor/radio_quiet.h"
+#include "../sensor/on_demand.h"
+
+/**
+ * @brief Entry of the command table.
+ */
+struct command {
+    const char *name;                 ///< First word of the command line
+    void (*handler)(char *args);      ///< Handler, receives the rest of the line
+};
+
+#define COMMAND_QUEUE_LEN 4
+
+/**
+ * @brief Command line waiting for the main loop.
+ */
+struct command_msg {
+    struct bt_conn *conn;             ///< Client, referenced while queued
+    uint8_t len;
+    uint8_t line[COMMAND_MAX_LEN];
+};
+
+K_MSGQ_DEFINE(command_queue, sizeof(struct command_msg), COMMAND_QUEUE_LEN, 4);
+
+static struct bt_conn *requester;
+
+struct bt_conn *command_conn(void)
+{
+    return requester;
+}
+
+void command_reply(const char *text)
+{
+    int err = bt_nus_send(requester, text, strlen(text));
+
+    if (IS_ENABLED(CONFIG_APP_BUF_STATS)) {
+        buf_stats_tx(requester, strlen(text), err);
+    }
+
+    if (err) {
+        printk("Reply failed (err %d): %s\n", err, text);
+    }
+}
+
+/**
+ * @brief Handle "cfg" and "cfg <key> <value>".
+ */
+static void cmd_cfg(char *args)
+{
+    char reply[160];
+    char *value;
+    int err;
+
+    if (*args == '\0') {
+        err = app_config_format(reply, sizeof(reply));
+        command_reply(err < 0 ? "cfg: error\n" : reply);
+        return;
+    }
+
+    value = strchr(args, ' ');
+    if (value == NULL) {
+        command_reply("usage: cfg <key> <value>\n");
+        return;
+    }
+    *value++ = '\0';
+
+    err = app_config_set(args, strtoul(value, NULL, 0));
+    snprintf(reply, sizeof(reply), "cfg %s: %s\n", args,
+             err == 0 ? "ok" :
+             err == -ENOENT ? "unknown key" :
+             err == -EIO ? "applied, not persisted" : "out of range");
+    command_reply(reply);
+}
+
+/**
+ * @brief Handle "time" and "time <ms>".
+ */
+static void cmd_time(char *args)
+{
+    char reply[64];
+
+    if (*args != '\0' && time_sync_set(strtoll(args, NULL, 10))) {
+        command_reply("time: invalid\n");
+        return;
+    }
+
+    snprintf(reply, sizeof(reply), "time %lld %s drift %d ppb\n", time_sync_now_ms(),
+             time_sync_is_synced() ? "synced" : "uptime", time_sync_drift_ppb());
+    command_reply(reply);
+}
+
+#if defined(CONFIG_APP_GATEWAY)
+/**
+ * @brief Handle "gw".
+ */
+static void cmd_gw(char *args)
+{
+    char reply[80];
+
+    if (gateway_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_GATEWAY_OBSERVER)
+/**
+ * @brief Handle "obs".
+ */
+static void cmd_obs(char *args)
+{
+    char reply[80];
+
+    if (observer_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_UART_STREAM)
+/**
+ * @brief Handle "uart".
+ */
+static void cmd_uart(char *args)
+{
+    struct uart_stream_stats stats;
+    char reply[64];
+
+    uart_stream_stats_get(&stats);
+    snprintf(reply, sizeof(reply), "uart frames %u dropped %u transfers %u\n",
+             stats.frames, stats.dropped, stats.transfers);
+    command_reply(reply);
+}
+#endif
+
+#if defined(CONFIG_APP_RECONNECT)
+/**
+ * @brief Handle "reconn".
+ */
+static void cmd_reconn(char *args)
+{
+    char reply[96];
+
+    if (reconnect_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_ADV_SCHED)
+/**
+ * @brief Handle "adv".
+ */
+static void cmd_adv(char *args)
+{
+    char reply[96];
+
+    if (adv_sched_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_TX_POWER_CTRL)
+/**
+ * @brief Handle "txp".
+ */
+static void cmd_txp(char *args)
+{
+    char reply[160];
+
+    if (tx_power_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_CAN_OUTPUT)
+/**
+ * @brief Handle "can".
+ */
+static void cmd_can(char *args)
+{
+    char reply[96];
+
+    if (can_output_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_NOTIFY_SCHED)
+/**
+ * @brief Handle "notify".
+ */
+static void cmd_notify(char *args)
+{
+    char reply[192];
+
+    if (notify_sched_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_BW_SCHED)
+/**
+ * @brief Handle "hist" and "hist <from>".
+ */
+static void cmd_hist(char *args)
+{
+    char reply[48];
+    int err = history_pull_start(command_conn(), strtoul(args, NULL, 10));
+
+    if (err) {
+        snprintf(reply, sizeof(reply), "hist: failed (err %d)\n", err);
+        command_reply(reply);
+    }
+}
+
+/**
+ * @brief Handle "share <n>".
+ */
+static void cmd_share(char *args)
+{
+    if (bw_sched_set_share(command_conn(), strtoul(args, NULL, 10))) {
+        command_reply("share: invalid\n");
+        return;
+    }
+
+    command_reply("share: ok\n");
+}
+
+/**
+ * @brief Handle "bw".
+ */
+static void cmd_bw(char *args)
+{
+    char reply[192];
+
+    if (bw_sched_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_DFU_FAST)
+/**
+ * @brief Handle "dfu".
+ */
+static void cmd_dfu(char *args)
+{
+    char reply[96];
+
+    if (dfu_fast_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_ON_DEMAND)
+/**
+ * @brief Handle "scan" and "scan stat".
+ */
+static void cmd_scan(char *args)
+{
+    char reply[80];
+
+    if (strcmp(args, "stat") == 0) {
+        if (on_demand_format_status(reply, sizeof(reply)) > 0) {
+            command_reply(reply);
+        }
+        return;
+    }
+
+    on_demand_reply(command_conn());
+}
+#endif
+
+#if defined(CONFIG_APP_BUF_STATS)
+/**
+ * @brief Handle "buf", "buf prof <s>" and "buf rec".
+ */
+static void cmd_buf(char *args)
+{
+    bool recommend = strcmp(args, "rec") == 0;
+    char reply[96];
+
+    if (strncmp(args, "prof", 4) == 0) {
+        if (buf_stats_profile_start(strtoul(args + 4, NULL, 10))) {
+            command_reply("buf: invalid duration\n");
+            return;
+        }
+        command_reply("buf: profiling\n");
+        return;
+    }
+
+    if (!recommend && buf_stats_format_tx(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+
+    // One reply per pool, the whole list does not fit in a notification
+    for (size_t i = 0; buf_stats_format_pool(i, recommend, reply, sizeof(reply)) != -ENOENT; i++) {
+        command_reply(reply);
+    }
+}
+#endif
+
+#if defined(CONFIG_APP_RADIO_QUIET)
+/**
+ * @brief Handle "quiet" and "quiet on|off".
+ */
+static void cmd_quiet(char *args)
+{
+    char reply[160];
+
+    if (strcmp(args, "on") == 0) {
+        radio_quiet_set_enabled(true);
+    } else if (strcmp(args, "off") == 0) {
+        radio_quiet_set_enabled(false);
+    } else if (*args != '\0') {
+        command_reply("quiet: invalid\n");
+        return;
+    }
+
+    if (radio_quiet_format_status(reply, sizeof(reply)) > 0) {
+        command_reply(reply);
+    }
+}
+#endif
+
+static const struct command commands[] = {
+    { "cfg",  cmd_cfg },
+    { "time", cmd_time },
+#if defined(CONFIG_APP_GATEWAY)
+    { "gw",   cmd_gw },
+#endif
+#if defined(CONFIG_APP_GATEWAY_OBSERVER)
+    { "obs",  cmd_obs },
+#endif
+#if defined(CONFIG_APP_UART_STREAM)
+    { "uart", cmd_uart },
+#endif
+#if defined(CONFIG_APP_RECONNECT)
+    { "reconn", cmd_reconn },
+#endif
+#if defined(CONFIG_APP_ADV_SCHED)
+    { "adv",  cmd_adv },
+#endif
+#if defined(CONFIG_APP_TX_POWER_CTRL)
+    { "txp",  cmd_txp },
+#endif
+#if defined(CONFIG_APP_CAN_OUTPUT)
+    { "can",  cmd_can },
+#endif
+#if defined(CONFIG_APP_NOTIFY_SCHED)
+    { "notify", cmd_notify },
+#endif
+#if defined(CONFIG_APP_BW_SCHED)
+    { "hist", cmd_hist },
+    { "share", cmd_share },
+    { "bw",   cmd_bw },
+#endif
+#if defined(CONFIG_APP_DFU_FAST)
+    { "dfu",  cmd_dfu },
+#endif
+#if defined(CONFIG_APP_ON_DEMAND)
+    { "scan", cmd_scan },
+#endif
+#if defined(CONFIG_APP_BUF_STATS)
+    { "buf",  cmd_buf },
+#endif
+#if defined(CONFIG_APP_RADIO_QUIET)
+    { "quiet", cmd_quiet },
+#endif
+};
+
+void command_handle(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+    char line[COMMAND_MAX_LEN];
+    char *args;
+
+    // Copy into a terminated buffer and strip trailing line endings
+    len = MIN(len, sizeof(line) - 1);
+    memcpy(line, data, len);
+    line[len] = '\0';
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+        line[--len] = '\0';
+    }
+
+    args = strchr(line, ' ');
+    if (args != NULL) {
+        *args++ = '\0';
+    } else {
+        args = &line[len];
+    }
+
+    requester = conn;
+
+    for (size_t i = 0; i < ARRAY_SIZE(commands); i++) {
+        if (strcmp(commands[i].name, line) == 0) {
+            commands[i].handler(args);
+            requester = NULL;
+            return;
+        }
+    }
+
+    command_reply("unknown command\n");
+    requester = NULL;
+}
+
+int command_submit(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+    static const char busy[] = "busy\n";
+    struct command_msg msg = {
+        .conn = bt_conn_ref(conn),
+        .len = MIN(len, sizeof(msg.line)),
+    };
+
+    memcpy(msg.line, data, msg.len);
+
+    if (k_msgq_put(&command_queue, &msg, K_NO_WAIT)) {
+        bt_conn_unref(msg.conn);
+        bt_nus_send(conn, busy, strlen(busy));
+        return -EBUSY;
+    }
+
+    return 0;
+}
+
+void command_poll_event_init(struct k_poll_event *event)
+{
+    k_poll_event_init(event, K_POLL_TYPE_MSGQ_DATA_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+                      &command_queue);
+}
+
+void command_process(void)
+{
+    struct command_msg msg;
+
+    while (k_msgq_get(&command_queue, &msg, K_NO_WAIT) == 0) {
+        command_handle(msg.conn, msg.line, msg.len);
+        bt_conn_unref(msg.conn);
+    }
+}
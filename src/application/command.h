@@ -0,0 +1,78 @@
+/**
+ * @file command.h
+ * @brief Text commands received from a client over the Nordic UART Service (NUS).
+ *
+ * A command is a single line "<name> [arguments]". Replies are sent back over NUS to the
+ * client that sent the command.
+ *
+ * Received lines are queued with command_submit() and executed by the main loop, which waits
+ * on the queue with the event from command_poll_event_init() and runs command_process().
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+struct bt_conn;
+struct k_poll_event;
+
+/** @brief Maximum length of a single command line, including the terminator. */
+#define COMMAND_MAX_LEN 64
+
+/**
+ * @brief Parse and execute a command line.
+ *
+ * @param conn The client that sent the command.
+ * @param data Command text, not necessarily null-terminated.
+ * @param len Length of the command text.
+ */
+void command_handle(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Queue a command line for execution by the main loop.
+ *
+ * Called from the Bluetooth RX thread. The client gets "busy" if the queue is full.
+ *
+ * @param conn The client that sent the command.
+ * @param data Command text, not necessarily null-terminated.
+ * @param len Length of the command text.
+ * @return 0 on success, -EBUSY if the queue is full.
+ */
+int command_submit(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Initialize a poll event signalled when a command line is queued.
+ *
+ * @param event The event, to be passed to k_poll().
+ */
+void command_poll_event_init(struct k_poll_event *event);
+
+/**
+ * @brief Execute all queued command lines.
+ */
+void command_process(void);
+
+/**
+ * @brief Send a null-terminated reply to the client over NUS.
+ *
+ * @param text Reply text.
+ */
+void command_reply(const char *text);
+
+/**
+ * @brief Get the client of the command being executed.
+ *
+ * @return The connection, only valid in a command handler.
+ */
+struct bt_conn *command_conn(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMMAND_H */
@@ -0,0 +1,90 @@
+/**
+ * @file time_sync.c
+ * @brief Drift-corrected wall-clock time on top of the RTC driven uptime.
+ *
+ * Each synchronization stores a reference point (uptime, wall time). When two reference points
+ * are far enough apart, the difference between the wall-clock and uptime deltas gives the RTC
+ * drift, which is smoothed and applied to all later conversions.
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "time_sync.h"
+
+#define MIN_DRIFT_SPAN_MS   (60 * MSEC_PER_SEC)  ///< Shortest span used to estimate drift
+#define MAX_DRIFT_PPB       1000000              ///< Largest accepted drift (1000 ppm)
+#define MIN_WALL_MS         1577836800000LL      ///< 2020-01-01, older times are rejected
+
+static struct k_spinlock lock;
+static bool synced;
+static int64_t ref_uptime_ms;  ///< Uptime at the last synchronization
+static int64_t ref_wall_ms;    ///< Wall-clock time at the last synchronization
+static int32_t drift_ppb;      ///< Smoothed RTC drift
+
+static int64_t correct(int64_t elapsed_ms, int32_t ppb)
+{
+    return elapsed_ms + (elapsed_ms * ppb) / 1000000000LL;
+}
+
+int time_sync_set(int64_t wall_ms)
+{
+    int64_t now = k_uptime_get();
+    k_spinlock_key_t key;
+
+    if (wall_ms < MIN_WALL_MS) {
+        return -EINVAL;
+    }
+
+    key = k_spin_lock(&lock);
+
+    if (synced && (now - ref_uptime_ms) >= MIN_DRIFT_SPAN_MS) {
+        int64_t uptime_span = now - ref_uptime_ms;
+        int64_t wall_span = wall_ms - ref_wall_ms;
+        int64_t sample = ((wall_span - uptime_span) * 1000000000LL) / uptime_span;
+
+        if (sample > -MAX_DRIFT_PPB && sample < MAX_DRIFT_PPB) {
+            // Exponential moving average, weight 1/4 for the new estimate
+            drift_ppb += ((int32_t)sample - drift_ppb) / 4;
+        }
+    }
+
+    ref_uptime_ms = now;
+    ref_wall_ms = wall_ms;
+    synced = true;
+
+    k_spin_unlock(&lock, key);
+
+    printk("Time synchronized, drift %d ppb\n", drift_ppb);
+
+    return 0;
+}
+
+bool time_sync_is_synced(void)
+{
+    return synced;
+}
+
+int64_t time_sync_now_ms(void)
+{
+    int64_t now = k_uptime_get();
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int64_t wall = synced ? ref_wall_ms + correct(now - ref_uptime_ms, drift_ppb) : now;
+
+    k_spin_unlock(&lock, key);
+
+    return wall;
+}
+
+int64_t time_sync_elapsed_ms(int64_t since_uptime_ms)
+{
+    return correct(k_uptime_get() - since_uptime_ms, drift_ppb);
+}
+
+int32_t time_sync_drift_ppb(void)
+{
+    return drift_ppb;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file time_sync.h
+ * @brief Wall-clock time synchronized from a client.
+ *
+ * The client provides the current time (Current Time Service write or the "time" NUS command).
+ * The module keeps an offset between the RTC driven uptime and wall-clock time and estimates
+ * the RTC drift from consecutive synchronizations.
+ */
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Synchronize to a wall-clock time.
+ *
+ * @param wall_ms Current time in milliseconds since the Unix epoch.
+ * @return 0 on success, or -EINVAL if the time is not plausible.
+ */
+int time_sync_set(int64_t wall_ms);
+
+/**
+ * @brief Check whether wall-clock time has been received since boot.
+ *
+ * @return true if synchronized.
+ */
+bool time_sync_is_synced(void);
+
+/**
+ * @brief Get the current time.
+ *
+ * @return Milliseconds since the Unix epoch, or milliseconds since boot if the
+ *         device has not been synchronized yet.
+ */
+int64_t time_sync_now_ms(void);
+
+/**
+ * @brief Drift-corrected time elapsed since an earlier uptime.
+ *
+ * @param since_uptime_ms Earlier value of k_uptime_get().
+ * @return Elapsed milliseconds, corrected for the estimated RTC drift.
+ */
+int64_t time_sync_elapsed_ms(int64_t since_uptime_ms);
+
+/**
+ * @brief Get the estimated RTC drift.
+ *
+ * @return Drift in parts per billion, positive if the RTC runs slow.
+ */
+int32_t time_sync_drift_ppb(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIME_SYNC_H */
@@ -0,0 +1,187 @@
+/**
+ * @file adv_sched.c
+ * @brief Adaptive advertising interval.
+ *
+ * Legacy advertising cannot change its interval on the fly, so every step restarts
+ * advertising with the next interval of the table. The on-time counters are estimates: each
+ * advertising event is counted as EVENT_RADIO_US of radio activity, and the number of events
+ * is the time spent at an interval divided by the interval plus the average random delay.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+
+#include "adv_sched.h"
+#include "bluetooth.h"
+#include "../sensor/scan.h"
+#include "../sensor/pack_metrics.h"
+#include "../application/app_config.h"
+
+/** @brief Estimated radio time of one advertising event: three channels, TX and listening. */
+#define EVENT_RADIO_US      1800
+
+/** @brief Average of the 0-10 ms random delay added to every advertising event. */
+#define ADV_DELAY_US        5000
+
+/** @brief Intervals of the steps in 0.625 ms units, fastest first. */
+static const uint16_t steps[] = {
+    BT_GAP_ADV_FAST_INT_MIN_1,  //   30 ms
+    BT_GAP_ADV_FAST_INT_MIN_2,  //  100 ms
+    400,                        //  250 ms
+    800,                        //  500 ms
+    BT_GAP_ADV_SLOW_INT_MIN,    // 1000 ms
+};
+
+#define STEP_COUNT ARRAY_SIZE(steps)
+
+BUILD_ASSERT(STEP_COUNT == 5, "adv_sched_format_status() prints five steps");
+
+static K_MUTEX_DEFINE(sched_lock);
+static bool active;
+static uint32_t adv_options;
+static uint8_t step;
+static int64_t step_started;
+static uint16_t last_alarms;
+
+// On-time counters
+static uint32_t step_ms[STEP_COUNT];
+static uint32_t events;
+static uint64_t on_time_us;
+
+static void step_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(step_work, step_work_handler);
+
+/**
+ * @brief Account the time spent at the current step. Must be called with sched_lock held.
+ */
+static void account_locked(void)
+{
+    int64_t now = k_uptime_get();
+    uint32_t elapsed = now - step_started;
+    uint32_t n = ((uint64_t)elapsed * USEC_PER_MSEC) / (steps[step] * 625 + ADV_DELAY_US);
+
+    step_ms[step] += elapsed;
+    events += n;
+    on_time_us += (uint64_t)n * EVENT_RADIO_US;
+    step_started = now;
+}
+
+/**
+ * @brief (Re)start advertising at a step. Must be called with sched_lock held.
+ */
+static int start_step_locked(uint8_t next)
+{
+    const struct bt_le_adv_param param = BT_LE_ADV_PARAM_INIT(
+        BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME | adv_options,
+        steps[next], steps[next], NULL);
+    int err;
+
+    if (active) {
+        account_locked();
+        bt_le_adv_stop();
+    }
+
+    step = next;
+    step_started = k_uptime_get();
+
+    err = bluetooth_adv_start(&param);
+    if (err) {
+        printk("Advertising failed to start (err %d)\n", err);
+        active = false;
+        k_work_cancel_delayable(&step_work);
+        return err;
+    }
+
+    active = true;
+    if (step + 1 < STEP_COUNT) {
+        k_work_reschedule(&step_work, step == 0 ? K_SECONDS(CONFIG_APP_ADV_FAST_WINDOW_S) :
+                                                  K_SECONDS(CONFIG_APP_ADV_STEP_S));
+    } else {
+        k_work_cancel_delayable(&step_work);
+    }
+
+    return 0;
+}
+
+static void step_work_handler(struct k_work *work)
+{
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    if (active && step + 1 < STEP_COUNT) {
+        start_step_locked(step + 1);
+    }
+    k_mutex_unlock(&sched_lock);
+}
+
+int adv_sched_start(uint32_t options)
+{
+    int err;
+
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    adv_options = options;
+    err = start_step_locked(0);
+    k_mutex_unlock(&sched_lock);
+
+    return err;
+}
+
+void adv_sched_stop(void)
+{
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    if (active) {
+        account_locked();
+        bt_le_adv_stop();
+        active = false;
+    }
+    k_work_cancel_delayable(&step_work);
+    k_mutex_unlock(&sched_lock);
+}
+
+void adv_sched_kick(void)
+{
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    if (active) {
+        start_step_locked(0);
+    }
+    k_mutex_unlock(&sched_lock);
+}
+
+void adv_sched_scan(const struct scan_record *rec)
+{
+    struct app_config cfg;
+    struct pack_metrics m;
+    uint16_t raised;
+
+    app_config_read(&cfg);
+    pack_metrics_compute(rec, &cfg, &m);
+    raised = m.alarms & ~last_alarms;
+    last_alarms = m.alarms;
+
+    if (raised) {
+        adv_sched_kick();
+    }
+}
+
+int adv_sched_format_status(char *buf, size_t buf_size)
+{
+    int written;
+
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    if (active) {
+        account_locked();
+    }
+    written = snprintf(buf, buf_size,
+                       "adv %s %u ms, events %u, on-time %u ms, s/step %u %u %u %u %u\n",
+                       active ? "interval" : "stopped", steps[step] * 625 / USEC_PER_MSEC,
+                       events, (uint32_t)(on_time_us / USEC_PER_MSEC),
+                       step_ms[0] / MSEC_PER_SEC, step_ms[1] / MSEC_PER_SEC,
+                       step_ms[2] / MSEC_PER_SEC, step_ms[3] / MSEC_PER_SEC,
+                       step_ms[4] / MSEC_PER_SEC);
+    k_mutex_unlock(&sched_lock);
+
+    return written;
+}
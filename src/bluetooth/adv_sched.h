@@ -0,0 +1,61 @@
+/**
+ * @file adv_sched.h
+ * @brief Adaptive advertising interval.
+ *
+ * Advertising starts fast (30 ms) for CONFIG_APP_ADV_FAST_WINDOW_S, then the interval is
+ * raised step by step every CONFIG_APP_ADV_STEP_S up to the slow interval (1 s). A new alarm
+ * restores the fast interval, and the restart carries the latest telemetry. The radio on-time
+ * spent advertising is estimated from the number of advertising events at each interval.
+ */
+
+#ifndef ADV_SCHED_H
+#define ADV_SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct scan_record;
+
+/**
+ * @brief Start connectable advertising at the fast interval.
+ *
+ * @param options Additional advertising options, e.g. BT_LE_ADV_OPT_FILTER_CONN.
+ * @return 0 on success, or a negative error code.
+ */
+int adv_sched_start(uint32_t options);
+
+/**
+ * @brief Stop the schedule, e.g. when a central connected. Stops advertising if still active.
+ */
+void adv_sched_stop(void);
+
+/**
+ * @brief Go back to the fast interval, if advertising.
+ */
+void adv_sched_kick(void);
+
+/**
+ * @brief Check a new scan for alarms and go back to the fast interval on a new alarm.
+ *
+ * @param rec The latest scan.
+ */
+void adv_sched_scan(const struct scan_record *rec);
+
+/**
+ * @brief Print the current step and the radio on-time counters into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int adv_sched_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ADV_SCHED_H */
@@ -0,0 +1,74 @@
+/**
+ * @file adv_telemetry.h
+ * @brief Telemetry broadcast in the advertising data.
+ *
+ * The latest scan is summarized in a manufacturer specific AD element, so an observer can
+ * collect the state of many packs without connecting to them.
+ */
+
+#ifndef ADV_TELEMETRY_H
+#define ADV_TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "../sensor/scan.h"
+
+/** @brief Company identifier of the manufacturer data (0xFFFF, reserved for internal use). */
+#define ADV_TELEMETRY_COMPANY_ID 0xFFFF
+
+/** @brief Identifies a battery monitor telemetry frame and its format version. */
+#define ADV_TELEMETRY_MAGIC 0xB1
+
+/**
+ * @brief Manufacturer data of a telemetry frame. All fields are little-endian.
+ */
+struct adv_telemetry {
+    uint16_t company;      ///< ADV_TELEMETRY_COMPANY_ID
+    uint8_t magic;         ///< ADV_TELEMETRY_MAGIC
+    uint16_t seq;          ///< Scan sequence number
+    uint16_t pack_cv;      ///< Pack voltage in cV
+    uint16_t min_cell_cv;  ///< Lowest battery voltage in cV
+    uint16_t max_cell_cv;  ///< Highest battery voltage in cV
+    int16_t temp;          ///< Internal temperature in 1/10 °C
+} __packed;
+
+/**
+ * @brief Summarize a scan into a telemetry frame.
+ *
+ * @param rec Scan record.
+ * @param frame Destination frame.
+ */
+static inline void adv_telemetry_encode(const struct scan_record *rec,
+                                        struct adv_telemetry *frame)
+{
+    uint16_t min_cv = UINT16_MAX;
+    uint16_t max_cv = 0;
+
+    for (uint8_t i = 0; i < NUMBER_OF_BATTERIES_IN_SERIES; i++) {
+        uint16_t cell = scan_cell_cv(rec, i);
+
+        min_cv = MIN(min_cv, cell);
+        max_cv = MAX(max_cv, cell);
+    }
+
+    frame->company = sys_cpu_to_le16(ADV_TELEMETRY_COMPANY_ID);
+    frame->magic = ADV_TELEMETRY_MAGIC;
+    frame->seq = sys_cpu_to_le16(rec->seq);
+    frame->pack_cv = sys_cpu_to_le16(scan_pack_cv(rec));
+    frame->min_cell_cv = sys_cpu_to_le16(min_cv);
+    frame->max_cell_cv = sys_cpu_to_le16(max_cv);
+    frame->temp = sys_cpu_to_le16(rec->temp);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ADV_TELEMETRY_H */
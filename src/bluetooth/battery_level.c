@@ -0,0 +1,59 @@
+/**
+ * @file battery_level.c
+ * @brief Feeds the standard Battery Service from the pack metrics.
+ *
+ * The Battery Service implementation caches the values and only notifies changes, so this is
+ * called after every scan.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/services/bas.h>
+#include <zephyr/sys/util.h>
+
+#include "battery_level.h"
+#include "../sensor/scan.h"
+#include "../sensor/pack_metrics.h"
+#include "../application/app_config.h"
+
+#define EMPTY_CV        CONFIG_APP_BAS_EMPTY_CV
+#define FULL_CV         CONFIG_APP_BAS_FULL_CV
+#define LOW_LEVEL       20  ///< Level below which the charge is reported as low
+
+/** @brief Alarms reported as a critical battery state. */
+#define CRITICAL_ALARMS (PACK_ALARM_CELL_LOW | PACK_ALARM_CELL_HIGH | PACK_ALARM_TEMP_HIGH)
+
+BUILD_ASSERT(FULL_CV > EMPTY_CV, "CONFIG_APP_BAS_FULL_CV must be above CONFIG_APP_BAS_EMPTY_CV");
+
+static uint8_t level_from_cell(uint16_t cell_cv)
+{
+    if (cell_cv <= EMPTY_CV) {
+        return 0;
+    }
+    if (cell_cv >= FULL_CV) {
+        return 100;
+    }
+    return (cell_cv - EMPTY_CV) * 100 / (FULL_CV - EMPTY_CV);
+}
+
+void battery_level_update(const struct scan_record *rec)
+{
+    struct app_config cfg;
+    struct pack_metrics m;
+    uint8_t level;
+
+    app_config_read(&cfg);
+    pack_metrics_compute(rec, &cfg, &m);
+    level = level_from_cell(m.min_cell_cv);
+
+    bt_bas_set_battery_level(level);
+
+    bt_bas_bls_set_battery_present(BT_BAS_BLS_BATTERY_PRESENT);
+    bt_bas_bls_set_battery_charge_level(m.alarms & CRITICAL_ALARMS ?
+                                        BT_BAS_BLS_CHARGE_LEVEL_CRITICAL :
+                                        level < LOW_LEVEL ? BT_BAS_BLS_CHARGE_LEVEL_LOW :
+                                        BT_BAS_BLS_CHARGE_LEVEL_GOOD);
+    bt_bas_bls_set_service_required(m.alarms & PACK_ALARM_IMBALANCE ?
+                                    BT_BAS_BLS_SERVICE_REQUIRED_TRUE :
+                                    BT_BAS_BLS_SERVICE_REQUIRED_FALSE);
+    bt_bas_bcs_set_battery_critical_state(m.alarms & CRITICAL_ALARMS);
+}
@@ -0,0 +1,30 @@
+/**
+ * @file battery_level.h
+ * @brief Feeds the standard Battery Service from the pack metrics.
+ *
+ * The battery level is the charge of the weakest battery, interpolated between
+ * CONFIG_APP_BAS_EMPTY_CV and CONFIG_APP_BAS_FULL_CV. When the stack provides them, the
+ * Battery Level Status and Battery Critical Status characteristics reflect the alarm bits.
+ */
+
+#ifndef BATTERY_LEVEL_H
+#define BATTERY_LEVEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct scan_record;
+
+/**
+ * @brief Update the Battery Service characteristics. Clients are notified of changes.
+ *
+ * @param rec The latest scan.
+ */
+void battery_level_update(const struct scan_record *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BATTERY_LEVEL_H */
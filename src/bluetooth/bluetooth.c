@@ -1,4 +1,5 @@
 #include "bluetooth.h"
+#include <errno.h>
 #include <zephyr/settings/settings.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/bluetooth/bluetooth.h>
@@ -15,19 +16,84 @@
 
 
 #include "service.h"
+#include "adv_telemetry.h"
+#include "mesh_sensor.h"
+#include "reconnect.h"
+#include "buf_stats.h"
+#include "../application/command.h"
+#include "../application/application.h"
 
 #define DEVICE_NAME             CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN         (sizeof(DEVICE_NAME) - 1)
 
+#if defined(CONFIG_APP_ADV_TELEMETRY)
+// Flags and telemetry leave room for 11 characters of the name in a legacy advertising PDU
+#define ADV_NAME_LEN            MIN(DEVICE_NAME_LEN, 11)
+
+static struct adv_telemetry telemetry = {
+    .company = sys_cpu_to_le16(ADV_TELEMETRY_COMPANY_ID),
+    .magic   = ADV_TELEMETRY_MAGIC,
+};
+
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, &telemetry, sizeof(telemetry)),
+    BT_DATA(BT_DATA_NAME_SHORTENED, DEVICE_NAME, ADV_NAME_LEN),
+};
+#else
 static const struct bt_data ad[] = {
     BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
     BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
 };
+#endif
 
 static const struct bt_data sd[] = {
     BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_BATTERY_VAL),
 };
 
+/**
+ * @brief Callback invoked when data is received over the Nordic UART Service.
+ *
+ * @param conn Pointer to the connection object.
+ * @param data Received data.
+ * @param len Length of the received data.
+ */
+static void nus_received(struct bt_conn *conn, const uint8_t *const data, uint16_t len)
+{
+    command_submit(conn, data, len);
+}
+
+/**
+ * @brief Callback invoked when data has been sent over the Nordic UART Service.
+ *
+ * @param conn Pointer to the connection object.
+ */
+static void nus_sent(struct bt_conn *conn)
+{
+    if (IS_ENABLED(CONFIG_APP_BUF_STATS)) {
+        buf_stats_tx_done();
+    }
+}
+
+/**
+ * @brief Callback invoked when a client enables or disables the NUS notifications.
+ *
+ * @param status Whether the notifications are now enabled.
+ */
+static void nus_send_enabled(enum bt_nus_send_status status)
+{
+    // Send the samples stored while nobody was listening right away
+    if (status == BT_NUS_SEND_STATUS_ENABLED) {
+        application_request_transfer();
+    }
+}
+
+static struct bt_nus_cb nus_callbacks = {
+    .received = nus_received,
+    .sent = nus_sent,
+    .send_enabled = nus_send_enabled,
+};
+
 /**
  * @brief Callback invoked when a Bluetooth connection is established.
  *
@@ -187,7 +253,7 @@ void bluetooth_init(void)
         return;
     }
 
-    err = bt_nus_init(NULL);
+    err = bt_nus_init(&nus_callbacks);
     if (err) {
         printk("Failed to initialize NUS (err %d)\n", err);
         return;
@@ -198,23 +264,48 @@ void bluetooth_init(void)
     // Register connection callbacks
     bt_conn_cb_register(&conn_callbacks);
 
+    // The mesh composition must be registered before its state is loaded
+    if (IS_ENABLED(CONFIG_APP_MESH_SENSOR) && mesh_sensor_init()) {
+        return;
+    }
+
     if (IS_ENABLED(CONFIG_SETTINGS)) {
         settings_load();
     }
+
+    if (IS_ENABLED(CONFIG_APP_MESH_SENSOR)) {
+        mesh_sensor_start();
+    }
+}
+
+/**
+ * @brief Start advertising the pre-defined advertising and scan response data.
+ *
+ * @param param Advertising parameters.
+ * @return 0 on success, or a negative error code.
+ */
+int bluetooth_adv_start(const struct bt_le_adv_param *param)
+{
+    return bt_le_adv_start(param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
 }
 
 /**
  * @brief Start Bluetooth advertising.
  *
  * This function starts advertising to allow other devices to discover and connect.
- * It uses pre-defined advertising and scan response data.
+ * With CONFIG_APP_RECONNECT, advertising is managed by the reconnection stages and restarted
+ * after every disconnection.
  */
 void bluetooth_start_advertising(void)
 {
     int err;
 
-    err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad),
-                          sd, ARRAY_SIZE(sd));
+    if (IS_ENABLED(CONFIG_APP_RECONNECT)) {
+        reconnect_start();
+        return;
+    }
+
+    err = bluetooth_adv_start(BT_LE_ADV_CONN);
     if (err) {
         printk("Advertising failed to start (err %d)\n", err);
         return;
@@ -222,3 +313,24 @@ void bluetooth_start_advertising(void)
 
     printk("Advertising successfully started\n");
 }
+
+#if defined(CONFIG_APP_ADV_TELEMETRY)
+/**
+ * @brief Update the telemetry broadcast in the advertising data.
+ *
+ * @param rec The latest scan.
+ */
+void bluetooth_update_telemetry(const struct scan_record *rec)
+{
+    struct adv_telemetry frame;
+    int err;
+
+    adv_telemetry_encode(rec, &frame);
+    telemetry = frame;
+
+    err = bt_le_adv_update_data(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+    if (err && err != -EAGAIN) {
+        printk("Advertising data update failed (err %d)\n", err);
+    }
+}
+#endif
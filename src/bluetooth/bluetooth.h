@@ -13,8 +13,31 @@ void bluetooth_init(void);
  * @brief Start Bluetooth advertising.
  *
  * This function starts advertising to allow other devices to discover and connect.
- * It uses pre-defined advertising and scan response data.
+ * With CONFIG_APP_RECONNECT, advertising is managed by the reconnection stages and restarted
+ * after every disconnection.
  */
 void bluetooth_start_advertising(void);
 
+struct bt_le_adv_param;
+
+/**
+ * @brief Start advertising the pre-defined advertising and scan response data.
+ *
+ * @param param Advertising parameters.
+ * @return 0 on success, or a negative error code.
+ */
+int bluetooth_adv_start(const struct bt_le_adv_param *param);
+
+struct scan_record;
+
+/**
+ * @brief Update the telemetry broadcast in the advertising data.
+ *
+ * Only available with CONFIG_APP_ADV_TELEMETRY. The advertising data is updated in place
+ * if advertising is active.
+ *
+ * @param rec The latest scan.
+ */
+void bluetooth_update_telemetry(const struct scan_record *rec);
+
 #endif // BLUETOOTH_H
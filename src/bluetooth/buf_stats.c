@@ -0,0 +1,245 @@
+/**
+ * @file buf_stats.c
+ * @brief Sampling of the net_buf pools and classification of the notification failures.
+ *
+ * Pools are found in their iterable section, so the pools of the host, the controller and
+ * the application are all covered without a list to maintain. Their names and free counts
+ * come from CONFIG_NET_BUF_POOL_USAGE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/iterable_sections.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "buf_stats.h"
+
+#define MAX_POOLS CONFIG_APP_BUF_STATS_MAX_POOLS
+
+/**
+ * @brief Notification outcome counters.
+ */
+struct tx_counters {
+    uint32_t sent;
+    uint32_t done;
+    uint32_t too_large;   ///< Longer than the ATT MTU
+    uint32_t no_buf;      ///< A buffer pool was empty
+    uint32_t no_queue;    ///< No pool was empty, TX contexts or controller buffers in use
+    uint32_t other;
+};
+
+/**
+ * @brief Kconfig option sizing a pool, matched on the pool name.
+ */
+struct pool_option {
+    const char *name;
+    const char *option;
+};
+
+// Host pool names, as defined in the Zephyr host
+static const struct pool_option options[] = {
+    { "acl_tx", "CONFIG_BT_L2CAP_TX_BUF_COUNT" },
+    { "frag",   "CONFIG_BT_L2CAP_TX_FRAG_COUNT" },
+    { "acl_in", "CONFIG_BT_BUF_ACL_RX_COUNT" },
+    { "evt",    "CONFIG_BT_BUF_EVT_RX_COUNT" },
+    { "hci_rx", "CONFIG_BT_BUF_EVT_RX_COUNT" },
+    { "cmd",    "CONFIG_BT_BUF_CMD_TX_COUNT" },
+};
+
+static struct k_spinlock lock;
+static struct tx_counters counters;
+static uint16_t peak[MAX_POOLS];
+static uint32_t exhausted[MAX_POOLS];   ///< Failed notifications while the pool was empty
+static bool profiling;
+
+static void profile_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(profile_work, profile_handler);
+static int64_t profile_end_ms;
+
+static uint16_t pool_used(struct net_buf_pool *pool)
+{
+    return pool->buf_count - (uint16_t)atomic_get(&pool->avail_count);
+}
+
+/**
+ * @brief Update the peaks. Must be called with the lock held.
+ *
+ * @return True if a pool is empty.
+ */
+static bool sample_locked(bool count_exhausted)
+{
+    size_t i = 0;
+    bool empty = false;
+
+    STRUCT_SECTION_FOREACH(net_buf_pool, pool) {
+        uint16_t used;
+
+        if (i == MAX_POOLS) {
+            break;
+        }
+
+        used = pool_used(pool);
+        peak[i] = MAX(peak[i], used);
+        if (used == pool->buf_count) {
+            empty = true;
+            if (count_exhausted) {
+                exhausted[i]++;
+            }
+        }
+        i++;
+    }
+
+    return empty;
+}
+
+void buf_stats_tx(struct bt_conn *conn, size_t len, int err)
+{
+    size_t max_len = (conn != NULL ? bt_gatt_get_mtu(conn) : CONFIG_BT_L2CAP_TX_MTU) - 3;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (err == 0) {
+        counters.sent++;
+        sample_locked(false);
+    } else if (len > max_len) {
+        counters.too_large++;
+    } else if (err == -ENOMEM || err == -ENOBUFS) {
+        if (sample_locked(true)) {
+            counters.no_buf++;
+        } else {
+            counters.no_queue++;
+        }
+    } else {
+        counters.other++;
+    }
+
+    k_spin_unlock(&lock, key);
+}
+
+void buf_stats_tx_done(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    counters.done++;
+    k_spin_unlock(&lock, key);
+}
+
+static void profile_handler(struct k_work *work)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    sample_locked(false);
+    if (k_uptime_get() >= profile_end_ms) {
+        profiling = false;
+    }
+    k_spin_unlock(&lock, key);
+
+    if (profiling) {
+        k_work_reschedule(&profile_work, K_MSEC(CONFIG_APP_BUF_STATS_PROFILE_MS));
+    } else {
+        printk("Buffer profile done, \"buf rec\" prints the recommended sizes\n");
+    }
+}
+
+int buf_stats_profile_start(uint32_t seconds)
+{
+    k_spinlock_key_t key;
+
+    if (seconds == 0) {
+        return -EINVAL;
+    }
+
+    key = k_spin_lock(&lock);
+    memset(peak, 0, sizeof(peak));
+    memset(exhausted, 0, sizeof(exhausted));
+    memset(&counters, 0, sizeof(counters));
+    profile_end_ms = k_uptime_get() + seconds * MSEC_PER_SEC;
+    profiling = true;
+    k_spin_unlock(&lock, key);
+
+    k_work_reschedule(&profile_work, K_NO_WAIT);
+    return 0;
+}
+
+int buf_stats_format_tx(char *buf, size_t buf_size)
+{
+    struct tx_counters c;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    bool running = profiling;
+    int written;
+
+    c = counters;
+    k_spin_unlock(&lock, key);
+
+    written = snprintf(buf, buf_size,
+                       "tx sent %u done %u fail: mtu %u buf %u queue %u other %u%s\n",
+                       c.sent, c.done, c.too_large, c.no_buf, c.no_queue, c.other,
+                       running ? " (profiling)" : "");
+    if (written < 0 || (size_t)written >= buf_size) {
+        return -ENOMEM;
+    }
+
+    return written;
+}
+
+static const char *pool_option(const char *name)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(options); i++) {
+        if (name != NULL && strstr(name, options[i].name) != NULL) {
+            return options[i].option;
+        }
+    }
+
+    return NULL;
+}
+
+int buf_stats_format_pool(size_t index, bool recommend, char *buf, size_t buf_size)
+{
+    struct net_buf_pool *found = NULL;
+    const char *option;
+    uint16_t pool_peak;
+    uint32_t pool_exhausted;
+    uint16_t size;
+    size_t i = 0;
+    int written;
+    k_spinlock_key_t key;
+
+    STRUCT_SECTION_FOREACH(net_buf_pool, pool) {
+        if (i == index) {
+            found = pool;
+            break;
+        }
+        i++;
+    }
+
+    if (found == NULL || index >= MAX_POOLS) {
+        return -ENOENT;
+    }
+
+    key = k_spin_lock(&lock);
+    pool_peak = peak[index];
+    pool_exhausted = exhausted[index];
+    k_spin_unlock(&lock, key);
+
+    if (!recommend) {
+        written = snprintf(buf, buf_size, "%s: used %u peak %u of %u, empty on %u fails\n",
+                           found->name, pool_used(found), pool_peak, found->buf_count,
+                           pool_exhausted);
+    } else {
+        size = MAX(1, pool_peak + DIV_ROUND_UP(pool_peak, 4));
+        option = pool_option(found->name);
+        written = snprintf(buf, buf_size, "%s=%u%s\n", option != NULL ? option : found->name,
+                           size, pool_peak == found->buf_count ? " (exhausted, raise more)" : "");
+    }
+
+    if (written < 0 || (size_t)written >= buf_size) {
+        return -ENOMEM;
+    }
+
+    return written;
+}
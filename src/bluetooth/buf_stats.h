@@ -0,0 +1,75 @@
+/**
+ * @file buf_stats.h
+ * @brief Bluetooth host buffer pool usage, notification outcome counters and sizing profile.
+ *
+ * Every net_buf pool of the build (HCI events, ACL RX and TX, L2CAP fragments, ...) is sampled
+ * on each notification attempt, and every CONFIG_APP_BUF_STATS_PROFILE_MS while profiling, to
+ * keep its peak usage. Failed notifications are classified as too large for the MTU, out of
+ * host buffers (a pool was empty at the time), out of TX queue (no pool was empty: the
+ * connection TX contexts or the controller buffers were all in use) or other errors.
+ *
+ * A profile run resets the peaks, samples the pools during a benchmark load and derives a
+ * recommended size for each pool: the peak plus 25 %, flagged when the pool was exhausted.
+ */
+
+#ifndef BUF_STATS_H
+#define BUF_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct bt_conn;
+
+/**
+ * @brief Account a notification attempt.
+ *
+ * @param conn The connection, or NULL for all connections.
+ * @param len Length of the notification.
+ * @param err Result of the send call.
+ */
+void buf_stats_tx(struct bt_conn *conn, size_t len, int err);
+
+/**
+ * @brief Account a completed notification.
+ */
+void buf_stats_tx_done(void);
+
+/**
+ * @brief Start a profile run.
+ *
+ * @param seconds Duration of the run.
+ * @return 0 on success, -EINVAL if the duration is 0.
+ */
+int buf_stats_profile_start(uint32_t seconds);
+
+/**
+ * @brief Print the notification counters into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int buf_stats_format_tx(char *buf, size_t buf_size);
+
+/**
+ * @brief Print the usage of one pool into a buffer.
+ *
+ * @param index Pool index, from 0.
+ * @param recommend Print the recommended size instead of the current usage.
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, -ENOENT past the last pool, or another negative error
+ *         code.
+ */
+int buf_stats_format_pool(size_t index, bool recommend, char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUF_STATS_H */
@@ -0,0 +1,298 @@
+/**
+ * @file bw_sched.c
+ * @brief Deficit round robin of the notifications across connections and stream classes.
+ *
+ * The scheduler thread holds one of CONFIG_APP_BW_SCHED_TX_SLOTS slots for every notification
+ * queued in the stack, and gets it back from the completion callback. With a free slot, it
+ * picks the next flow:
+ * 1. a live flow that has been waiting for the latency bound, even with a negative deficit;
+ * 2. otherwise deficit round robin: the flow under the cursor earns its quantum once per round
+ *    and sends while its deficit covers the next notification, then the cursor moves on.
+ *
+ * Flow callbacks are called without the scheduler lock held for send(), so sources can remove
+ * their flow from their own callbacks. pending() is called with the lock held.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "bw_sched.h"
+#include "buf_stats.h"
+
+#define MAX_FLOWS   (2 * CONFIG_BT_MAX_CONN)
+#define MAX_CLIENTS CONFIG_BT_MAX_CONN
+
+/**
+ * @brief Share of a client.
+ */
+struct client {
+    struct bt_conn *conn;
+    uint8_t share;
+};
+
+static K_MUTEX_DEFINE(sched_lock);
+static struct bw_flow *flows[MAX_FLOWS];
+static size_t cursor;
+static struct client clients[MAX_CLIENTS];
+
+static K_SEM_DEFINE(slot_sem, CONFIG_APP_BW_SCHED_TX_SLOTS, CONFIG_APP_BW_SCHED_TX_SLOTS);
+static K_SEM_DEFINE(kick_sem, 0, 1);
+
+static uint8_t client_share_locked(const struct bt_conn *conn)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(clients); i++) {
+        if (clients[i].conn == conn) {
+            return clients[i].share;
+        }
+    }
+
+    return CONFIG_APP_BW_SCHED_DEFAULT_SHARE;
+}
+
+/**
+ * @brief Choose the next flow to send. Must be called with sched_lock held.
+ *
+ * @param size Size of the next notification of the chosen flow.
+ * @return The flow, or NULL if no flow has data.
+ */
+static struct bw_flow *pick_locked(size_t *size)
+{
+    uint32_t now = k_cycle_get_32();
+    uint32_t bound = k_ms_to_cyc_floor32(CONFIG_APP_BW_SCHED_LIVE_BOUND_MS);
+    bool any = false;
+
+    for (size_t i = 0; i < ARRAY_SIZE(flows); i++) {
+        struct bw_flow *flow = flows[i];
+
+        if (flow != NULL && flow->cls == BW_CLASS_LIVE && flow->waiting &&
+            now - flow->kick_cyc >= bound) {
+            *size = flow->ops->pending(flow);
+            if (*size > 0) {
+                // Paid back from the following rounds
+                flow->deficit -= *size;
+                return flow;
+            }
+        }
+    }
+
+    for (size_t step = 0; ; step++) {
+        struct bw_flow *flow = flows[cursor];
+
+        if (step == ARRAY_SIZE(flows)) {
+            if (!any) {
+                return NULL;
+            }
+            // Deficits grow every round, a flow is eventually chosen
+            step = 0;
+            any = false;
+        }
+
+        if (flow != NULL) {
+            *size = flow->ops->pending(flow);
+            if (*size == 0) {
+                flow->deficit = 0;
+            } else {
+                any = true;
+                if (!flow->visited) {
+                    flow->deficit += client_share_locked(flow->conn) *
+                                     CONFIG_APP_BW_SCHED_QUANTUM;
+                    flow->visited = true;
+                }
+                if (flow->deficit >= (int32_t)*size) {
+                    flow->deficit -= *size;
+                    return flow;
+                }
+            }
+            flow->visited = false;
+        }
+
+        cursor = (cursor + 1) % ARRAY_SIZE(flows);
+    }
+}
+
+static void sent(struct bt_conn *conn, void *user_data)
+{
+    k_sem_give(&slot_sem);
+
+    if (IS_ENABLED(CONFIG_APP_BUF_STATS)) {
+        buf_stats_tx_done();
+    }
+}
+
+static void account(struct bw_flow *flow, size_t size, uint32_t kick_cyc)
+{
+    uint32_t now = k_cycle_get_32();
+    uint32_t delay_ms = k_cyc_to_ms_floor32(now - kick_cyc);
+
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    flow->stats.packets++;
+    flow->stats.bytes += size;
+    flow->stats.delay_sum_ms += delay_ms;
+    flow->stats.delay_max_ms = MAX(flow->stats.delay_max_ms, delay_ms);
+    // The next notification of a bulk flow waits from now
+    flow->kick_cyc = now;
+    flow->waiting = false;
+    k_mutex_unlock(&sched_lock);
+}
+
+static void sched_thread(void *p1, void *p2, void *p3)
+{
+    for (;;) {
+        struct bw_flow *flow;
+        uint32_t kick_cyc;
+        size_t size;
+
+        k_sem_take(&slot_sem, K_FOREVER);
+
+        for (;;) {
+            k_mutex_lock(&sched_lock, K_FOREVER);
+            flow = pick_locked(&size);
+            kick_cyc = flow != NULL ? flow->kick_cyc : 0;
+            k_mutex_unlock(&sched_lock);
+
+            if (flow != NULL) {
+                break;
+            }
+            k_sem_take(&kick_sem, K_FOREVER);
+        }
+
+        if (flow->ops->send(flow, sent, NULL)) {
+            k_sem_give(&slot_sem);
+            continue;
+        }
+
+        account(flow, size, kick_cyc);
+    }
+}
+
+K_THREAD_DEFINE(bw_sched_tid, CONFIG_APP_BW_SCHED_STACK_SIZE, sched_thread,
+                NULL, NULL, NULL, K_HIGHEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+int bw_sched_add(struct bw_flow *flow, struct bt_conn *conn, enum bw_class cls,
+                 const struct bw_flow_ops *ops)
+{
+    int err = -ENOMEM;
+
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(flows); i++) {
+        if (flows[i] == NULL) {
+            *flow = (struct bw_flow){
+                .ops = ops,
+                .conn = conn,
+                .cls = cls,
+                .kick_cyc = k_cycle_get_32(),
+                .start_ms = k_uptime_get(),
+            };
+            flows[i] = flow;
+            err = 0;
+            break;
+        }
+    }
+    k_mutex_unlock(&sched_lock);
+
+    return err;
+}
+
+void bw_sched_remove(struct bw_flow *flow)
+{
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(flows); i++) {
+        if (flows[i] == flow) {
+            flows[i] = NULL;
+        }
+    }
+    k_mutex_unlock(&sched_lock);
+}
+
+void bw_sched_kick(struct bw_flow *flow)
+{
+    if (!flow->waiting) {
+        flow->kick_cyc = k_cycle_get_32();
+        flow->waiting = true;
+    }
+    k_sem_give(&kick_sem);
+}
+
+int bw_sched_set_share(struct bt_conn *conn, uint8_t share)
+{
+    int err = -ENOMEM;
+
+    if (share == 0 || share > CONFIG_APP_BW_SCHED_MAX_SHARE) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(clients); i++) {
+        if (clients[i].conn == conn || clients[i].conn == NULL) {
+            clients[i].conn = conn;
+            clients[i].share = share;
+            err = 0;
+            break;
+        }
+    }
+    k_mutex_unlock(&sched_lock);
+
+    return err;
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(clients); i++) {
+        if (clients[i].conn == conn) {
+            clients[i].conn = NULL;
+        }
+    }
+    k_mutex_unlock(&sched_lock);
+}
+
+BT_CONN_CB_DEFINE(bw_sched_conn_callbacks) = {
+    .disconnected = disconnected,
+};
+
+int bw_sched_format_status(char *buf, size_t buf_size)
+{
+    int64_t now = k_uptime_get();
+    size_t offset = 0;
+    int err = 0;
+
+    k_mutex_lock(&sched_lock, K_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(flows); i++) {
+        const struct bw_flow *flow = flows[i];
+        const struct bw_flow_stats *s;
+        int64_t elapsed_ms;
+        int written;
+
+        if (flow == NULL) {
+            continue;
+        }
+        s = &flow->stats;
+        elapsed_ms = MAX(now - flow->start_ms, 1);
+
+        written = snprintf(buf + offset, buf_size - offset,
+                           "conn %u %s x%u: %u B/s pkt %u delay avg %u max %u ms\n",
+                           bt_conn_index(flow->conn),
+                           flow->cls == BW_CLASS_LIVE ? "live" : "bulk",
+                           client_share_locked(flow->conn),
+                           (uint32_t)(s->bytes * 1000LL / elapsed_ms), s->packets,
+                           s->packets ? s->delay_sum_ms / s->packets : 0, s->delay_max_ms);
+        if (written < 0 || (size_t)written >= buf_size - offset) {
+            err = -ENOMEM;
+            break;
+        }
+        offset += written;
+    }
+    k_mutex_unlock(&sched_lock);
+
+    if (err) {
+        return err;
+    }
+    if (offset == 0) {
+        return snprintf(buf, buf_size, "bw: no flow\n");
+    }
+
+    return offset;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file bw_sched.h
+ * @brief Fair sharing of the notification bandwidth between clients and stream classes.
+ *
+ * Every source of notifications (the live stream of a connection, a history pull) is a flow.
+ * At most CONFIG_APP_BW_SCHED_TX_SLOTS notifications of all flows are queued in the stack at
+ * once, and the next one is chosen by deficit round robin: each flow earns its client share
+ * times CONFIG_APP_BW_SCHED_QUANTUM bytes per round. A live flow whose data has waited for
+ * CONFIG_APP_BW_SCHED_LIVE_BOUND_MS goes first regardless of its deficit.
+ */
+
+#ifndef BW_SCHED_H
+#define BW_SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/gatt.h>
+
+/**
+ * @brief Stream classes.
+ */
+enum bw_class {
+    BW_CLASS_LIVE,   ///< Latency bound
+    BW_CLASS_BULK,   ///< Throughput only
+};
+
+struct bw_flow;
+
+/**
+ * @brief Flow callbacks, called from the scheduler thread.
+ */
+struct bw_flow_ops {
+    /** Size of the next notification, 0 if there is nothing to send. */
+    size_t (*pending)(struct bw_flow *flow);
+    /** Queue the next notification, calling done once it is sent. */
+    int (*send)(struct bw_flow *flow, bt_gatt_complete_func_t done, void *user_data);
+};
+
+/**
+ * @brief Throughput and queueing counters of a flow.
+ */
+struct bw_flow_stats {
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t delay_sum_ms;   ///< Kick to queuing, summed over the packets
+    uint32_t delay_max_ms;
+};
+
+/**
+ * @brief A flow. Owned by its source, the fields are private to the scheduler.
+ */
+struct bw_flow {
+    const struct bw_flow_ops *ops;
+    struct bt_conn *conn;
+    enum bw_class cls;
+    int32_t deficit;
+    bool visited;           ///< Quantum added in the current round
+    bool waiting;           ///< Kicked, not sent yet
+    uint32_t kick_cyc;
+    int64_t start_ms;
+    struct bw_flow_stats stats;
+};
+
+/**
+ * @brief Register a flow.
+ *
+ * @param flow The flow, must stay valid until bw_sched_remove().
+ * @param conn The connection the flow sends on.
+ * @param cls The stream class.
+ * @param ops The flow callbacks.
+ * @return 0 on success, -ENOMEM if all flows are in use.
+ */
+int bw_sched_add(struct bw_flow *flow, struct bt_conn *conn, enum bw_class cls,
+                 const struct bw_flow_ops *ops);
+
+/**
+ * @brief Unregister a flow. Its notifications already queued are still sent.
+ */
+void bw_sched_remove(struct bw_flow *flow);
+
+/**
+ * @brief Signal that a flow has data to send. Can be called from an interrupt.
+ */
+void bw_sched_kick(struct bw_flow *flow);
+
+/**
+ * @brief Set the share of a client, applied to all its flows.
+ *
+ * @param conn The client connection.
+ * @param share Weight, from 1 to CONFIG_APP_BW_SCHED_MAX_SHARE.
+ * @return 0 on success, -EINVAL if the share is out of range.
+ */
+int bw_sched_set_share(struct bt_conn *conn, uint8_t share);
+
+/**
+ * @brief Print the share, throughput and queueing delay of every flow into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int bw_sched_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BW_SCHED_H */
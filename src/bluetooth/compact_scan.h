@@ -0,0 +1,68 @@
+/**
+ * @file compact_scan.h
+ * @brief Minimal scan payload for the long range (Coded PHY) profile.
+ *
+ * At 125 kbit/s every byte costs 64 µs of airtime, so the long range profile sends a reduced
+ * scan: the lowest battery voltage and the offset of each battery from it, instead of the
+ * cumulative taps. It fits in a single short PDU, in the advertising data as well as in a
+ * notification.
+ */
+
+#ifndef COMPACT_SCAN_H
+#define COMPACT_SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "../sensor/scan.h"
+#include "../sensor/pack_metrics.h"
+
+/** @brief Identifies a compact scan in the manufacturer data and its format version. */
+#define COMPACT_SCAN_MAGIC 0xB3
+
+/**
+ * @brief Compact scan. All fields are little-endian.
+ */
+struct compact_scan {
+    uint8_t magic;                                    ///< COMPACT_SCAN_MAGIC
+    uint8_t seq;                                      ///< Lower 8 bits of the scan sequence number
+    uint16_t pack_cv;                                 ///< Pack voltage in cV
+    uint16_t min_cell_cv;                             ///< Lowest battery voltage in cV
+    uint8_t cell_offset_cv[NUMBER_OF_BATTERIES_IN_SERIES]; ///< Battery minus lowest, saturated
+    int8_t temp_c;                                    ///< Internal temperature in °C
+    uint8_t alarms;                                   ///< Alarm bits, see enum pack_alarm
+} __packed;
+
+/**
+ * @brief Reduce a scan to its compact form.
+ *
+ * @param rec Scan record.
+ * @param m Metrics of the scan.
+ * @param out Destination.
+ */
+static inline void compact_scan_encode(const struct scan_record *rec,
+                                       const struct pack_metrics *m,
+                                       struct compact_scan *out)
+{
+    out->magic = COMPACT_SCAN_MAGIC;
+    out->seq = (uint8_t)rec->seq;
+    out->pack_cv = sys_cpu_to_le16(m->pack_cv);
+    out->min_cell_cv = sys_cpu_to_le16(m->min_cell_cv);
+    for (uint8_t i = 0; i < NUMBER_OF_BATTERIES_IN_SERIES; i++) {
+        out->cell_offset_cv[i] = MIN(m->cell_cv[i] - m->min_cell_cv, UINT8_MAX);
+    }
+    out->temp_c = CLAMP(rec->temp / 10, INT8_MIN, INT8_MAX);
+    out->alarms = (uint8_t)m->alarms;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPACT_SCAN_H */
@@ -0,0 +1,155 @@
+/**
+ * @file cts.c
+ * @brief Current Time Service (CTS) server used to receive wall-clock time from a client.
+ *
+ * The Current Time characteristic is readable, writable and notifiable. A client writes the
+ * current time (interpreted as UTC) to synchronize the device, and can read it back to verify.
+ * The other subscribed clients are notified of the new time with the "manual time update"
+ * adjust reason.
+ */
+
+#include <errno.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/timeutil.h>
+
+#include "cts.h"
+#include "../application/time_sync.h"
+
+/** @brief Adjust Reason flag: the time was changed by a client. */
+#define ADJUST_MANUAL_TIME_UPDATE BIT(0)
+
+static const struct bt_gatt_attr *current_time_attr(void);
+
+void cts_encode_current_time(int64_t wall_ms, uint8_t *value)
+{
+    time_t now = wall_ms / MSEC_PER_SEC;
+    struct tm tm;
+
+    gmtime_r(&now, &tm);
+
+    sys_put_le16(tm.tm_year + 1900, &value[0]);
+    value[2] = tm.tm_mon + 1;
+    value[3] = tm.tm_mday;
+    value[4] = tm.tm_hour;
+    value[5] = tm.tm_min;
+    value[6] = tm.tm_sec;
+    value[7] = tm.tm_wday == 0 ? 7 : tm.tm_wday;         // 1 = Monday ... 7 = Sunday
+    value[8] = (wall_ms % MSEC_PER_SEC) * 256 / MSEC_PER_SEC; // Fractions256
+    value[9] = 0;                                        // Adjust reason
+}
+
+/**
+ * @brief Read callback for the Current Time characteristic.
+ */
+static ssize_t read_current_time(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                 void *buf, uint16_t len, uint16_t offset)
+{
+    uint8_t value[CTS_CURRENT_TIME_LEN];
+
+    cts_encode_current_time(time_sync_now_ms(), value);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+/**
+ * @brief Number of days in a month.
+ *
+ * @param year Full year, e.g. 2024.
+ * @param month Month, 1 to 12.
+ */
+static uint8_t days_in_month(uint16_t year, uint8_t month)
+{
+    static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+    return (month == 2 && leap) ? 29 : days[month - 1];
+}
+
+/**
+ * @brief Notify a connection of the new time, unless it made the change.
+ */
+static void notify_time_update(struct bt_conn *conn, void *user_data)
+{
+    const struct bt_conn *writer = user_data;
+    const struct bt_gatt_attr *attr = current_time_attr();
+    uint8_t value[CTS_CURRENT_TIME_LEN];
+
+    if (conn == writer || !bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_NOTIFY)) {
+        return;
+    }
+
+    cts_encode_current_time(time_sync_now_ms(), value);
+    value[9] = ADJUST_MANUAL_TIME_UPDATE;
+    bt_gatt_notify(conn, attr, value, sizeof(value));
+}
+
+/**
+ * @brief Write callback for the Current Time characteristic, synchronizes the clock.
+ */
+static ssize_t write_current_time(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                  const void *buf, uint16_t len, uint16_t offset,
+                                  uint8_t flags)
+{
+    const uint8_t *value = buf;
+    struct tm tm = { 0 };
+    uint16_t year;
+    int64_t wall_ms;
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len != CTS_CURRENT_TIME_LEN) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    year = sys_get_le16(&value[0]);
+    if (value[2] < 1 || value[2] > 12 || value[3] < 1 ||
+        value[3] > days_in_month(year, value[2]) ||
+        value[4] > 23 || value[5] > 59 || value[6] > 59) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    tm.tm_year = year - 1900;
+    tm.tm_mon = value[2] - 1;
+    tm.tm_mday = value[3];
+    tm.tm_hour = value[4];
+    tm.tm_min = value[5];
+    tm.tm_sec = value[6];
+
+    wall_ms = timeutil_timegm64(&tm) * MSEC_PER_SEC + (value[8] * MSEC_PER_SEC) / 256;
+
+    if (time_sync_set(wall_ms)) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, notify_time_update, conn);
+
+    return len;
+}
+
+static void current_time_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    ARG_UNUSED(attr);
+    ARG_UNUSED(value);
+}
+
+BT_GATT_SERVICE_DEFINE(cts_svc,
+    BT_GATT_PRIMARY_SERVICE(BT_UUID_CTS),
+    BT_GATT_CHARACTERISTIC(BT_UUID_CTS_CURRENT_TIME,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                           read_current_time, write_current_time, NULL),
+    BT_GATT_CCC(current_time_ccc_changed,
+                BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
+
+static const struct bt_gatt_attr *current_time_attr(void)
+{
+    return &cts_svc.attrs[2];
+}
@@ -0,0 +1,30 @@
+/**
+ * @file cts.h
+ * @brief Current Time Service (CTS) helpers.
+ */
+
+#ifndef CTS_H
+#define CTS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @brief Length of the Current Time characteristic value (Exact Time 256 + Adjust Reason). */
+#define CTS_CURRENT_TIME_LEN 10
+
+/**
+ * @brief Encode a wall-clock time as a Current Time characteristic value (UTC).
+ *
+ * @param wall_ms Milliseconds since the Unix epoch.
+ * @param value Destination, CTS_CURRENT_TIME_LEN bytes.
+ */
+void cts_encode_current_time(int64_t wall_ms, uint8_t *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CTS_H */
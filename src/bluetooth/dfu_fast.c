@@ -0,0 +1,264 @@
+/**
+ * @file dfu_fast.c
+ * @brief Firmware update fast path over the SMP Bluetooth transport.
+ *
+ * The image management hooks mark the start and the end of an upload. The upload check hook
+ * runs for every chunk just before it is written to flash, and the command status hook when
+ * the upload command completes, so the time between the two is the flash write of the chunk.
+ * The SMP transport handles requests in its own work queue: with several transport buffers,
+ * the next chunks are received while one is being written.
+ *
+ * The callbacks do not tell which connection carries the upload, so the fast parameters are
+ * requested on every connection and the previous ones restored afterwards. Links on the Coded
+ * PHY are left alone: their peer is out of range of the 2M PHY. An upload that neither
+ * completes nor is stopped (the client gave up or the link dropped) ends after IDLE_TIMEOUT
+ * without a chunk, or at the first disconnection.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt_defines.h>
+#include <zephyr/mgmt/mcumgr/mgmt/callbacks.h>
+#include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt.h>
+
+#include "dfu_fast.h"
+
+#define FAST_INTERVAL_MIN 6    ///< 7.5 ms
+#define FAST_INTERVAL_MAX 12   ///< 15 ms
+#define FAST_TIMEOUT      400  ///< 4 s
+#define IDLE_TIMEOUT      K_SECONDS(10)  ///< Chunk inactivity ending an upload
+
+/**
+ * @brief Connection parameters to restore after the upload.
+ */
+struct saved_link {
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+    uint8_t tx_phy;
+    bool valid;
+};
+
+/**
+ * @brief Upload counters, for the last or the current upload.
+ */
+struct dfu_stats {
+    uint32_t bytes;
+    uint32_t chunks;
+    int64_t start_ms;
+    int64_t last_ms;
+    uint64_t write_us;      ///< Total time spent writing chunks
+    uint32_t write_max_us;  ///< Longest chunk write
+};
+
+static K_MUTEX_DEFINE(lock);
+static struct saved_link saved[CONFIG_BT_MAX_CONN];
+static struct dfu_stats stats;
+static bool active;
+static bool writing;          ///< A chunk was handed to flash and its command is not done
+static uint32_t write_start;  ///< Cycle count when the chunk in progress was handed to flash
+
+static void link_fast(struct bt_conn *conn, void *user_data)
+{
+    struct saved_link *s = &saved[bt_conn_index(conn)];
+    struct bt_conn_info info;
+    int err;
+
+    if (bt_conn_get_info(conn, &info) || info.state != BT_CONN_STATE_CONNECTED) {
+        return;
+    }
+
+    // A long range link would be lost on the 2M PHY, keep its parameters
+    if (info.le.phy->tx_phy == BT_GAP_LE_PHY_CODED ||
+        info.le.phy->rx_phy == BT_GAP_LE_PHY_CODED) {
+        return;
+    }
+
+    s->interval = info.le.interval;
+    s->latency = info.le.latency;
+    s->timeout = info.le.timeout;
+    s->tx_phy = info.le.phy->tx_phy;
+    s->valid = true;
+
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err) {
+        printk("DFU: PHY update failed (err %d)\n", err);
+    }
+
+    err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (err) {
+        printk("DFU: data length update failed (err %d)\n", err);
+    }
+
+    err = bt_conn_le_param_update(conn, BT_LE_CONN_PARAM(FAST_INTERVAL_MIN, FAST_INTERVAL_MAX,
+                                                         0, FAST_TIMEOUT));
+    if (err) {
+        printk("DFU: connection parameter update failed (err %d)\n", err);
+    }
+}
+
+static void link_restore(struct bt_conn *conn, void *user_data)
+{
+    struct saved_link *s = &saved[bt_conn_index(conn)];
+    struct bt_conn_le_phy_param phy = {
+        .options = BT_CONN_LE_PHY_OPT_NONE,
+    };
+
+    if (!s->valid) {
+        return;
+    }
+    s->valid = false;
+
+    phy.pref_tx_phy = s->tx_phy;
+    phy.pref_rx_phy = s->tx_phy;
+    bt_conn_le_phy_update(conn, &phy);
+    bt_conn_le_param_update(conn, BT_LE_CONN_PARAM(s->interval, s->interval, s->latency,
+                                                   s->timeout));
+}
+
+static void upload_started(void)
+{
+    k_mutex_lock(&lock, K_FOREVER);
+    if (!active) {
+        active = true;
+        stats = (struct dfu_stats){ .start_ms = k_uptime_get() };
+        bt_conn_foreach(BT_CONN_TYPE_LE, link_fast, NULL);
+    }
+    k_mutex_unlock(&lock);
+}
+
+static void upload_ended(void)
+{
+    k_mutex_lock(&lock, K_FOREVER);
+    if (active) {
+        active = false;
+        bt_conn_foreach(BT_CONN_TYPE_LE, link_restore, NULL);
+    }
+    k_mutex_unlock(&lock);
+}
+
+static void idle_handler(struct k_work *work)
+{
+    upload_ended();
+}
+
+static K_WORK_DELAYABLE_DEFINE(idle_work, idle_handler);
+
+static enum mgmt_cb_return img_event(uint32_t event, enum mgmt_cb_return prev_status,
+                                     int32_t *rc, uint16_t *group, bool *abort_more,
+                                     void *data, size_t data_size)
+{
+    const struct img_mgmt_upload_check *check = data;
+
+    switch (event) {
+    case MGMT_EVT_OP_IMG_MGMT_DFU_STARTED:
+        upload_started();
+        break;
+
+    case MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK:
+        // The first chunk of a resumed upload does not raise DFU_STARTED
+        upload_started();
+        k_mutex_lock(&lock, K_FOREVER);
+        stats.bytes += check->req->img_data.len;
+        stats.chunks++;
+        stats.last_ms = k_uptime_get();
+        writing = true;
+        write_start = k_cycle_get_32();
+        k_mutex_unlock(&lock);
+        k_work_reschedule(&idle_work, IDLE_TIMEOUT);
+        break;
+
+    case MGMT_EVT_OP_IMG_MGMT_DFU_STOPPED:
+    case MGMT_EVT_OP_IMG_MGMT_DFU_PENDING:
+        k_work_cancel_delayable(&idle_work);
+        upload_ended();
+        break;
+
+    default:
+        break;
+    }
+
+    return MGMT_CB_OK;
+}
+
+static enum mgmt_cb_return cmd_event(uint32_t event, enum mgmt_cb_return prev_status,
+                                     int32_t *rc, uint16_t *group, bool *abort_more,
+                                     void *data, size_t data_size)
+{
+    const struct mgmt_evt_op_cmd_arg *cmd = data;
+    uint32_t us;
+
+    if (cmd->group != MGMT_GROUP_ID_IMAGE || cmd->id != IMG_MGMT_ID_UPLOAD) {
+        return MGMT_CB_OK;
+    }
+
+    // DFU_PENDING ends the upload before the command of the last chunk is done
+    k_mutex_lock(&lock, K_FOREVER);
+    if (writing) {
+        writing = false;
+        us = k_cyc_to_us_floor32(k_cycle_get_32() - write_start);
+        stats.write_us += us;
+        stats.write_max_us = MAX(stats.write_max_us, us);
+    }
+    k_mutex_unlock(&lock);
+
+    return MGMT_CB_OK;
+}
+
+static struct mgmt_callback img_callback = {
+    .callback = img_event,
+    .event_id = MGMT_EVT_OP_IMG_MGMT_ALL,
+};
+
+static struct mgmt_callback cmd_callback = {
+    .callback = cmd_event,
+    .event_id = MGMT_EVT_OP_CMD_DONE,
+};
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    saved[bt_conn_index(conn)].valid = false;
+
+    // The upload may have been on this link. If it goes on over another one, its next chunk
+    // starts the fast path again
+    k_mutex_lock(&lock, K_FOREVER);
+    if (active) {
+        k_work_reschedule(&idle_work, K_NO_WAIT);
+    }
+    k_mutex_unlock(&lock);
+}
+
+BT_CONN_CB_DEFINE(dfu_fast_conn_callbacks) = {
+    .disconnected = disconnected,
+};
+
+void dfu_fast_init(void)
+{
+    mgmt_callback_register(&img_callback);
+    mgmt_callback_register(&cmd_callback);
+}
+
+int dfu_fast_format_status(char *buf, size_t buf_size)
+{
+    struct dfu_stats s;
+    bool running;
+    int64_t elapsed_ms;
+
+    k_mutex_lock(&lock, K_FOREVER);
+    s = stats;
+    running = active;
+    k_mutex_unlock(&lock);
+
+    elapsed_ms = s.last_ms - s.start_ms;
+
+    return snprintf(buf, buf_size,
+                    "dfu %s bytes %u rate %u B/s chunks %u write total %u ms avg %u max %u us\n",
+                    running ? "active" : "idle", s.bytes,
+                    elapsed_ms > 0 ? (uint32_t)((uint64_t)s.bytes * MSEC_PER_SEC / elapsed_ms) : 0,
+                    s.chunks, (uint32_t)(s.write_us / USEC_PER_MSEC),
+                    s.chunks ? (uint32_t)(s.write_us / s.chunks) : 0, s.write_max_us);
+}
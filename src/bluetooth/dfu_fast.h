@@ -0,0 +1,38 @@
+/**
+ * @file dfu_fast.h
+ * @brief Firmware update fast path over the SMP Bluetooth transport.
+ *
+ * While an image upload is active, every connection is switched to the 2M PHY, the largest
+ * data length and a short connection interval, and restored when the upload ends. The upload
+ * throughput and the time spent writing each chunk to flash (during which the SMP transport
+ * queues the next requests) are recorded for the NUS command "dfu".
+ */
+
+#ifndef DFU_FAST_H
+#define DFU_FAST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * @brief Register the MCUmgr callbacks.
+ */
+void dfu_fast_init(void);
+
+/**
+ * @brief Print the upload throughput and flash write stalls into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int dfu_fast_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DFU_FAST_H */
@@ -0,0 +1,207 @@
+/**
+ * @file ess.c
+ * @brief Environmental Sensing Service with a trigger-driven Temperature characteristic.
+ *
+ * Reads are served from the cached temperature. Notifications are evaluated once per scan
+ * against the ES Trigger Setting, so subscribed clients only hear about the conditions they
+ * configured.
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "ess.h"
+
+/** @brief Trigger conditions of the ES Trigger Setting descriptor. */
+enum ess_condition {
+    ESS_TRIGGER_INACTIVE      = 0x00,
+    ESS_TRIGGER_FIXED_TIME    = 0x01, ///< Operand: uint24 seconds
+    ESS_TRIGGER_MIN_TIME      = 0x02, ///< Operand: uint24 seconds
+    ESS_TRIGGER_CHANGED       = 0x03,
+    ESS_TRIGGER_LESS          = 0x04, ///< Operand: value
+    ESS_TRIGGER_LESS_EQUAL    = 0x05,
+    ESS_TRIGGER_GREATER       = 0x06,
+    ESS_TRIGGER_GREATER_EQUAL = 0x07,
+    ESS_TRIGGER_EQUAL         = 0x08,
+    ESS_TRIGGER_NOT_EQUAL     = 0x09,
+};
+
+#if defined(CONFIG_BT_LBS_SECURITY_ENABLED)
+#define TRIGGER_WRITE_PERM BT_GATT_PERM_WRITE_ENCRYPT
+#else
+#define TRIGGER_WRITE_PERM BT_GATT_PERM_WRITE
+#endif
+
+/**
+ * @brief Trigger setting, condition and operand.
+ */
+struct ess_trigger {
+    uint8_t condition;
+    uint32_t seconds;  ///< Operand of the time conditions
+    int16_t value;     ///< Operand of the value conditions, in 0.01 °C
+};
+
+static struct ess_trigger trigger = {
+    .condition = ESS_TRIGGER_MIN_TIME,
+    .seconds = CONFIG_APP_ESS_DEFAULT_INTERVAL_S,
+};
+
+static bool notify_enabled;
+static bool have_value;
+static int16_t temperature;      ///< Latest temperature in 0.01 °C
+static bool have_notified;
+static int16_t notified;         ///< Last notified temperature
+static int64_t notified_uptime;  ///< When it was notified
+
+static void temp_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+}
+
+static ssize_t read_temperature(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                void *buf, uint16_t len, uint16_t offset)
+{
+    int16_t value = sys_cpu_to_le16(temperature);
+
+    if (!have_value) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+static ssize_t read_trigger(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                            void *buf, uint16_t len, uint16_t offset)
+{
+    uint8_t value[4] = { trigger.condition };
+    uint16_t size = 1;
+
+    if (trigger.condition == ESS_TRIGGER_FIXED_TIME ||
+        trigger.condition == ESS_TRIGGER_MIN_TIME) {
+        sys_put_le24(trigger.seconds, &value[1]);
+        size = 4;
+    } else if (trigger.condition >= ESS_TRIGGER_LESS) {
+        sys_put_le16(trigger.value, &value[1]);
+        size = 3;
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, size);
+}
+
+static ssize_t write_trigger(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                             const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    const uint8_t *value = buf;
+    struct ess_trigger next = { 0 };
+
+    if (offset != 0 || len == 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    next.condition = value[0];
+    switch (next.condition) {
+    case ESS_TRIGGER_INACTIVE:
+    case ESS_TRIGGER_CHANGED:
+        if (len != 1) {
+            return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+        }
+        break;
+    case ESS_TRIGGER_FIXED_TIME:
+    case ESS_TRIGGER_MIN_TIME:
+        if (len != 4) {
+            return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+        }
+        next.seconds = sys_get_le24(&value[1]);
+        break;
+    case ESS_TRIGGER_LESS:
+    case ESS_TRIGGER_LESS_EQUAL:
+    case ESS_TRIGGER_GREATER:
+    case ESS_TRIGGER_GREATER_EQUAL:
+    case ESS_TRIGGER_EQUAL:
+    case ESS_TRIGGER_NOT_EQUAL:
+        if (len != 3) {
+            return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+        }
+        next.value = sys_get_le16(&value[1]);
+        break;
+    default:
+        return BT_GATT_ERR(BT_ATT_ERR_WRITE_REQ_REJECTED);
+    }
+
+    trigger = next;
+    return len;
+}
+
+/**
+ * @brief Environmental Sensing Service GATT Declaration.
+ */
+BT_GATT_SERVICE_DEFINE(ess_svc,
+    BT_GATT_PRIMARY_SERVICE(BT_UUID_ESS),
+    BT_GATT_CHARACTERISTIC(BT_UUID_TEMPERATURE,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ, read_temperature, NULL,
+                           NULL),
+    BT_GATT_CCC(temp_ccc_cfg_changed,                // CCCD for notifications
+                BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+    BT_GATT_DESCRIPTOR(BT_UUID_ES_TRIGGER_SETTING,
+                       BT_GATT_PERM_READ | TRIGGER_WRITE_PERM,
+                       read_trigger, write_trigger, NULL),
+);
+
+/**
+ * @brief Evaluate the trigger condition for a new temperature.
+ */
+static bool trigger_met(int16_t value, int64_t now)
+{
+    bool changed = !have_notified || value != notified;
+    bool elapsed = now - notified_uptime >= (int64_t)trigger.seconds * MSEC_PER_SEC;
+
+    switch (trigger.condition) {
+    case ESS_TRIGGER_FIXED_TIME:
+        return elapsed;
+    case ESS_TRIGGER_MIN_TIME:
+        return changed && elapsed;
+    case ESS_TRIGGER_CHANGED:
+        return changed;
+    // Comparisons are evaluated on new values, so a steady value is notified once
+    case ESS_TRIGGER_LESS:
+        return changed && value < trigger.value;
+    case ESS_TRIGGER_LESS_EQUAL:
+        return changed && value <= trigger.value;
+    case ESS_TRIGGER_GREATER:
+        return changed && value > trigger.value;
+    case ESS_TRIGGER_GREATER_EQUAL:
+        return changed && value >= trigger.value;
+    case ESS_TRIGGER_EQUAL:
+        return changed && value == trigger.value;
+    case ESS_TRIGGER_NOT_EQUAL:
+        return changed && value != trigger.value;
+    default:
+        return false;
+    }
+}
+
+void ess_update_temperature(int16_t temp)
+{
+    int16_t value = temp * 10;
+    int64_t now = k_uptime_get();
+    int16_t le;
+
+    temperature = value;
+    have_value = true;
+
+    if (!notify_enabled || !trigger_met(value, now)) {
+        return;
+    }
+
+    le = sys_cpu_to_le16(value);
+    if (bt_gatt_notify(NULL, &ess_svc.attrs[2], &le, sizeof(le)) == 0) {
+        have_notified = true;
+        notified = value;
+        notified_uptime = now;
+    }
+}
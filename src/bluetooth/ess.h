@@ -0,0 +1,30 @@
+/**
+ * @file ess.h
+ * @brief Environmental Sensing Service with the temperature of the monitor.
+ *
+ * The Temperature characteristic (sint16, 0.01 °C) has an ES Trigger Setting descriptor that
+ * selects when notifications are sent: inactive, at a fixed interval, on change, on change
+ * no more often than an interval, or while the value compares to an operand.
+ */
+
+#ifndef ESS_H
+#define ESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Update the temperature and notify it if the trigger condition is met.
+ *
+ * @param temp Temperature in 1/10 °C.
+ */
+void ess_update_temperature(int16_t temp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ESS_H */
@@ -0,0 +1,241 @@
+/**
+ * @file history_blob.c
+ * @brief Storage log served over plain GATT with long reads.
+ *
+ * The History value is never materialized: a read at offset N covers the samples
+ * N / sizeof(struct frame_history) onwards, which are read from NVS and encoded one at a
+ * time into the ATT response. The storage log never lets sample times decrease with the
+ * sequence number (see history_read()), so the cursor range is resolved with two binary
+ * searches over the sequence numbers of the storage log.
+ *
+ * All the GATT and connection callbacks run in the Bluetooth RX thread, the per connection
+ * state needs no lock.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "history_blob.h"
+#include "../sensor/main_voltage.h"
+
+#define RECORD_SIZE sizeof(struct frame_history)
+
+/**
+ * @brief Cursor of a connection. The range is the whole log until the client writes one.
+ */
+struct cursor_state {
+    int64_t from_ms;
+    int64_t to_ms;
+    uint32_t first;
+    uint16_t count;
+};
+
+static struct cursor_state cursors[CONFIG_BT_MAX_CONN];
+
+static void cursor_reset(struct cursor_state *c)
+{
+    c->from_ms = INT64_MIN;
+    c->to_ms = INT64_MAX;
+    c->first = 0;
+    c->count = 0;
+}
+
+/**
+ * @brief Find the first sample of the storage log at or after a time.
+ *
+ * @param time_ms Time searched.
+ * @param after Find the first sample strictly after time_ms instead.
+ * @param first Sequence number of the oldest sample in the storage log.
+ * @param end Sequence number following the newest sample.
+ * @param seq Destination for the sequence number of the sample, end if there is none.
+ * @return 0 on success, or a negative error code.
+ */
+static int lower_bound(int64_t time_ms, bool after, uint32_t first, uint32_t end, uint32_t *seq)
+{
+    uint32_t lo = first;
+    uint32_t hi = end;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint16_t values[TOTAL_CHANNELS];
+        int64_t t;
+        int err = history_read(mid, &t, values);
+
+        // Overwritten by a newer scan since the range was taken, older than the rest
+        if (err == -ENOENT) {
+            lo = mid + 1;
+            continue;
+        }
+        if (err) {
+            return err;
+        }
+
+        if (t < time_ms || (after && t == time_ms)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *seq = lo;
+    return 0;
+}
+
+/**
+ * @brief Resolve the range of a cursor against the current storage log.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+static int cursor_resolve(struct cursor_state *c)
+{
+    uint32_t log_first;
+    uint32_t log_end;
+    uint32_t first;
+    uint32_t end;
+    int err;
+
+    history_range(&log_first, &log_end);
+    err = lower_bound(c->from_ms, false, log_first, log_end, &first);
+    if (err) {
+        return err;
+    }
+
+    err = lower_bound(c->to_ms, true, log_first, log_end, &end);
+    if (err) {
+        return err;
+    }
+
+    c->first = first;
+    c->count = MIN(end > first ? end - first : 0, HISTORY_BLOB_MAX_RECORDS);
+
+    return 0;
+}
+
+static ssize_t read_cursor(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                           void *buf, uint16_t len, uint16_t offset)
+{
+    struct cursor_state *c = &cursors[bt_conn_index(conn)];
+    struct history_cursor value;
+
+    if (offset == 0 && cursor_resolve(c)) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+
+    value.from_ms = sys_cpu_to_le64(c->from_ms);
+    value.to_ms = sys_cpu_to_le64(c->to_ms);
+    value.first = sys_cpu_to_le32(c->first);
+    value.count = sys_cpu_to_le16(c->count);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+static ssize_t write_cursor(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                            const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    struct cursor_state *c = &cursors[bt_conn_index(conn)];
+    const uint8_t *p = buf;
+    int64_t from_ms;
+    int64_t to_ms;
+
+    if (offset != 0 || (len != 2 * sizeof(int64_t) && len != sizeof(struct history_cursor))) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    from_ms = (int64_t)sys_get_le64(p);
+    to_ms = (int64_t)sys_get_le64(p + sizeof(int64_t));
+    if (to_ms < from_ms) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    c->from_ms = from_ms;
+    c->to_ms = to_ms;
+    if (cursor_resolve(c)) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+
+    return len;
+}
+
+/**
+ * @brief Serve a slice of the History value, encoding only the samples it covers.
+ */
+static ssize_t read_history(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                            void *buf, uint16_t len, uint16_t offset)
+{
+    struct cursor_state *c = &cursors[bt_conn_index(conn)];
+    uint8_t *out = buf;
+    size_t total;
+    uint16_t written = 0;
+
+    // A read at offset 0 starts a new long read, take a fresh snapshot of the log
+    if (offset == 0 && cursor_resolve(c)) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+
+    total = (size_t)c->count * RECORD_SIZE;
+    if (offset > total) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    len = MIN(len, total - offset);
+
+    while (written < len) {
+        size_t pos = offset + written;
+        uint16_t i = pos / RECORD_SIZE;
+        size_t skip = pos % RECORD_SIZE;
+        size_t n = MIN(RECORD_SIZE - skip, (size_t)(len - written));
+        struct frame_history rec = { .seq = c->first + i };
+        uint16_t values[TOTAL_CHANNELS];
+        int64_t time_ms;
+
+        // The sample was overwritten during the long read, end the value here
+        if (history_read(c->first + i, &time_ms, values)) {
+            break;
+        }
+
+        // The record is packed, read into aligned locals
+        rec.time_ms = time_ms;
+        memcpy(rec.tap_cv, values, sizeof(values));
+        memcpy(&out[written], (const uint8_t *)&rec + skip, n);
+        written += n;
+    }
+
+    if (written == 0 && len > 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+
+    return written;
+}
+
+BT_GATT_SERVICE_DEFINE(history_svc,
+    BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_128(BT_UUID_HISTORY_VAL)),
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(BT_UUID_HISTORY_CURSOR_VAL),
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                           read_cursor, write_cursor, NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_GATT_CUD,
+                       BT_GATT_PERM_READ,
+                       NULL, NULL, "History cursor"),
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(BT_UUID_HISTORY_DATA_VAL),
+                           BT_GATT_CHRC_READ,
+                           BT_GATT_PERM_READ,
+                           read_history, NULL, NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_GATT_CUD,
+                       BT_GATT_PERM_READ,
+                       NULL, NULL, "History"),
+);
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    if (!err) {
+        cursor_reset(&cursors[bt_conn_index(conn)]);
+    }
+}
+
+BT_CONN_CB_DEFINE(history_blob_conn_callbacks) = {
+    .connected = connected,
+};
@@ -0,0 +1,63 @@
+/**
+ * @file history_blob.h
+ * @brief Storage log served over plain GATT with long reads.
+ *
+ * The History service exposes two characteristics:
+ * - History Cursor (read/write): struct history_cursor, the time range to read. Reading it
+ *   returns the range and the samples it resolves to.
+ * - History (read only): the samples of the range, one struct frame_history each (see
+ *   frame.h), oldest first. A client reads it with ATT Read Blob requests: each offset is
+ *   served by reading the samples it covers from the storage log, nothing is staged in RAM.
+ *
+ * The range is resolved against the storage log when the cursor is written and again by
+ * every read at offset 0, so a long read sees a stable set of samples: samples are addressed
+ * by sequence number, new scans do not shift them. A sample overwritten by the ring during
+ * the long read ends the value early. ATT offsets are 16 bit:
+ * a range larger than HISTORY_BLOB_MAX_RECORDS samples is truncated, the client moves the
+ * cursor past the last sample received and reads again.
+ */
+
+#ifndef HISTORY_BLOB_H
+#define HISTORY_BLOB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+#include "../output/frame.h"
+
+/** @brief History Service UUID. */
+#define BT_UUID_HISTORY_VAL \
+    BT_UUID_128_ENCODE(0x00001200, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
+/** @brief History Cursor Characteristic UUID, struct history_cursor of the connection. */
+#define BT_UUID_HISTORY_CURSOR_VAL \
+    BT_UUID_128_ENCODE(0x00001201, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
+/** @brief History Characteristic UUID, the samples selected by the cursor. */
+#define BT_UUID_HISTORY_DATA_VAL \
+    BT_UUID_128_ENCODE(0x00001202, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
+/** @brief Most samples served by one long read of the History characteristic. */
+#define HISTORY_BLOB_MAX_RECORDS (UINT16_MAX / sizeof(struct frame_history))
+
+/**
+ * @brief Value of the History Cursor characteristic. All fields are little-endian.
+ *
+ * Clients write from_ms and to_ms (16 bytes), the other fields are ignored on write.
+ */
+struct history_cursor {
+    int64_t from_ms;   ///< First sample time included, in ms (see time_sync.h)
+    int64_t to_ms;     ///< Last sample time included, in ms
+    uint32_t first;    ///< Sequence number of the first sample in range
+    uint16_t count;    ///< Samples served, the History value is count frame_history long
+} __packed;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HISTORY_BLOB_H */
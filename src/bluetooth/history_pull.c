@@ -0,0 +1,246 @@
+/**
+ * @file history_pull.c
+ * @brief Storage log transfers, one bulk flow per client.
+ *
+ * The next notification is formatted when the scheduler asks for its size, and kept until
+ * it is sent. Notifications go straight to the NUS TX characteristic with a completion
+ * callback, which bt_nus_send() does not offer.
+ *
+ * The scheduler calls pending() with its lock held, so pull_lock is never held while calling
+ * into the scheduler: a transfer is closed under pull_lock, and its flow removed afterwards.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <bluetooth/services/nus.h>
+
+#include "history_pull.h"
+#include "bw_sched.h"
+#include "buf_stats.h"
+#include "../sensor/main_voltage.h"
+
+#define MAX_PULLS   CONFIG_BT_MAX_CONN
+#define MAX_NOTIFY  (CONFIG_BT_L2CAP_TX_MTU - 3)
+#define MAX_LINE    (6 + 21 + TOTAL_CHANNELS * 6 + 1)
+
+/**
+ * @brief Transfer to a client.
+ */
+struct pull {
+    struct bw_flow flow;
+    bool registered;        ///< Flow registered with the scheduler
+    struct bt_conn *conn;   ///< NULL once the transfer is over
+    uint32_t next;          ///< Sequence number of the next sample to format
+    uint32_t end;
+    uint16_t count;         ///< Samples formatted
+    bool done;              ///< End line formatted
+    uint16_t len;           ///< Formatted notification, 0 if none
+    char buf[MAX_NOTIFY];
+};
+
+static K_MUTEX_DEFINE(pull_lock);
+static struct pull pulls[MAX_PULLS];
+static const struct bt_gatt_attr *nus_tx;
+
+/**
+ * @brief Format the next notification. Must be called with pull_lock held.
+ */
+static void stage_locked(struct pull *pull)
+{
+    size_t max = MIN(bt_gatt_get_mtu(pull->conn) - 3, sizeof(pull->buf));
+    char line[MAX_LINE];
+
+    while (!pull->done) {
+        int64_t time_ms;
+        uint16_t values[TOTAL_CHANNELS];
+        int n;
+
+        if (pull->next < pull->end) {
+            if (history_read(pull->next, &time_ms, values)) {
+                pull->next++;
+                continue;
+            }
+            n = snprintf(line, sizeof(line), "%u,%lld", pull->next, time_ms);
+            for (uint8_t i = 0; i < TOTAL_CHANNELS; i++) {
+                n += snprintf(line + n, sizeof(line) - n, ",%u", values[i]);
+            }
+            n += snprintf(line + n, sizeof(line) - n, "\n");
+        } else {
+            n = snprintf(line, sizeof(line), "hist end %u\n", pull->count);
+        }
+
+        if (pull->len + n > max) {
+            if (pull->len == 0) {
+                // Line longer than the MTU, send it truncated
+                n = max;
+            } else {
+                return;
+            }
+        }
+
+        memcpy(&pull->buf[pull->len], line, n);
+        pull->len += n;
+        if (pull->next < pull->end) {
+            pull->next++;
+            pull->count++;
+        } else {
+            pull->done = true;
+        }
+    }
+}
+
+static size_t pending(struct bw_flow *flow)
+{
+    struct pull *pull = CONTAINER_OF(flow, struct pull, flow);
+    size_t len;
+
+    k_mutex_lock(&pull_lock, K_FOREVER);
+    if (pull->conn != NULL && pull->len == 0) {
+        stage_locked(pull);
+    }
+    len = pull->conn != NULL ? pull->len : 0;
+    k_mutex_unlock(&pull_lock);
+
+    return len;
+}
+
+/**
+ * @brief Unregister the flow of a closed transfer. Must be called without pull_lock held.
+ *
+ * @param pull The transfer.
+ * @param conn Its connection, as it was before the transfer was closed.
+ */
+static void release(struct pull *pull, struct bt_conn *conn)
+{
+    bw_sched_remove(&pull->flow);
+    bt_conn_unref(conn);
+
+    k_mutex_lock(&pull_lock, K_FOREVER);
+    pull->registered = false;
+    k_mutex_unlock(&pull_lock);
+}
+
+static int send(struct bw_flow *flow, bt_gatt_complete_func_t done, void *user_data)
+{
+    struct pull *pull = CONTAINER_OF(flow, struct pull, flow);
+    struct bt_conn *closed = NULL;
+    struct bt_gatt_notify_params params = {
+        .attr = nus_tx,
+        .data = pull->buf,
+        .func = done,
+        .user_data = user_data,
+    };
+    int err;
+
+    k_mutex_lock(&pull_lock, K_FOREVER);
+    if (pull->conn == NULL || pull->len == 0) {
+        k_mutex_unlock(&pull_lock);
+        return -ENOTCONN;
+    }
+
+    params.len = pull->len;
+    err = bt_gatt_notify_cb(pull->conn, &params);
+    if (IS_ENABLED(CONFIG_APP_BUF_STATS)) {
+        buf_stats_tx(pull->conn, params.len, err);
+    }
+    if (err == 0) {
+        pull->len = 0;
+        if (pull->done) {
+            closed = pull->conn;
+            pull->conn = NULL;
+        }
+    }
+    k_mutex_unlock(&pull_lock);
+
+    if (closed != NULL) {
+        release(pull, closed);
+    }
+
+    return err;
+}
+
+static const struct bw_flow_ops pull_ops = {
+    .pending = pending,
+    .send = send,
+};
+
+int history_pull_start(struct bt_conn *conn, uint32_t from)
+{
+    struct pull *pull = NULL;
+    uint32_t first;
+    uint32_t end;
+    int err;
+
+    if (nus_tx == NULL) {
+        nus_tx = bt_gatt_find_by_uuid(NULL, 0, BT_UUID_NUS_TX);
+    }
+    if (nus_tx == NULL || !bt_gatt_is_subscribed(conn, nus_tx, BT_GATT_CCC_NOTIFY)) {
+        return -EACCES;
+    }
+
+    k_mutex_lock(&pull_lock, K_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(pulls); i++) {
+        if (pulls[i].conn == conn) {
+            k_mutex_unlock(&pull_lock);
+            return -EBUSY;
+        }
+        if (!pulls[i].registered && pull == NULL) {
+            pull = &pulls[i];
+        }
+    }
+
+    if (pull == NULL) {
+        k_mutex_unlock(&pull_lock);
+        return -ENOMEM;
+    }
+
+    // Reserve the transfer, it has nothing to send until the flow is registered
+    pull->registered = true;
+    pull->conn = bt_conn_ref(conn);
+    history_range(&first, &end);
+    pull->next = MAX(from, first);
+    pull->end = end;
+    pull->count = 0;
+    pull->done = false;
+    pull->len = 0;
+    k_mutex_unlock(&pull_lock);
+
+    err = bw_sched_add(&pull->flow, conn, BW_CLASS_BULK, &pull_ops);
+    if (err) {
+        k_mutex_lock(&pull_lock, K_FOREVER);
+        pull->conn = NULL;
+        pull->registered = false;
+        k_mutex_unlock(&pull_lock);
+        bt_conn_unref(conn);
+        return err;
+    }
+
+    bw_sched_kick(&pull->flow);
+    return 0;
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(pulls); i++) {
+        struct bt_conn *closed = NULL;
+
+        k_mutex_lock(&pull_lock, K_FOREVER);
+        if (pulls[i].conn == conn) {
+            closed = pulls[i].conn;
+            pulls[i].conn = NULL;
+        }
+        k_mutex_unlock(&pull_lock);
+
+        if (closed != NULL) {
+            release(&pulls[i], closed);
+        }
+    }
+}
+
+BT_CONN_CB_DEFINE(history_pull_conn_callbacks) = {
+    .disconnected = disconnected,
+};
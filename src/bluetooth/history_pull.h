@@ -0,0 +1,35 @@
+/**
+ * @file history_pull.h
+ * @brief Transfer of the storage log to one client over NUS.
+ *
+ * The log is sent as CSV lines "<seq>,<time ms>,<tap 1>,...,<tap N>", as many per
+ * notification as the ATT MTU allows, followed by "hist end <count>". The transfer is a bulk
+ * flow of the bandwidth scheduler (see bw_sched.h), so it does not delay the live streams.
+ */
+
+#ifndef HISTORY_PULL_H
+#define HISTORY_PULL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+struct bt_conn;
+
+/**
+ * @brief Start sending the storage log to a client.
+ *
+ * @param conn The client, subscribed to the NUS TX characteristic.
+ * @param from Sequence number of the first sample, older samples are skipped.
+ * @return 0 on success, -EBUSY if a transfer to this client is running, -EACCES if the client
+ *         is not subscribed, or another negative error code.
+ */
+int history_pull_start(struct bt_conn *conn, uint32_t from);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HISTORY_PULL_H */
@@ -0,0 +1,126 @@
+/**
+ * @file long_range.c
+ * @brief Connectable advertising on the LE Coded PHY with the compact scan.
+ *
+ * Connectable extended advertising cannot be scannable, so everything is in the advertising
+ * data: flags and the compact scan as manufacturer data, well within a single PDU. The set
+ * stops when any central connects to the peripheral and restarts once it is released.
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+
+#include "long_range.h"
+#include "compact_scan.h"
+#include "adv_telemetry.h"
+
+/**
+ * @brief Manufacturer data of the Coded PHY advertising.
+ */
+struct long_range_data {
+    uint16_t company;              ///< ADV_TELEMETRY_COMPANY_ID
+    struct compact_scan scan;
+} __packed;
+
+static struct long_range_data mfg_data = {
+    .company = sys_cpu_to_le16(ADV_TELEMETRY_COMPANY_ID),
+    .scan.magic = COMPACT_SCAN_MAGIC,
+};
+
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, &mfg_data, sizeof(mfg_data)),
+};
+
+static struct bt_le_ext_adv *coded_adv;
+static bool peripheral_connected;
+
+static void start(void)
+{
+    int err = bt_le_ext_adv_start(coded_adv, BT_LE_EXT_ADV_START_DEFAULT);
+
+    if (err && err != -EALREADY) {
+        printk("Coded PHY advertising failed to start (err %d)\n", err);
+    }
+}
+
+int long_range_init(void)
+{
+    const struct bt_le_adv_param param = BT_LE_ADV_PARAM_INIT(
+        BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_EXT_ADV | BT_LE_ADV_OPT_CODED,
+        BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX, NULL);
+    int err;
+
+    err = bt_le_ext_adv_create(&param, NULL, &coded_adv);
+    if (err) {
+        printk("Failed to create the Coded PHY advertising set (err %d)\n", err);
+        return err;
+    }
+
+    err = bt_le_ext_adv_set_data(coded_adv, ad, ARRAY_SIZE(ad), NULL, 0);
+    if (err) {
+        printk("Failed to set the Coded PHY advertising data (err %d)\n", err);
+        return err;
+    }
+
+    start();
+    return 0;
+}
+
+void long_range_update(const struct compact_scan *scan)
+{
+    int err;
+
+    if (coded_adv == NULL) {
+        return;
+    }
+
+    mfg_data.scan = *scan;
+    err = bt_le_ext_adv_set_data(coded_adv, ad, ARRAY_SIZE(ad), NULL, 0);
+    if (err && err != -EAGAIN) {
+        printk("Coded PHY advertising data update failed (err %d)\n", err);
+    }
+}
+
+static bool is_peripheral(struct bt_conn *conn)
+{
+    struct bt_conn_info info;
+
+    return bt_conn_get_info(conn, &info) == 0 && info.role == BT_CONN_ROLE_PERIPHERAL;
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    if (err || !is_peripheral(conn) || coded_adv == NULL) {
+        return;
+    }
+
+    // Whichever set the central used, the other one must not accept a second connection
+    peripheral_connected = true;
+    bt_le_ext_adv_stop(coded_adv);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    if (is_peripheral(conn)) {
+        peripheral_connected = false;
+    }
+}
+
+static void recycled(void)
+{
+    if (!peripheral_connected && coded_adv != NULL) {
+        start();
+    }
+}
+
+BT_CONN_CB_DEFINE(long_range_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+    .recycled = recycled,
+};
@@ -0,0 +1,38 @@
+/**
+ * @file long_range.h
+ * @brief Long range profile: connectable advertising on the LE Coded PHY.
+ *
+ * A second, extended advertising set runs on the Coded PHY next to the legacy advertising,
+ * carrying the compact scan (see compact_scan.h) so a gateway out of 1M range can both
+ * collect the telemetry and connect. Connections switch PHY with the link quality, see
+ * tx_power.h.
+ */
+
+#ifndef LONG_RANGE_H
+#define LONG_RANGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct compact_scan;
+
+/**
+ * @brief Create and start the Coded PHY advertising set.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int long_range_init(void);
+
+/**
+ * @brief Update the compact scan in the Coded PHY advertising data.
+ *
+ * @param scan The latest compact scan.
+ */
+void long_range_update(const struct compact_scan *scan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LONG_RANGE_H */
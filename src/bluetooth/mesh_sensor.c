@@ -0,0 +1,210 @@
+/**
+ * @file mesh_sensor.c
+ * @brief Bluetooth Mesh Sensor Server publishing the pack metrics.
+ *
+ * Values are cached on every scan and served from the cache. A scan only triggers a
+ * publication when a value moved by at least CONFIG_APP_MESH_MIN_DELTA_CV (or 1 °C) since the
+ * last sample handed to the model; the model then applies the Sensor Cadence delta thresholds
+ * configured by the network, so a pack whose values are stable stays silent.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/hwinfo.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/mesh.h>
+#include <bluetooth/mesh/models.h>
+
+#include "mesh_sensor.h"
+#include "../sensor/scan.h"
+#include "../sensor/pack_metrics.h"
+#include "../application/app_config.h"
+
+#define TEMP_MIN_DELTA_DC 10
+
+/**
+ * @brief Cached sensor values.
+ */
+struct mesh_values {
+    uint16_t pack_cv;
+    uint16_t min_cell_cv;
+    int16_t temp;
+};
+
+static struct k_spinlock lock;
+static struct mesh_values values;
+static struct mesh_values sampled;  ///< Values at the last sample handed to the model
+static bool have_values;
+
+static int get_cached(struct bt_mesh_sensor *sensor, int64_t micro,
+                      struct bt_mesh_sensor_value *rsp)
+{
+    return bt_mesh_sensor_value_from_micro(sensor->type->channels[0].format, micro, rsp);
+}
+
+static int pack_voltage_get(struct bt_mesh_sensor_srv *srv, struct bt_mesh_sensor *sensor,
+                            struct bt_mesh_msg_ctx *ctx, struct bt_mesh_sensor_value *rsp)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int64_t micro = (int64_t)values.pack_cv * 10000;
+    bool valid = have_values;
+
+    k_spin_unlock(&lock, key);
+
+    return valid ? get_cached(sensor, micro, rsp) : -ENODATA;
+}
+
+static int temp_get(struct bt_mesh_sensor_srv *srv, struct bt_mesh_sensor *sensor,
+                    struct bt_mesh_msg_ctx *ctx, struct bt_mesh_sensor_value *rsp)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int64_t micro = (int64_t)values.temp * 100000;
+    bool valid = have_values;
+
+    k_spin_unlock(&lock, key);
+
+    return valid ? get_cached(sensor, micro, rsp) : -ENODATA;
+}
+
+static int min_cell_get(struct bt_mesh_sensor_srv *srv, struct bt_mesh_sensor *sensor,
+                        struct bt_mesh_msg_ctx *ctx, struct bt_mesh_sensor_value *rsp)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int64_t micro = (int64_t)values.min_cell_cv * 10000;
+    bool valid = have_values;
+
+    k_spin_unlock(&lock, key);
+
+    return valid ? get_cached(sensor, micro, rsp) : -ENODATA;
+}
+
+static struct bt_mesh_sensor pack_voltage = {
+    .type = &bt_mesh_sensor_present_input_voltage,
+    .get = pack_voltage_get,
+};
+
+static struct bt_mesh_sensor temperature = {
+    .type = &bt_mesh_sensor_present_dev_op_temp,
+    .get = temp_get,
+};
+
+static struct bt_mesh_sensor min_cell_voltage = {
+    .type = &bt_mesh_sensor_present_input_voltage,
+    .get = min_cell_get,
+};
+
+static struct bt_mesh_sensor *const pack_sensors[] = { &pack_voltage, &temperature };
+static struct bt_mesh_sensor *const cell_sensors[] = { &min_cell_voltage };
+
+static struct bt_mesh_sensor_srv pack_srv =
+    BT_MESH_SENSOR_SRV_INIT(pack_sensors, ARRAY_SIZE(pack_sensors));
+static struct bt_mesh_sensor_srv cell_srv =
+    BT_MESH_SENSOR_SRV_INIT(cell_sensors, ARRAY_SIZE(cell_sensors));
+
+BT_MESH_HEALTH_PUB_DEFINE(health_pub, 0);
+static struct bt_mesh_health_srv health_srv;
+
+static struct bt_mesh_model pack_models[] = {
+    BT_MESH_MODEL_CFG_SRV,
+    BT_MESH_MODEL_HEALTH_SRV(&health_srv, &health_pub),
+    BT_MESH_MODEL_SENSOR_SRV(&pack_srv),
+};
+
+static struct bt_mesh_model cell_models[] = {
+    BT_MESH_MODEL_SENSOR_SRV(&cell_srv),
+};
+
+static struct bt_mesh_elem elements[] = {
+    BT_MESH_ELEM(1, pack_models, BT_MESH_MODEL_NONE),
+    BT_MESH_ELEM(2, cell_models, BT_MESH_MODEL_NONE),
+};
+
+static const struct bt_mesh_comp comp = {
+    .cid = CONFIG_BT_COMPANY_ID,
+    .elem = elements,
+    .elem_count = ARRAY_SIZE(elements),
+};
+
+static uint8_t dev_uuid[16];
+
+static void prov_complete(uint16_t net_idx, uint16_t addr)
+{
+    printk("Mesh provisioned, primary address 0x%04x\n", addr);
+}
+
+static void prov_reset(void)
+{
+    bt_mesh_prov_enable(BT_MESH_PROV_ADV | BT_MESH_PROV_GATT);
+}
+
+static const struct bt_mesh_prov prov = {
+    .uuid = dev_uuid,
+    .complete = prov_complete,
+    .reset = prov_reset,
+};
+
+int mesh_sensor_init(void)
+{
+    int err;
+
+    // The device UUID is derived from the chip id, so it survives reflashing
+    if (hwinfo_get_device_id(dev_uuid, sizeof(dev_uuid)) < 0) {
+        printk("No device id, using a fixed mesh UUID\n");
+        dev_uuid[0] = 0xB1;
+    }
+
+    err = bt_mesh_init(&prov, &comp);
+    if (err) {
+        printk("Mesh init failed (err %d)\n", err);
+    }
+
+    return err;
+}
+
+void mesh_sensor_start(void)
+{
+    if (!bt_mesh_is_provisioned()) {
+        bt_mesh_prov_enable(BT_MESH_PROV_ADV | BT_MESH_PROV_GATT);
+    }
+}
+
+void mesh_sensor_scan(const struct scan_record *rec)
+{
+    struct app_config cfg;
+    struct pack_metrics m;
+    struct mesh_values next;
+    k_spinlock_key_t key;
+    bool first;
+
+    app_config_read(&cfg);
+    pack_metrics_compute(rec, &cfg, &m);
+    next.pack_cv = m.pack_cv;
+    next.min_cell_cv = m.min_cell_cv;
+    next.temp = rec->temp;
+
+    key = k_spin_lock(&lock);
+    values = next;
+    first = !have_values;
+    have_values = true;
+    k_spin_unlock(&lock, key);
+
+    if (!bt_mesh_is_provisioned()) {
+        return;
+    }
+
+    // Only hand significant changes to the model, it applies the cadence thresholds on top
+    if (first || abs(next.pack_cv - sampled.pack_cv) >= CONFIG_APP_MESH_MIN_DELTA_CV) {
+        sampled.pack_cv = next.pack_cv;
+        bt_mesh_sensor_srv_sample(&pack_srv, &pack_voltage);
+    }
+    if (first || abs(next.temp - sampled.temp) >= TEMP_MIN_DELTA_DC) {
+        sampled.temp = next.temp;
+        bt_mesh_sensor_srv_sample(&pack_srv, &temperature);
+    }
+    if (first || abs(next.min_cell_cv - sampled.min_cell_cv) >= CONFIG_APP_MESH_MIN_DELTA_CV) {
+        sampled.min_cell_cv = next.min_cell_cv;
+        bt_mesh_sensor_srv_sample(&cell_srv, &min_cell_voltage);
+    }
+}
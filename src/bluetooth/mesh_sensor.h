@@ -0,0 +1,45 @@
+/**
+ * @file mesh_sensor.h
+ * @brief Bluetooth Mesh Sensor Server publishing the pack metrics.
+ *
+ * Element 0 exposes the pack voltage (Present Input Voltage) and the internal temperature
+ * (Present Device Operating Temperature). Element 1 exposes the lowest battery voltage, also
+ * as Present Input Voltage. Publication period, fast cadence and delta triggers are the
+ * standard Sensor Cadence state, configured by a Sensor Setup client.
+ */
+
+#ifndef MESH_SENSOR_H
+#define MESH_SENSOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct scan_record;
+
+/**
+ * @brief Register the mesh composition. Must be called after bt_enable() and before
+ *        settings_load().
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int mesh_sensor_init(void);
+
+/**
+ * @brief Enable provisioning if the node is not provisioned yet. Must be called after
+ *        settings_load().
+ */
+void mesh_sensor_start(void);
+
+/**
+ * @brief Update the sensor values from a new scan and publish the significant changes.
+ *
+ * @param rec The latest scan.
+ */
+void mesh_sensor_scan(const struct scan_record *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MESH_SENSOR_H */
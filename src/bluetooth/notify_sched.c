@@ -0,0 +1,679 @@
+/**
+ * @file notify_sched.c
+ * @brief Batched notification of the scans just before each connection event.
+ *
+ * The radio notification callback library calls prepare() ahead of every connection event of
+ * a registered connection. The callback only checks whether the batch of that connection is
+ * due and kicks the live flow of the connection in the bandwidth scheduler (see bw_sched.h),
+ * which notifies the batch in time for the event.
+ *
+ * When the first record enters an empty batch, the batch is given a flush time: one connection
+ * interval before its latency budget runs out, or at once if the next record cannot arrive
+ * before that. A full batch is due at once. If the connection events are too slow for the
+ * record rate, the oldest record of a full batch is dropped. A batch the stack had no buffer
+ * for is put back in front of the records that arrived meanwhile and sent at the next event.
+ *
+ * Before batching, every scan goes through the stream descriptor of the connection: the
+ * channels are accumulated (sum, minimum, maximum) over the decimation window and one record
+ * is encoded when the window is complete. All descriptors are evaluated in the same pass over
+ * the connections, so the cost of a subscriber only depends on its own descriptor.
+ *
+ * The airtime efficiency is the record payload over the bytes sent on air, counting the ATT,
+ * L2CAP and unencrypted link layer framing of one PDU per notification.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <bluetooth/radio_notification_cb.h>
+
+#include "notify_sched.h"
+#include "service.h"
+#include "bw_sched.h"
+#include "../sensor/scan.h"
+
+#define MAX_LINKS       CONFIG_BT_MAX_CONN
+#define MAX_PAYLOAD     MAX(CONFIG_BT_L2CAP_TX_MTU - 3, sizeof(struct scan_record))
+#define HEADER_SIZE     6   ///< Sequence number and time of a packed record
+#define MAX_RECORDS     (MAX_PAYLOAD / (HEADER_SIZE + sizeof(uint16_t)))
+#define CHANNELS        (TOTAL_CHANNELS + 1)  ///< Taps and temperature
+#define MAX_BUDGET_MS   10000
+#define PDU_OVERHEAD    17  ///< ATT 3, L2CAP 4, LL header 2, preamble 1, access address 4, CRC 3
+
+BUILD_ASSERT(MAX_LINKS <= 32, "Link masks are 32-bit");
+
+/**
+ * @brief Counters of a connection.
+ */
+struct link_stats {
+    uint32_t notifications;
+    uint32_t records;
+    uint32_t bytes;           ///< Record payload
+    uint32_t dropped;         ///< Records dropped from a full batch or by a failed send
+    uint32_t latency_sum_ms;  ///< Publication of the oldest scan to queuing, summed
+    uint32_t latency_max_ms;
+};
+
+/**
+ * @brief Channel accumulators of the current decimation window.
+ */
+struct stream_acc {
+    uint16_t scans;
+    int32_t sum[CHANNELS];
+    int32_t min[CHANNELS];
+    int32_t max[CHANNELS];
+};
+
+/**
+ * @brief Stream, batch and timing of a connection.
+ */
+struct link {
+    struct bt_conn *conn;
+    bool timed;                           ///< Connection event callbacks registered
+    uint16_t budget_ms;
+    uint32_t interval_cyc;                ///< Connection interval
+    uint16_t mtu_payload;                 ///< Notification payload at the current MTU
+    struct stream_desc desc;              ///< Host byte order
+    struct stream_acc acc;
+    uint8_t record_size;
+    uint8_t count;                        ///< Records in the batch
+    uint8_t batch[MAX_PAYLOAD];
+    uint32_t batch_cyc[MAX_RECORDS];      ///< Publication time of each record
+    uint32_t flush_cyc;                   ///< Send at the first connection event after this
+    struct link_stats stats;
+    struct bw_flow flow;                  ///< Live flow in the bandwidth scheduler
+};
+
+static const struct stream_desc default_desc = {
+    .decimation = 1,
+    .aggregation = STREAM_AGG_RAW,
+    .encoding = STREAM_ENC_RECORD,
+};
+
+static struct k_spinlock lock;
+static struct link links[MAX_LINKS];
+static uint32_t last_scan_cyc;
+static uint32_t scan_period_cyc;
+
+static atomic_t ready;                    ///< Links with a batch to send now
+
+static int link_index(const struct bt_conn *conn)
+{
+    for (int i = 0; i < MAX_LINKS; i++) {
+        if (links[i].conn == conn) {
+            return i;
+        }
+    }
+
+    return -ENOENT;
+}
+
+static bool due(const struct link *link, uint32_t now)
+{
+    return link->count > 0 && (int32_t)(now - link->flush_cyc) >= 0;
+}
+
+static void prepare(struct bt_conn *conn)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int i = link_index(conn);
+    bool send = i >= 0 && due(&links[i], k_cycle_get_32());
+
+    k_spin_unlock(&lock, key);
+
+    if (send) {
+        atomic_set_bit(&ready, i);
+        bw_sched_kick(&links[i].flow);
+    }
+}
+
+static const struct bt_radio_notification_conn_cb radio_cb = {
+    .prepare = prepare,
+};
+
+/**
+ * @brief Number of records that fit in a notification. Must be called with the lock held.
+ */
+static uint8_t capacity_locked(const struct link *link)
+{
+    return CLAMP(MIN(link->mtu_payload, MAX_PAYLOAD) / link->record_size, 1,
+                 MAX_PAYLOAD / link->record_size);
+}
+
+/**
+ * @brief Size of the due batch of a link, bandwidth scheduler callback.
+ */
+static size_t live_pending(struct bw_flow *flow)
+{
+    struct link *link = CONTAINER_OF(flow, struct link, flow);
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    size_t len = 0;
+
+    if (link->conn != NULL && atomic_test_bit(&ready, link - links)) {
+        len = link->count * link->record_size;
+    }
+    k_spin_unlock(&lock, key);
+
+    return len;
+}
+
+/**
+ * @brief Put a batch that could not be sent back in front of the batch of its link. Must be
+ *        called with the lock held.
+ *
+ * @return false if the batch no longer fits, the link changed or its records changed size.
+ */
+static bool restore_locked(struct link *link, const struct bt_conn *conn, const uint8_t *batch,
+                           const uint32_t *batch_cyc, uint8_t count, uint8_t size)
+{
+    if (link->conn != conn || link->record_size != size ||
+        link->count + count > capacity_locked(link)) {
+        return false;
+    }
+
+    memmove(&link->batch[count * size], link->batch, link->count * size);
+    memcpy(link->batch, batch, count * size);
+    memmove(&link->batch_cyc[count], link->batch_cyc, link->count * sizeof(link->batch_cyc[0]));
+    memcpy(link->batch_cyc, batch_cyc, count * sizeof(link->batch_cyc[0]));
+    link->count += count;
+    // Already late, send at the next connection event
+    link->flush_cyc = k_cycle_get_32();
+
+    return true;
+}
+
+/**
+ * @brief Notify the due batch of a link, bandwidth scheduler callback.
+ */
+static int live_send(struct bw_flow *flow, bt_gatt_complete_func_t done, void *user_data)
+{
+    uint8_t batch[MAX_PAYLOAD];
+    uint32_t batch_cyc[MAX_RECORDS];
+    struct link *link = CONTAINER_OF(flow, struct link, flow);
+    struct bt_conn *conn;
+    uint32_t latency_ms;
+    uint16_t mtu_payload;
+    uint16_t len;
+    uint8_t count;
+    uint8_t size;
+    k_spinlock_key_t key;
+    int err;
+
+    key = k_spin_lock(&lock);
+    atomic_clear_bit(&ready, link - links);
+    if (link->conn == NULL || link->count == 0) {
+        k_spin_unlock(&lock, key);
+        return -ENODATA;
+    }
+    conn = bt_conn_ref(link->conn);
+    count = link->count;
+    size = link->record_size;
+    len = count * size;
+    memcpy(batch, link->batch, len);
+    memcpy(batch_cyc, link->batch_cyc, count * sizeof(batch_cyc[0]));
+    latency_ms = k_cyc_to_ms_floor32(k_cycle_get_32() - batch_cyc[0]);
+    // Scans published while the notification is queued start a new batch
+    link->count = 0;
+    k_spin_unlock(&lock, key);
+
+    // The MTU exchange completes after the connection, refresh the capacity on every send
+    mtu_payload = bt_gatt_get_mtu(conn) - 3;
+
+    err = bt_send_scan_data(conn, batch, len, done, user_data);
+
+    key = k_spin_lock(&lock);
+    if (err == 0) {
+        link->stats.notifications++;
+        link->stats.records += count;
+        link->stats.bytes += len;
+        link->stats.latency_sum_ms += latency_ms;
+        link->stats.latency_max_ms = MAX(link->stats.latency_max_ms, latency_ms);
+    } else if ((err != -ENOMEM && err != -ENOBUFS) ||
+               !restore_locked(link, conn, batch, batch_cyc, count, size)) {
+        // Not subscribed, disconnected, or no room left to keep the batch
+        link->stats.dropped += count;
+    }
+    link->mtu_payload = mtu_payload;
+    k_spin_unlock(&lock, key);
+
+    bt_conn_unref(conn);
+    return err;
+}
+
+static const struct bw_flow_ops live_ops = {
+    .pending = live_pending,
+    .send = live_send,
+};
+
+static int32_t channel_value(const struct scan_record *rec, int ch)
+{
+    return ch < TOTAL_CHANNELS ? rec->tap_cv[ch] : rec->temp;
+}
+
+static uint16_t channel_bit(int ch)
+{
+    return ch < TOTAL_CHANNELS ? BIT(ch) : STREAM_MASK_TEMP;
+}
+
+/**
+ * @brief Size of the records of a descriptor.
+ */
+static size_t record_size(const struct stream_desc *desc)
+{
+    if (desc->encoding == STREAM_ENC_RECORD) {
+        return sizeof(struct scan_record);
+    }
+
+    return HEADER_SIZE + __builtin_popcount(desc->channel_mask) *
+           (desc->aggregation == STREAM_AGG_MINMAX ? 2 : 1) * sizeof(uint16_t);
+}
+
+static bool desc_valid(const struct stream_desc *desc)
+{
+    const uint16_t channels = BIT_MASK(TOTAL_CHANNELS) | STREAM_MASK_TEMP;
+
+    if (desc->decimation == 0 || desc->aggregation > STREAM_AGG_MINMAX) {
+        return false;
+    }
+
+    switch (desc->encoding) {
+    case STREAM_ENC_RECORD:
+        return desc->aggregation != STREAM_AGG_MINMAX;
+    case STREAM_ENC_PACKED:
+        return desc->channel_mask != 0 && (desc->channel_mask & ~channels) == 0 &&
+               record_size(desc) <= MAX_PAYLOAD;
+    default:
+        return false;
+    }
+}
+
+static void accumulate(struct stream_acc *acc, const struct scan_record *rec)
+{
+    for (int ch = 0; ch < CHANNELS; ch++) {
+        int32_t value = channel_value(rec, ch);
+
+        if (acc->scans == 0) {
+            acc->sum[ch] = acc->min[ch] = acc->max[ch] = value;
+        } else {
+            acc->sum[ch] += value;
+            acc->min[ch] = MIN(acc->min[ch], value);
+            acc->max[ch] = MAX(acc->max[ch], value);
+        }
+    }
+    acc->scans++;
+}
+
+/**
+ * @brief Encode the record of a complete decimation window.
+ *
+ * @param link The connection, with its accumulators.
+ * @param rec The last scan of the window.
+ * @param out Destination, record_size bytes.
+ */
+static void encode(const struct link *link, const struct scan_record *rec, uint8_t *out)
+{
+    const struct stream_acc *acc = &link->acc;
+    struct scan_record avg;
+
+    if (link->desc.encoding == STREAM_ENC_RECORD) {
+        if (link->desc.aggregation == STREAM_AGG_AVG) {
+            avg = *rec;
+            for (int ch = 0; ch < TOTAL_CHANNELS; ch++) {
+                avg.tap_cv[ch] = acc->sum[ch] / acc->scans;
+            }
+            avg.temp = acc->sum[TOTAL_CHANNELS] / acc->scans;
+            rec = &avg;
+        }
+        memcpy(out, rec, sizeof(*rec));
+        return;
+    }
+
+    sys_put_le16(rec->seq, out);
+    sys_put_le32(rec->time_ms, out + 2);
+    out += HEADER_SIZE;
+
+    for (int ch = 0; ch < CHANNELS; ch++) {
+        if (!(link->desc.channel_mask & channel_bit(ch))) {
+            continue;
+        }
+
+        switch (link->desc.aggregation) {
+        case STREAM_AGG_AVG:
+            sys_put_le16(acc->sum[ch] / acc->scans, out);
+            break;
+        case STREAM_AGG_MINMAX:
+            sys_put_le16(acc->min[ch], out);
+            out += sizeof(uint16_t);
+            sys_put_le16(acc->max[ch], out);
+            break;
+        default:
+            sys_put_le16(channel_value(rec, ch), out);
+            break;
+        }
+        out += sizeof(uint16_t);
+    }
+}
+
+/**
+ * @brief Feed a scan to the stream of a connection. Must be called with the lock held.
+ *
+ * @return True if the batch must be sent without waiting for a connection event.
+ */
+static bool feed_locked(struct link *link, const struct scan_record *rec, uint32_t now)
+{
+    uint32_t budget_cyc = k_ms_to_cyc_floor32(link->budget_ms);
+    uint32_t period_cyc = scan_period_cyc * link->desc.decimation;
+    uint8_t capacity = capacity_locked(link);
+
+    accumulate(&link->acc, rec);
+    if (link->acc.scans < link->desc.decimation) {
+        return false;
+    }
+
+    if (link->count >= capacity) {
+        // The connection events do not keep up with the records, keep the newest
+        link->count = capacity - 1;
+        memmove(&link->batch[0], &link->batch[link->record_size],
+                link->count * link->record_size);
+        memmove(&link->batch_cyc[0], &link->batch_cyc[1],
+                link->count * sizeof(link->batch_cyc[0]));
+        link->stats.dropped++;
+    }
+
+    encode(link, rec, &link->batch[link->count * link->record_size]);
+    link->batch_cyc[link->count] = now;
+    link->count++;
+    link->acc.scans = 0;
+
+    if (link->count == 1) {
+        if (budget_cyc <= link->interval_cyc + period_cyc) {
+            // The next record cannot join this batch within the budget
+            link->flush_cyc = now;
+        } else {
+            link->flush_cyc = now + budget_cyc - link->interval_cyc;
+        }
+    }
+
+    if (link->count >= capacity) {
+        link->flush_cyc = now;
+    }
+
+    return !link->timed;
+}
+
+void notify_sched_scan(const struct scan_record *rec)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    uint32_t now = k_cycle_get_32();
+    uint32_t direct = 0;
+
+    if (last_scan_cyc != 0) {
+        scan_period_cyc = now - last_scan_cyc;
+    }
+    last_scan_cyc = now;
+
+    for (int i = 0; i < MAX_LINKS; i++) {
+        if (links[i].conn != NULL && feed_locked(&links[i], rec, now)) {
+            direct |= BIT(i);
+        }
+    }
+    k_spin_unlock(&lock, key);
+
+    // Without connection event timing, send right away
+    if (direct) {
+        atomic_or(&ready, direct);
+        for (int i = 0; i < MAX_LINKS; i++) {
+            if (direct & BIT(i)) {
+                bw_sched_kick(&links[i].flow);
+            }
+        }
+    }
+}
+
+static ssize_t read_latency(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                            void *buf, uint16_t len, uint16_t offset)
+{
+    uint16_t value = 0;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int i = link_index(conn);
+
+    if (i >= 0) {
+        value = sys_cpu_to_le16(links[i].budget_ms);
+    }
+    k_spin_unlock(&lock, key);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+static ssize_t write_latency(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                             const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    uint16_t value;
+    k_spinlock_key_t key;
+    int i;
+
+    if (offset != 0 || len != sizeof(value)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    value = sys_get_le16(buf);
+    if (value > MAX_BUDGET_MS) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    key = k_spin_lock(&lock);
+    i = link_index(conn);
+    if (i >= 0) {
+        links[i].budget_ms = value;
+    }
+    k_spin_unlock(&lock, key);
+
+    return len;
+}
+
+static ssize_t read_desc(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                         void *buf, uint16_t len, uint16_t offset)
+{
+    struct stream_desc value = default_desc;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int i = link_index(conn);
+
+    if (i >= 0) {
+        value = links[i].desc;
+    }
+    k_spin_unlock(&lock, key);
+
+    value.channel_mask = sys_cpu_to_le16(value.channel_mask);
+    value.decimation = sys_cpu_to_le16(value.decimation);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+static ssize_t write_desc(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                          const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    struct stream_desc desc;
+    k_spinlock_key_t key;
+    int i;
+
+    if (offset != 0 || len != sizeof(desc)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    memcpy(&desc, buf, sizeof(desc));
+    desc.channel_mask = sys_le16_to_cpu(desc.channel_mask);
+    desc.decimation = sys_le16_to_cpu(desc.decimation);
+    if (!desc_valid(&desc)) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    key = k_spin_lock(&lock);
+    i = link_index(conn);
+    if (i >= 0) {
+        // Records of the previous descriptor are not sent
+        links[i].desc = desc;
+        links[i].record_size = record_size(&desc);
+        links[i].acc.scans = 0;
+        links[i].count = 0;
+    }
+    k_spin_unlock(&lock, key);
+
+    return len;
+}
+
+/**
+ * @brief Live Stream Service, the per connection settings of the Scan notifications.
+ */
+BT_GATT_SERVICE_DEFINE(live_svc,
+    BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_128(BT_UUID_LIVE_VAL)),
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(BT_UUID_LIVE_LATENCY_VAL),
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                           read_latency, write_latency, NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_GATT_CUD,
+                       BT_GATT_PERM_READ,
+                       NULL, NULL, "Live latency (ms)"),
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(BT_UUID_STREAM_DESC_VAL),
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                           read_desc, write_desc, NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_GATT_CUD,
+                       BT_GATT_PERM_READ,
+                       NULL, NULL, "Stream descriptor"),
+);
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    struct bt_conn_info info;
+    k_spinlock_key_t key;
+    int i;
+    int ret;
+
+    if (err || bt_conn_get_info(conn, &info)) {
+        return;
+    }
+
+    key = k_spin_lock(&lock);
+    i = link_index(NULL);
+    if (i >= 0) {
+        memset(&links[i], 0, sizeof(links[i]));
+        links[i].conn = bt_conn_ref(conn);
+        links[i].budget_ms = CONFIG_APP_NOTIFY_SCHED_MAX_LATENCY_MS;
+        links[i].interval_cyc = k_us_to_cyc_ceil32(BT_CONN_INTERVAL_TO_US(info.le.interval));
+        links[i].mtu_payload = BT_ATT_DEFAULT_LE_MTU - 3;
+        links[i].desc = default_desc;
+        links[i].record_size = record_size(&default_desc);
+    }
+    k_spin_unlock(&lock, key);
+
+    if (i < 0) {
+        return;
+    }
+
+    if (bw_sched_add(&links[i].flow, conn, BW_CLASS_LIVE, &live_ops)) {
+        printk("No flow left for the live stream\n");
+    }
+
+    ret = bt_radio_notification_conn_cb_register(&radio_cb, conn,
+                                                 CONFIG_APP_NOTIFY_SCHED_PREPARE_US);
+    if (ret) {
+        printk("Connection event callback failed (err %d), notifying at once\n", ret);
+        return;
+    }
+
+    key = k_spin_lock(&lock);
+    links[i].timed = true;
+    k_spin_unlock(&lock, key);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int i = link_index(conn);
+
+    if (i >= 0) {
+        bt_conn_unref(links[i].conn);
+        links[i].conn = NULL;
+        links[i].count = 0;
+        atomic_clear_bit(&ready, i);
+    }
+    k_spin_unlock(&lock, key);
+
+    if (i >= 0) {
+        bw_sched_remove(&links[i].flow);
+    }
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+                             uint16_t timeout)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int i = link_index(conn);
+
+    if (i >= 0) {
+        links[i].interval_cyc = k_us_to_cyc_ceil32(BT_CONN_INTERVAL_TO_US(interval));
+    }
+    k_spin_unlock(&lock, key);
+}
+
+BT_CONN_CB_DEFINE(notify_sched_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+    .le_param_updated = le_param_updated,
+};
+
+int notify_sched_format_status(char *buf, size_t buf_size)
+{
+    size_t offset = 0;
+
+    for (int i = 0; i < MAX_LINKS; i++) {
+        struct link_stats s;
+        uint16_t budget_ms;
+        uint16_t decimation;
+        uint8_t capacity;
+        uint32_t efficiency;
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        bool active = links[i].conn != NULL;
+        int written;
+
+        s = links[i].stats;
+        budget_ms = links[i].budget_ms;
+        decimation = links[i].desc.decimation;
+        capacity = active ? capacity_locked(&links[i]) : 0;
+        k_spin_unlock(&lock, key);
+
+        if (!active) {
+            continue;
+        }
+
+        efficiency = s.notifications ?
+            (uint32_t)((uint64_t)s.bytes * 100 /
+                       (s.bytes + (uint64_t)s.notifications * PDU_OVERHEAD)) : 0;
+
+        written = snprintf(buf + offset, buf_size - offset,
+                           "link %d: budget %u ms dec %u batch %u notif %u rec %u drop %u "
+                           "eff %u%% lat avg %u max %u ms\n",
+                           i, budget_ms, decimation, capacity, s.notifications, s.records,
+                           s.dropped,
+                           efficiency, s.notifications ? s.latency_sum_ms / s.notifications : 0,
+                           s.latency_max_ms);
+        if (written < 0 || (size_t)written >= buf_size - offset) {
+            return -ENOMEM;
+        }
+        offset += written;
+    }
+
+    if (offset == 0) {
+        return snprintf(buf, buf_size, "notify: no connection\n");
+    }
+
+    return offset;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file notify_sched.h
+ * @brief Live scan stream, batched and aligned on the connection events.
+ *
+ * Scans are batched per subscriber: a Scan notification carries as many consecutive scan
+ * records as the ATT MTU allows. A batch is notified just before the connection event
+ * (CONFIG_APP_NOTIFY_SCHED_PREPARE_US ahead) when it is full, or when waiting for one more
+ * connection event would exceed the latency budget of the subscriber. At low scan rates every
+ * scan is therefore sent at the next connection event, and at high rates in full PDUs.
+ *
+ * Each subscriber sets its own budget in the Live Latency characteristic (uint16, ms, default
+ * CONFIG_APP_NOTIFY_SCHED_MAX_LATENCY_MS, 0 disables batching).
+ *
+ * Each subscriber also selects what it receives with a stream descriptor, written to the
+ * Stream Descriptor characteristic: channels, decimation, aggregation and encoding. The
+ * default descriptor sends every scan as a struct scan_record.
+ */
+
+#ifndef NOTIFY_SCHED_H
+#define NOTIFY_SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+/** @brief Live Stream Service UUID. */
+#define BT_UUID_LIVE_VAL \
+    BT_UUID_128_ENCODE(0x00001100, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
+/** @brief Live Latency Characteristic UUID, latency budget of the connection in ms. */
+#define BT_UUID_LIVE_LATENCY_VAL \
+    BT_UUID_128_ENCODE(0x00001101, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
+/** @brief Stream Descriptor Characteristic UUID, struct stream_desc of the connection. */
+#define BT_UUID_STREAM_DESC_VAL \
+    BT_UUID_128_ENCODE(0x00001102, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
+/** @brief Channel mask bit of the temperature, bits 0 to TOTAL_CHANNELS - 1 are the taps. */
+#define STREAM_MASK_TEMP 0x8000
+
+/**
+ * @brief Aggregation of the scans of a decimation window.
+ */
+enum stream_aggregation {
+    STREAM_AGG_RAW = 0,     ///< Values of the last scan of the window
+    STREAM_AGG_AVG = 1,     ///< Average of each channel over the window
+    STREAM_AGG_MINMAX = 2,  ///< Lowest then highest value of each channel over the window
+};
+
+/**
+ * @brief Encoding of the stream records.
+ */
+enum stream_encoding {
+    /** struct scan_record, all channels. Raw or average aggregation only. */
+    STREAM_ENC_RECORD = 0,
+    /**
+     * Sequence number (uint16) and time (uint32 ms) of the last scan of the window, then
+     * one value (two with STREAM_AGG_MINMAX) per selected channel: the taps in ascending
+     * order (uint16 cV), then the temperature (int16, 1/10 °C). All little-endian.
+     */
+    STREAM_ENC_PACKED = 1,
+};
+
+/**
+ * @brief Stream descriptor of a connection. All fields are little-endian.
+ */
+struct stream_desc {
+    uint16_t channel_mask;  ///< Taps and STREAM_MASK_TEMP, STREAM_ENC_PACKED only
+    uint16_t decimation;    ///< Scans per record, at least 1
+    uint8_t aggregation;    ///< enum stream_aggregation
+    uint8_t encoding;       ///< enum stream_encoding
+} __packed;
+
+struct scan_record;
+
+/**
+ * @brief Feed a scan to the stream of every connection.
+ *
+ * @param rec The scan to notify.
+ */
+void notify_sched_scan(const struct scan_record *rec);
+
+/**
+ * @brief Print the batching, airtime efficiency and latency of each connection into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int notify_sched_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NOTIFY_SCHED_H */
@@ -0,0 +1,273 @@
+/**
+ * @file reconnect.c
+ * @brief Staged advertising to reconnect quickly to bonded centrals.
+ *
+ * Advertising restarts when the connection object is recycled rather than in the disconnected
+ * callback, as the stack cannot advertise connectable while the old object is still held. The
+ * time from disconnection to the next connection is recorded per stage. While connection slots
+ * are left (CONFIG_BT_MAX_CONN), undirected advertising keeps running for the other centrals.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+
+#include "reconnect.h"
+#include "bluetooth.h"
+#include "adv_sched.h"
+
+/** @brief Advertising stages, in order. */
+enum stage {
+    STAGE_IDLE,
+    STAGE_DIRECTED,
+    STAGE_ACCEPT_LIST,
+    STAGE_OPEN,
+    STAGE_COUNT,
+};
+
+static const char *const stage_names[STAGE_COUNT] = {
+    "idle", "directed", "accept-list", "open",
+};
+
+/**
+ * @brief Reconnection statistics.
+ */
+struct reconnect_stats {
+    uint32_t count[STAGE_COUNT];  ///< Connections per stage they were made in
+    uint32_t last_ms;             ///< Last disconnection to connection time
+    uint32_t max_ms;              ///< Longest disconnection to connection time
+};
+
+static enum stage stage;
+static bt_addr_le_t peer;         ///< Directed advertising target
+static bool have_peer;
+static size_t bond_count;
+static int64_t disconnected_at;   ///< Uptime of the disconnection, 0 if connected or at boot
+static struct reconnect_stats stats;
+
+static void stage_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(stage_work, stage_work_handler);
+
+static void open_work_handler(struct k_work *work);
+static K_WORK_DEFINE(open_work, open_work_handler);
+
+static void add_bond(const struct bt_bond_info *info, void *user_data)
+{
+    int err = bt_le_filter_accept_list_add(&info->addr);
+
+    if (err) {
+        printk("Failed to add bond to the accept list (err %d)\n", err);
+        return;
+    }
+
+    // Without a previous connection, the first bond is the directed advertising target
+    if (!have_peer) {
+        bt_addr_le_copy(&peer, &info->addr);
+        have_peer = true;
+    }
+    bond_count++;
+}
+
+/**
+ * @brief Rebuild the filter accept list from the bonds. Advertising must be stopped.
+ */
+static void load_bonds(void)
+{
+    bond_count = 0;
+    bt_le_filter_accept_list_clear();
+    bt_foreach_bond(BT_ID_DEFAULT, add_bond, NULL);
+}
+
+static int start_stage(enum stage next)
+{
+    // One-time advertising: this module decides what to advertise after a connection
+    const struct bt_le_adv_param fast = BT_LE_ADV_PARAM_INIT(
+        BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME | BT_LE_ADV_OPT_FILTER_CONN,
+        BT_GAP_ADV_FAST_INT_MIN_2, BT_GAP_ADV_FAST_INT_MAX_2, NULL);
+    const struct bt_le_adv_param slow = BT_LE_ADV_PARAM_INIT(
+        BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+        BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX, NULL);
+    struct bt_le_adv_param directed = BT_LE_ADV_PARAM_INIT(
+        BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME, 0, 0, &peer);
+    int err;
+
+    stage = next;
+
+    switch (stage) {
+    case STAGE_DIRECTED:
+        // The high duty cycle advertising times out by itself, reported to connected()
+        err = bt_le_adv_start(&directed, NULL, 0, NULL, 0);
+        break;
+    case STAGE_ACCEPT_LIST:
+        err = bluetooth_adv_start(&fast);
+        if (!err) {
+            k_work_reschedule(&stage_work, K_SECONDS(CONFIG_APP_RECONNECT_FAST_S));
+        }
+        break;
+    case STAGE_OPEN:
+        if (IS_ENABLED(CONFIG_APP_ADV_SCHED)) {
+            err = adv_sched_start(0);
+        } else {
+            err = bluetooth_adv_start(&slow);
+        }
+        break;
+    default:
+        err = 0;
+        break;
+    }
+
+    if (err) {
+        printk("Advertising (%s) failed to start (err %d)\n", stage_names[stage], err);
+    }
+    return err;
+}
+
+/**
+ * @brief Move on to the next stage, skipping the stages that cannot start.
+ */
+static void next_stage(void)
+{
+    bt_le_adv_stop();
+
+    while (stage < STAGE_OPEN) {
+        enum stage next = stage + 1;
+
+        if ((next == STAGE_DIRECTED && !have_peer) ||
+            (next == STAGE_ACCEPT_LIST && bond_count == 0)) {
+            stage = next;
+            continue;
+        }
+        if (start_stage(next) == 0) {
+            return;
+        }
+    }
+}
+
+static void stage_work_handler(struct k_work *work)
+{
+    if (stage == STAGE_IDLE) {
+        // Bonds can only change while no advertising uses the accept list
+        load_bonds();
+    }
+    next_stage();
+}
+
+void reconnect_start(void)
+{
+    if (IS_ENABLED(CONFIG_APP_ADV_SCHED)) {
+        adv_sched_stop();
+    }
+    bt_le_adv_stop();
+    stage = STAGE_IDLE;
+    k_work_reschedule(&stage_work, K_NO_WAIT);
+}
+
+static bool is_peripheral(struct bt_conn *conn)
+{
+    struct bt_conn_info info;
+
+    return bt_conn_get_info(conn, &info) == 0 && info.role == BT_CONN_ROLE_PERIPHERAL;
+}
+
+static void count_conn(struct bt_conn *conn, void *user_data)
+{
+    size_t *count = user_data;
+
+    (*count)++;
+}
+
+/**
+ * @brief Check whether another central can connect.
+ */
+static bool slots_left(void)
+{
+    size_t count = 0;
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, count_conn, &count);
+
+    return count < CONFIG_BT_MAX_CONN;
+}
+
+static void open_work_handler(struct k_work *work)
+{
+    // A reconnection may have started meanwhile
+    if (stage == STAGE_IDLE && slots_left()) {
+        start_stage(STAGE_OPEN);
+    }
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    if (err == BT_HCI_ERR_ADV_TIMEOUT) {
+        // Directed advertising expired without a connection
+        k_work_reschedule(&stage_work, K_NO_WAIT);
+        return;
+    }
+    if (err || !is_peripheral(conn)) {
+        return;
+    }
+
+    k_work_cancel_delayable(&stage_work);
+    if (IS_ENABLED(CONFIG_APP_ADV_SCHED)) {
+        adv_sched_stop();
+    }
+    // The central may have connected through another advertising set (e.g. Coded PHY)
+    bt_le_adv_stop();
+
+    if (disconnected_at) {
+        uint32_t elapsed = k_uptime_get() - disconnected_at;
+
+        stats.last_ms = elapsed;
+        stats.max_ms = MAX(stats.max_ms, elapsed);
+        disconnected_at = 0;
+    }
+    stats.count[stage]++;
+    stage = STAGE_IDLE;
+
+    bt_addr_le_copy(&peer, bt_conn_get_dst(conn));
+    have_peer = true;
+
+    // Keep advertising for the other centrals
+    if (slots_left()) {
+        k_work_submit(&open_work);
+    }
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    if (is_peripheral(conn)) {
+        disconnected_at = k_uptime_get();
+        // With several centrals, the one that left is the directed advertising target
+        bt_addr_le_copy(&peer, bt_conn_get_dst(conn));
+        have_peer = true;
+    }
+}
+
+static void recycled(void)
+{
+    // Also called when a central connection is released, restart only if not advertising, or
+    // only advertising for the free connection slots
+    if (disconnected_at && (stage == STAGE_IDLE || stage == STAGE_OPEN)) {
+        reconnect_start();
+    }
+}
+
+BT_CONN_CB_DEFINE(reconnect_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+    .recycled = recycled,
+};
+
+int reconnect_format_status(char *buf, size_t buf_size)
+{
+    return snprintf(buf, buf_size,
+                    "reconn directed %u accept-list %u open %u last %u max %u ms%s%s\n",
+                    stats.count[STAGE_DIRECTED], stats.count[STAGE_ACCEPT_LIST],
+                    stats.count[STAGE_OPEN], stats.last_ms, stats.max_ms,
+                    stage != STAGE_IDLE ? " advertising " : "",
+                    stage != STAGE_IDLE ? stage_names[stage] : "");
+}
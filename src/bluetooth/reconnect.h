@@ -0,0 +1,41 @@
+/**
+ * @file reconnect.h
+ * @brief Advertising strategy to reconnect quickly to bonded centrals.
+ *
+ * Advertising is (re)started at boot and whenever the peripheral connection is released, in
+ * stages:
+ * 1. High duty cycle directed advertising to the last (or first) bonded central, 1.28 s.
+ * 2. Fast connectable advertising restricted to the bonded centrals by the filter accept
+ *    list, for CONFIG_APP_RECONNECT_FAST_S. Skipped without bonds.
+ * 3. Undirected connectable advertising until a central connects, slow or with the adaptive
+ *    interval of adv_sched.h.
+ */
+
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * @brief Start advertising from the first stage.
+ */
+void reconnect_start(void);
+
+/**
+ * @brief Print the reconnection statistics into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int reconnect_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECONNECT_H */
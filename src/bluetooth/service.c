@@ -5,8 +5,14 @@
 #include <zephyr/bluetooth/gatt.h>
 
 #include "service.h"
+#include "../sensor/scan.h"
+#include "compact_scan.h"
+#include "buf_stats.h"
+#include "../sensor/on_demand.h"
 
 static bool notify_enabled;
+static bool scan_notify_enabled;
+static bool compact_notify_enabled;
 
 /**
  * @brief Callback function to handle changes in Client Characteristic Configuration (CCC).
@@ -22,13 +28,59 @@ static void ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
     notify_enabled = (value == BT_GATT_CCC_NOTIFY);
 }
 
+/**
+ * @brief CCC callback of the Scan characteristic.
+ *
+ * @param attr The GATT attribute whose CCC was modified.
+ * @param value The new CCC value, which determines if notifications are enabled.
+ */
+static void scan_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    scan_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+}
+
+/**
+ * @brief CCC callback of the Compact Scan characteristic.
+ *
+ * @param attr The GATT attribute whose CCC was modified.
+ * @param value The new CCC value, which determines if notifications are enabled.
+ */
+static void compact_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    compact_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+}
+
+/**
+ * @brief Read callback of the Scan characteristic, returns the latest scan.
+ *
+ * In on-demand builds a read at offset 0 waits for a fresh scan, or gets the latest one if it
+ * does not complete in time.
+ */
+static ssize_t read_scan(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                         void *buf, uint16_t len, uint16_t offset)
+{
+    struct scan_record rec;
+
+    if (IS_ENABLED(CONFIG_APP_ON_DEMAND) && offset == 0 && on_demand_read(&rec) == 0) {
+        return bt_gatt_attr_read(conn, attr, buf, len, offset, &rec, sizeof(rec));
+    }
+
+    if (scan_latest_get(&rec)) {
+        return bt_gatt_attr_read(conn, attr, buf, len, offset, NULL, 0);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &rec, sizeof(rec));
+}
+
 /* LED Button Service Declaration */
 /**
  * @brief Battery Service GATT Declaration.
  *
- * This service includes two characteristics:
+ * This service includes three characteristics:
  * - Voltage: Allows reading voltage values and enabling notifications.
  * - Temperature: Allows reading temperature values and enabling notifications.
+ * - Scan: Allows reading the latest packed scan and enabling notifications for every scan.
+ * - Compact Scan: Notifies every scan in the compact form of the long range profile.
  */
 BT_GATT_SERVICE_DEFINE(battery_svc,
     BT_GATT_PRIMARY_SERVICE(BT_UUID_BATTERY),
@@ -51,6 +103,26 @@ BT_GATT_SERVICE_DEFINE(battery_svc,
                        NULL, NULL, "Temp reading"),
     BT_GATT_CCC(ccc_cfg_changed,                     // CCCD for notifications
                 BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    BT_GATT_CHARACTERISTIC(BT_UUID_SCAN,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ, read_scan, NULL,
+                           NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_GATT_CUD,              // Characteristic User Descriptor (CUD)
+                       BT_GATT_PERM_READ,
+                       NULL, NULL, "Packed scan"),
+    BT_GATT_CCC(scan_ccc_cfg_changed,                // CCCD for notifications
+                BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    BT_GATT_CHARACTERISTIC(BT_UUID_COMPACT_SCAN,
+                           BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_NONE, NULL, NULL,
+                           NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_GATT_CUD,              // Characteristic User Descriptor (CUD)
+                       BT_GATT_PERM_READ,
+                       NULL, NULL, "Compact scan"),
+    BT_GATT_CCC(compact_ccc_cfg_changed,             // CCCD for notifications
+                BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
 );
 
 /**
@@ -92,3 +164,69 @@ int bt_send_temp(uint32_t temp)
                           &temp,
                           sizeof(temp));
 }
+
+/**
+ * @brief Send a scan record to connected clients via notification.
+ *
+ * @param rec The scan record to send.
+ * @return 0 on success, or a negative error code if notifications are not enabled or fail.
+ */
+int bt_send_scan(const struct scan_record *rec)
+{
+    if (!scan_notify_enabled) {
+        return -EACCES;
+    }
+
+    return bt_gatt_notify(NULL, &battery_svc.attrs[10], rec, sizeof(*rec));
+}
+
+/**
+ * @brief Send stream records to one client in a single Scan notification.
+ *
+ * @param conn The connection to notify.
+ * @param data The records, oldest first.
+ * @param len Length of the records, must fit in the ATT MTU of the connection.
+ * @param done Called once the notification has been sent, may be NULL.
+ * @param user_data Passed to done.
+ * @return 0 on success, -EACCES if this client has not enabled Scan notifications, or a
+ *         negative error code if the notification fails.
+ */
+int bt_send_scan_data(struct bt_conn *conn, const void *data, uint16_t len,
+                      bt_gatt_complete_func_t done, void *user_data)
+{
+    struct bt_gatt_notify_params params = {
+        .attr = &battery_svc.attrs[10],
+        .data = data,
+        .len = len,
+        .func = done,
+        .user_data = user_data,
+    };
+    int err;
+
+    // The CCC is shared by all clients, check the subscription of this one
+    if (!bt_gatt_is_subscribed(conn, params.attr, BT_GATT_CCC_NOTIFY)) {
+        return -EACCES;
+    }
+
+    err = bt_gatt_notify_cb(conn, &params);
+    if (IS_ENABLED(CONFIG_APP_BUF_STATS)) {
+        buf_stats_tx(conn, len, err);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Send a compact scan to connected clients via notification.
+ *
+ * @param scan The compact scan to send.
+ * @return 0 on success, or a negative error code if notifications are not enabled or fail.
+ */
+int bt_send_compact_scan(const struct compact_scan *scan)
+{
+    if (!compact_notify_enabled) {
+        return -EACCES;
+    }
+
+    return bt_gatt_notify(NULL, &battery_svc.attrs[14], scan, sizeof(*scan));
+}
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include <zephyr/types.h>
+#include <zephyr/bluetooth/gatt.h>
 
 /**
  * @file service.h
@@ -39,12 +40,35 @@ extern "C" {
 #define BT_UUID_TEMP_VAL \
     BT_UUID_128_ENCODE(0x00001002, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
 
+/** @brief Scan Characteristic UUID. 
+ *
+ * This is the UUID for the Scan characteristic within the Battery Service.
+ * It holds the latest scan as a packed record (see scan.h) and notifies every new scan.
+ */
+#define BT_UUID_SCAN_VAL \
+    BT_UUID_128_ENCODE(0x00001003, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
+/** @brief Compact Scan Characteristic UUID. 
+ *
+ * This is the UUID for the Compact Scan characteristic within the Battery Service.
+ * It notifies every new scan in the compact form used by the long range profile
+ * (see compact_scan.h).
+ */
+#define BT_UUID_COMPACT_SCAN_VAL \
+    BT_UUID_128_ENCODE(0x00001004, 0x1010, 0xefde, 0x1000, 0x785feabcd123)
+
 /** @brief Declaration of Battery Service UUID. */
 #define BT_UUID_BATTERY       BT_UUID_DECLARE_128(BT_UUID_BATTERY_VAL)
 /** @brief Declaration of Voltage Characteristic UUID. */
 #define BT_UUID_VOLTAGE       BT_UUID_DECLARE_128(BT_UUID_VOLTAGE_VAL)
 /** @brief Declaration of Temperature Characteristic UUID. */
 #define BT_UUID_TEMP          BT_UUID_DECLARE_128(BT_UUID_TEMP_VAL)
+/** @brief Declaration of Scan Characteristic UUID. */
+#define BT_UUID_SCAN          BT_UUID_DECLARE_128(BT_UUID_SCAN_VAL)
+/** @brief Declaration of Compact Scan Characteristic UUID. */
+#define BT_UUID_COMPACT_SCAN  BT_UUID_DECLARE_128(BT_UUID_COMPACT_SCAN_VAL)
+
+struct scan_record;
 
 /**
  * @brief Send a voltage reading via notification.
@@ -68,6 +92,48 @@ int bt_send_voltage(uint32_t voltage);
  */
 int bt_send_temp(uint32_t temp);
 
+/**
+ * @brief Send a scan record via notification.
+ *
+ * This function sends a packed scan record as a notification to the connected clients,
+ * if notifications are enabled for the Scan characteristic.
+ *
+ * @param rec The scan record to send.
+ * @return 0 on success, or a negative error code if notifications are not enabled or fail.
+ */
+int bt_send_scan(const struct scan_record *rec);
+
+/**
+ * @brief Send stream records via a single Scan notification to one client.
+ *
+ * A Scan notification carries one or more records of the same size, oldest first: scan
+ * records by default, or the records selected by the stream descriptor of the connection
+ * (see notify_sched.h).
+ *
+ * @param conn The connection to notify.
+ * @param data The records to send.
+ * @param len Length of the records, must fit in the ATT MTU of the connection.
+ * @param done Called once the notification has been sent, may be NULL.
+ * @param user_data Passed to done.
+ * @return 0 on success, -EACCES if this client has not enabled Scan notifications, or a
+ *         negative error code if the notification fails.
+ */
+int bt_send_scan_data(struct bt_conn *conn, const void *data, uint16_t len,
+                      bt_gatt_complete_func_t done, void *user_data);
+
+struct compact_scan;
+
+/**
+ * @brief Send a compact scan via notification.
+ *
+ * This function sends a compact scan as a notification to the connected clients,
+ * if notifications are enabled for the Compact Scan characteristic.
+ *
+ * @param scan The compact scan to send.
+ * @return 0 on success, or a negative error code if notifications are not enabled or fail.
+ */
+int bt_send_compact_scan(const struct compact_scan *scan);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,335 @@
+/**
+ * @file tx_power.c
+ * @brief Per-connection TX power control driven by the link RSSI.
+ *
+ * The RSSI is read with the standard HCI Read RSSI command and the power set with the Zephyr
+ * vendor specific Write TX Power Level command. The RSSI measures the peer transmissions, so
+ * the control assumes a symmetric link. Link layer retransmissions are not visible to the
+ * host: a sudden RSSI drop, a failed read or a supervision timeout are taken as the signs of
+ * packet loss, and the first two restore the maximum power right away.
+ *
+ * With CONFIG_APP_CODED_PHY the Coded PHY extends the range once the power is at its maximum:
+ * a link still below the target switches to Coded, and switches back to 1M before the power
+ * is lowered again.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/hci_vs.h>
+
+#include "tx_power.h"
+
+#define TARGET_RSSI     CONFIG_APP_TX_POWER_TARGET_RSSI
+#define MARGIN_DB       10  ///< RSSI above the target needed to step down
+#define DROP_DB         12  ///< RSSI drop below the average treated as a degraded link
+#define STABLE_READS    5   ///< Consecutive healthy reads before stepping down
+
+/** @brief TX power steps in dBm, supported by the nRF52840 radio. */
+static const int8_t levels[] = { -20, -16, -12, -8, -4, 0, 4, 8 };
+
+#define MAX_LEVEL       (ARRAY_SIZE(levels) - 1)
+#define DEFAULT_LEVEL   5   ///< 0 dBm, the controller default
+
+/**
+ * @brief Control state of one connection.
+ */
+struct link {
+    struct bt_conn *conn;
+    uint16_t handle;
+    uint8_t level;        ///< Index in levels
+    uint8_t stable;       ///< Consecutive reads with a healthy margin
+    int8_t rssi;          ///< Last RSSI
+    int16_t avg_rssi4;    ///< Average RSSI times 4
+};
+
+/**
+ * @brief Control counters.
+ */
+struct tx_power_stats {
+    uint32_t steps_down;
+    uint32_t steps_up;
+    uint32_t restores;    ///< Jumps to the maximum power on a degraded link
+    uint32_t timeouts;    ///< Supervision timeouts
+    uint32_t to_coded;    ///< Switches to the Coded PHY
+    uint32_t to_1m;       ///< Switches back to the 1M PHY
+};
+
+static struct link links[CONFIG_BT_MAX_CONN];
+static struct tx_power_stats stats;
+
+static void control_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(control_work, control_work_handler);
+
+static int read_rssi(uint16_t handle, int8_t *rssi)
+{
+    struct bt_hci_cp_read_rssi *cp;
+    struct bt_hci_rp_read_rssi *rp;
+    struct net_buf *buf, *rsp = NULL;
+    int err;
+
+    buf = bt_hci_cmd_create(BT_HCI_OP_READ_RSSI, sizeof(*cp));
+    if (!buf) {
+        return -ENOBUFS;
+    }
+
+    cp = net_buf_add(buf, sizeof(*cp));
+    cp->handle = sys_cpu_to_le16(handle);
+
+    err = bt_hci_cmd_send_sync(BT_HCI_OP_READ_RSSI, buf, &rsp);
+    if (err) {
+        return err;
+    }
+
+    rp = (void *)rsp->data;
+    *rssi = rp->rssi;
+    net_buf_unref(rsp);
+
+    return 0;
+}
+
+static int write_tx_power(uint16_t handle, int8_t dbm)
+{
+    struct bt_hci_cp_vs_write_tx_power_level *cp;
+    struct net_buf *buf, *rsp = NULL;
+    int err;
+
+    buf = bt_hci_cmd_create(BT_HCI_OP_VS_WRITE_TX_POWER_LEVEL, sizeof(*cp));
+    if (!buf) {
+        return -ENOBUFS;
+    }
+
+    cp = net_buf_add(buf, sizeof(*cp));
+    cp->handle = sys_cpu_to_le16(handle);
+    cp->handle_type = BT_HCI_VS_LL_HANDLE_TYPE_CONN;
+    cp->tx_power_level = dbm;
+
+    err = bt_hci_cmd_send_sync(BT_HCI_OP_VS_WRITE_TX_POWER_LEVEL, buf, &rsp);
+    if (err) {
+        return err;
+    }
+    net_buf_unref(rsp);
+
+    return 0;
+}
+
+static void set_level(struct link *link, uint8_t level)
+{
+    int err;
+
+    if (level == link->level) {
+        return;
+    }
+
+    err = write_tx_power(link->handle, levels[level]);
+    if (err) {
+        printk("Failed to set TX power (err %d)\n", err);
+        return;
+    }
+    link->level = level;
+}
+
+/**
+ * @brief Check whether a link uses the Coded PHY.
+ */
+static bool link_coded(const struct link *link)
+{
+#if defined(CONFIG_APP_CODED_PHY)
+    struct bt_conn_info info;
+
+    return bt_conn_get_info(link->conn, &info) == 0 &&
+           info.le.phy->tx_phy == BT_GAP_LE_PHY_CODED;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Request a PHY change.
+ *
+ * @return True if the request was sent.
+ */
+static bool set_phy(struct link *link, bool coded)
+{
+#if defined(CONFIG_APP_CODED_PHY)
+    struct bt_conn_le_phy_param param = BT_CONN_LE_PHY_PARAM_INIT(
+        coded ? BT_GAP_LE_PHY_CODED : BT_GAP_LE_PHY_1M,
+        coded ? BT_GAP_LE_PHY_CODED : BT_GAP_LE_PHY_1M);
+    int err;
+
+    if (coded) {
+        param.options = IS_ENABLED(CONFIG_APP_CODED_PHY_S2) ? BT_CONN_LE_PHY_OPT_CODED_S2 :
+                                                              BT_CONN_LE_PHY_OPT_CODED_S8;
+    }
+
+    err = bt_conn_le_phy_update(link->conn, &param);
+    if (err) {
+        printk("PHY update failed (err %d)\n", err);
+        return false;
+    }
+
+    // The RSSI does not depend on the PHY, but the link behaviour does: start over
+    link->avg_rssi4 = 0;
+    return true;
+#else
+    ARG_UNUSED(link);
+    ARG_UNUSED(coded);
+    return false;
+#endif
+}
+
+static void control_link(struct link *link)
+{
+    int8_t rssi;
+
+    if (read_rssi(link->handle, &rssi)) {
+        stats.restores++;
+        link->stable = 0;
+        set_level(link, MAX_LEVEL);
+        return;
+    }
+
+    link->rssi = rssi;
+    if (link->avg_rssi4 == 0) {
+        link->avg_rssi4 = rssi * 4;
+    }
+
+    if (rssi * 4 < link->avg_rssi4 - DROP_DB * 4) {
+        // Sudden drop: the link may be losing packets, restore the margin at once
+        if (link->level != MAX_LEVEL) {
+            stats.restores++;
+        }
+        link->stable = 0;
+        link->avg_rssi4 = rssi * 4;
+        set_level(link, MAX_LEVEL);
+        return;
+    }
+
+    link->avg_rssi4 += rssi - link->avg_rssi4 / 4;
+    rssi = link->avg_rssi4 / 4;
+
+    if (rssi < TARGET_RSSI) {
+        link->stable = 0;
+        if (link->level < MAX_LEVEL) {
+            stats.steps_up++;
+            // Each step changes the RSSI seen by the peer, let the average settle
+            link->avg_rssi4 = 0;
+            set_level(link, link->level + 1);
+        } else if (!link_coded(link) && set_phy(link, true)) {
+            stats.to_coded++;
+        }
+    } else if (rssi > TARGET_RSSI + MARGIN_DB) {
+        if (++link->stable < STABLE_READS) {
+            return;
+        }
+        link->stable = 0;
+        if (link_coded(link)) {
+            if (set_phy(link, false)) {
+                stats.to_1m++;
+            }
+        } else if (link->level > 0) {
+            stats.steps_down++;
+            link->avg_rssi4 = 0;
+            set_level(link, link->level - 1);
+        }
+    } else {
+        link->stable = 0;
+    }
+}
+
+static void control_work_handler(struct k_work *work)
+{
+    bool any = false;
+
+    for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+        if (links[i].conn != NULL) {
+            control_link(&links[i]);
+            any = true;
+        }
+    }
+
+    if (any) {
+        k_work_reschedule(&control_work, K_MSEC(CONFIG_APP_TX_POWER_PERIOD_MS));
+    }
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    struct link *link = NULL;
+
+    if (err) {
+        return;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+        if (links[i].conn == NULL) {
+            link = &links[i];
+            break;
+        }
+    }
+    if (link == NULL || bt_hci_get_conn_handle(conn, &link->handle)) {
+        return;
+    }
+
+    link->conn = bt_conn_ref(conn);
+    link->level = DEFAULT_LEVEL;
+    link->stable = 0;
+    link->rssi = 0;
+    link->avg_rssi4 = 0;
+
+    k_work_reschedule(&control_work, K_MSEC(CONFIG_APP_TX_POWER_PERIOD_MS));
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+        if (links[i].conn == conn) {
+            bt_conn_unref(links[i].conn);
+            links[i].conn = NULL;
+        }
+    }
+
+    if (reason == BT_HCI_ERR_CONN_TIMEOUT) {
+        stats.timeouts++;
+    }
+}
+
+BT_CONN_CB_DEFINE(tx_power_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+};
+
+int tx_power_format_status(char *buf, size_t buf_size)
+{
+    size_t offset = 0;
+    int written;
+
+    for (size_t i = 0; i < ARRAY_SIZE(links); i++) {
+        if (links[i].conn == NULL) {
+            continue;
+        }
+        written = snprintf(buf + offset, buf_size - offset, "link %u: %d dBm rssi %d%s\n",
+                           (unsigned int)i, levels[links[i].level], links[i].rssi,
+                           link_coded(&links[i]) ? " coded" : "");
+        if (written < 0 || (size_t)written >= buf_size - offset) {
+            return -ENOMEM;
+        }
+        offset += written;
+    }
+
+    written = snprintf(buf + offset, buf_size - offset,
+                       "txp down %u up %u restore %u timeout %u coded %u 1m %u\n",
+                       stats.steps_down, stats.steps_up, stats.restores, stats.timeouts,
+                       stats.to_coded, stats.to_1m);
+    if (written < 0 || (size_t)written >= buf_size - offset) {
+        return -ENOMEM;
+    }
+
+    return offset + written;
+}
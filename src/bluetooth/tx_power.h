@@ -0,0 +1,33 @@
+/**
+ * @file tx_power.h
+ * @brief Per-connection TX power control driven by the link RSSI.
+ *
+ * Every CONFIG_APP_TX_POWER_PERIOD_MS the RSSI of each connection is read. The TX power
+ * is lowered one step while the RSSI stays above the target plus a margin, raised one step
+ * when the RSSI falls below the target, and set back to the maximum when the link degrades
+ * suddenly.
+ */
+
+#ifndef TX_POWER_H
+#define TX_POWER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * @brief Print the TX power and RSSI of each connection and the control counters.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int tx_power_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TX_POWER_H */
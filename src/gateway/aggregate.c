@@ -0,0 +1,180 @@
+/**
+ * @file aggregate.c
+ * @brief Merge of the scan streams of several monitors into one time-aligned log.
+ *
+ * Peers stamp their scans with their own clock. The gateway tracks the offset of each peer
+ * clock against its own (a slow moving average of the receive time minus the scan time), so
+ * the streams can be aligned even when the peers are not synchronized to wall-clock time.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "aggregate.h"
+#include "../sensor/scan.h"
+#include "../application/time_sync.h"
+
+#define MAX_PEERS   CONFIG_APP_GATEWAY_MAX_PEERS
+#define SLOT_MS     CONFIG_APP_GATEWAY_SLOT_MS
+#define SLOTS       CONFIG_APP_GATEWAY_AGG_SLOTS
+#define RESYNC_MS   (10 * MSEC_PER_SEC)  ///< Offset change treated as a clock jump
+
+/**
+ * @brief Clock offset of a peer against the gateway clock, modulo 2^32 ms.
+ */
+struct peer_clock {
+    uint32_t offset;
+    bool valid;
+};
+
+/**
+ * @brief Values kept per peer in a slot.
+ */
+struct agg_entry {
+    uint16_t pack_cv;
+    int16_t temp;
+};
+
+/**
+ * @brief One slot of the reordering window. Unused when no peer is present.
+ */
+struct agg_slot {
+    int64_t slot;
+    uint32_t present;
+    struct agg_entry entries[MAX_PEERS];
+};
+
+static K_MUTEX_DEFINE(agg_lock);
+static struct peer_clock clocks[MAX_PEERS];
+static struct agg_slot ring[SLOTS];
+static int64_t last_written = -1;
+static uint32_t streaming_mask;
+static struct aggregate_stats stats;
+
+/**
+ * @brief Convert a peer scan time to gateway time.
+ *
+ * @param peer Peer index.
+ * @param time_ms Lower 32 bits of the peer scan time.
+ * @return Scan time in ms on the gateway clock.
+ */
+static int64_t align_time(uint8_t peer, uint32_t time_ms)
+{
+    struct peer_clock *clock = &clocks[peer];
+    int64_t now = time_sync_now_ms();
+    uint32_t sample = (uint32_t)now - time_ms;
+    int32_t delta = (int32_t)(sample - clock->offset);
+
+    if (!clock->valid || delta > RESYNC_MS || delta < -RESYNC_MS) {
+        // First scan, or one of the clocks jumped (e.g. time synchronization)
+        clock->offset = sample;
+        clock->valid = true;
+    } else {
+        clock->offset += delta / 16;
+    }
+
+    // The aligned time is close to now, recover the upper bits from the gateway clock
+    return now - (int32_t)((uint32_t)now - (time_ms + clock->offset));
+}
+
+static void write_row(const struct agg_slot *s)
+{
+    printk("agg,%lld", s->slot * SLOT_MS);
+    for (uint8_t i = 0; i < MAX_PEERS; i++) {
+        if (s->present & BIT(i)) {
+            printk(",%u,%d", s->entries[i].pack_cv, s->entries[i].temp);
+        } else {
+            printk(",,");
+        }
+    }
+    printk("\n");
+
+    stats.rows++;
+    if ((s->present & streaming_mask) == streaming_mask) {
+        stats.complete_rows++;
+    }
+    last_written = s->slot;
+}
+
+/**
+ * @brief Write all pending slots older than a limit, oldest first.
+ */
+static void flush_until(int64_t limit)
+{
+    for (;;) {
+        struct agg_slot *oldest = NULL;
+
+        for (size_t i = 0; i < ARRAY_SIZE(ring); i++) {
+            if (ring[i].present && ring[i].slot < limit &&
+                (oldest == NULL || ring[i].slot < oldest->slot)) {
+                oldest = &ring[i];
+            }
+        }
+        if (oldest == NULL) {
+            return;
+        }
+
+        write_row(oldest);
+        oldest->present = 0;
+    }
+}
+
+void aggregate_set_streaming(uint8_t peer, bool streaming)
+{
+    k_mutex_lock(&agg_lock, K_FOREVER);
+    if (streaming) {
+        streaming_mask |= BIT(peer);
+    } else {
+        streaming_mask &= ~BIT(peer);
+        clocks[peer].valid = false;
+    }
+    k_mutex_unlock(&agg_lock);
+}
+
+void aggregate_add(uint8_t peer, const struct scan_record *rec)
+{
+    struct agg_slot *s;
+    int64_t slot;
+
+    if (peer >= MAX_PEERS) {
+        return;
+    }
+
+    k_mutex_lock(&agg_lock, K_FOREVER);
+
+    slot = align_time(peer, rec->time_ms) / SLOT_MS;
+    if (slot <= last_written) {
+        stats.late++;
+        k_mutex_unlock(&agg_lock);
+        return;
+    }
+
+    // Make room in the window, older slots are written even if incomplete
+    flush_until(slot - SLOTS + 1);
+
+    s = &ring[slot % SLOTS];
+    if (s->present && s->slot != slot) {
+        // Another peer is a whole window ahead, this scan is too old to be aligned
+        stats.late++;
+        k_mutex_unlock(&agg_lock);
+        return;
+    }
+    s->slot = slot;
+    s->present |= BIT(peer);
+    s->entries[peer].pack_cv = scan_pack_cv(rec);
+    s->entries[peer].temp = rec->temp;
+
+    if ((s->present & streaming_mask) == streaming_mask) {
+        flush_until(slot + 1);
+    }
+
+    k_mutex_unlock(&agg_lock);
+}
+
+void aggregate_stats_get(struct aggregate_stats *out)
+{
+    k_mutex_lock(&agg_lock, K_FOREVER);
+    *out = stats;
+    k_mutex_unlock(&agg_lock);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file aggregate.h
+ * @brief Time-aligned aggregate log of the scans received from several monitors.
+ *
+ * Scans are grouped into slots of CONFIG_APP_GATEWAY_SLOT_MS. A slot is written to the log
+ * (one CSV row on the console) as soon as every streaming peer has reported for it, or when it
+ * falls out of the reordering window. Rows are always written in time order.
+ */
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct scan_record;
+
+/**
+ * @brief Aggregation counters.
+ */
+struct aggregate_stats {
+    uint32_t rows;          ///< Rows written
+    uint32_t complete_rows; ///< Rows with a scan from every streaming peer
+    uint32_t late;          ///< Scans dropped because their slot was already written
+};
+
+/**
+ * @brief Mark a peer as streaming or not.
+ *
+ * A slot is complete when all streaming peers have reported for it.
+ *
+ * @param peer Peer index.
+ * @param streaming true when the peer is subscribed, false when it disconnected.
+ */
+void aggregate_set_streaming(uint8_t peer, bool streaming);
+
+/**
+ * @brief Add a scan received from a peer.
+ *
+ * @param peer Peer index.
+ * @param rec Received scan.
+ */
+void aggregate_add(uint8_t peer, const struct scan_record *rec);
+
+/**
+ * @brief Get the aggregation counters.
+ *
+ * @param stats Destination for the counters.
+ */
+void aggregate_stats_get(struct aggregate_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AGGREGATE_H */
@@ -0,0 +1,413 @@
+/**
+ * @file gateway.c
+ * @brief Central role connection manager of the gateway mode.
+ *
+ * For every monitor found while scanning the gateway:
+ * - creates a connection with an interval that gives every peer one connection event,
+ * - exchanges the ATT MTU so a whole scan record fits in one notification,
+ * - writes its own time to the peer Current Time characteristic when it is synchronized,
+ * - discovers the Scan characteristic and subscribes to it.
+ *
+ * Scanning is paused while a connection is being created and stops when all peer slots are
+ * in use.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#include "gateway.h"
+#include "aggregate.h"
+#include "../bluetooth/cts.h"
+#include "../bluetooth/service.h"
+#include "../sensor/scan.h"
+#include "../application/time_sync.h"
+
+#define MAX_PEERS CONFIG_APP_GATEWAY_MAX_PEERS
+
+#ifdef CONFIG_BT_CTLR_SDC_MAX_CONN_EVENT_LEN_DEFAULT
+#define CONN_EVENT_LEN_US CONFIG_BT_CTLR_SDC_MAX_CONN_EVENT_LEN_DEFAULT
+#else
+#define CONN_EVENT_LEN_US 2500
+#endif
+
+/* One connection event per peer and interval, so the peers never compete for the radio
+ * and every one of them can deliver a notification per interval (units of 1.25 ms). */
+#define CONN_INTERVAL MAX(6, DIV_ROUND_UP(MAX_PEERS * CONN_EVENT_LEN_US, 1250))
+#define CONN_TIMEOUT  400 ///< Supervision timeout in units of 10 ms
+
+enum peer_state {
+    PEER_FREE,
+    PEER_CONNECTING,
+    PEER_SETUP,
+    PEER_STREAMING,
+};
+
+/**
+ * @brief Connection to a monitor and the parameters of its pending GATT operations.
+ */
+struct peer {
+    struct bt_conn *conn;
+    enum peer_state state;
+    struct bt_gatt_exchange_params mtu_params;
+    struct bt_gatt_discover_params disc_params;
+    struct bt_gatt_write_params write_params;
+    struct bt_gatt_subscribe_params sub_params;
+    struct bt_gatt_discover_params ccc_disc_params;
+    uint8_t cts_value[CTS_CURRENT_TIME_LEN];
+};
+
+static struct peer peers[MAX_PEERS];
+static bool scanning;
+
+static const struct bt_uuid_128 monitor_uuid = BT_UUID_INIT_128(BT_UUID_BATTERY_VAL);
+static const struct bt_uuid_128 scan_uuid = BT_UUID_INIT_128(BT_UUID_SCAN_VAL);
+static const struct bt_uuid_16 cts_uuid = BT_UUID_INIT_16(BT_UUID_CTS_CURRENT_TIME_VAL);
+
+static const struct bt_le_conn_param conn_param =
+    BT_LE_CONN_PARAM_INIT(CONN_INTERVAL, CONN_INTERVAL, 0, CONN_TIMEOUT);
+
+static const struct bt_le_scan_param scan_param =
+    BT_LE_SCAN_PARAM_INIT(BT_LE_SCAN_TYPE_ACTIVE, BT_LE_SCAN_OPT_FILTER_DUPLICATE,
+                          BT_GAP_SCAN_FAST_INTERVAL, BT_GAP_SCAN_FAST_WINDOW);
+
+static void start_scan(void);
+
+static struct peer *find_peer(const struct bt_conn *conn)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+        if (peers[i].state != PEER_FREE && peers[i].conn == conn) {
+            return &peers[i];
+        }
+    }
+    return NULL;
+}
+
+static struct peer *find_state(enum peer_state state)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+        if (peers[i].state == state) {
+            return &peers[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t peer_index(const struct peer *peer)
+{
+    return peer - peers;
+}
+
+static void peer_fail(struct peer *peer, const char *step, int err)
+{
+    printk("Gateway peer %u: %s failed (err %d)\n", peer_index(peer), step, err);
+    bt_conn_disconnect(peer->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+}
+
+/**
+ * @brief Notification callback of a peer Scan characteristic.
+ */
+static uint8_t scan_notified(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+                             const void *data, uint16_t length)
+{
+    struct peer *peer = CONTAINER_OF(params, struct peer, sub_params);
+    const uint8_t *pos = data;
+    struct scan_record rec;
+
+    if (data == NULL) {
+        params->value_handle = 0;
+        return BT_GATT_ITER_STOP;
+    }
+
+    // Monitors may batch several consecutive scans in one notification
+    for (; length >= sizeof(rec); length -= sizeof(rec), pos += sizeof(rec)) {
+        memcpy(&rec, pos, sizeof(rec));
+        aggregate_add(peer_index(peer), &rec);
+    }
+
+    return BT_GATT_ITER_CONTINUE;
+}
+
+/**
+ * @brief Discovery callback of the peer Scan characteristic, subscribes to it.
+ */
+static uint8_t scan_discovered(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                               struct bt_gatt_discover_params *params)
+{
+    struct peer *peer = CONTAINER_OF(params, struct peer, disc_params);
+    const struct bt_gatt_chrc *chrc;
+    int err;
+
+    if (attr == NULL) {
+        peer_fail(peer, "scan discovery", -ENOENT);
+        return BT_GATT_ITER_STOP;
+    }
+
+    chrc = attr->user_data;
+
+    peer->sub_params.notify = scan_notified;
+    peer->sub_params.value_handle = chrc->value_handle;
+    peer->sub_params.ccc_handle = 0; // Discovered automatically
+    peer->sub_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    peer->sub_params.disc_params = &peer->ccc_disc_params;
+    peer->sub_params.value = BT_GATT_CCC_NOTIFY;
+
+    err = bt_gatt_subscribe(conn, &peer->sub_params);
+    if (err && err != -EALREADY) {
+        peer_fail(peer, "subscribe", err);
+        return BT_GATT_ITER_STOP;
+    }
+
+    peer->state = PEER_STREAMING;
+    aggregate_set_streaming(peer_index(peer), true);
+    printk("Gateway peer %u streaming\n", peer_index(peer));
+
+    return BT_GATT_ITER_STOP;
+}
+
+static void discover_scan(struct peer *peer)
+{
+    int err;
+
+    peer->disc_params.uuid = &scan_uuid.uuid;
+    peer->disc_params.func = scan_discovered;
+    peer->disc_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    peer->disc_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    peer->disc_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+    err = bt_gatt_discover(peer->conn, &peer->disc_params);
+    if (err) {
+        peer_fail(peer, "scan discovery", err);
+    }
+}
+
+static void cts_written(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+    struct peer *peer = CONTAINER_OF(params, struct peer, write_params);
+
+    if (err) {
+        printk("Gateway peer %u: time write failed (err %u)\n", peer_index(peer), err);
+    }
+
+    discover_scan(peer);
+}
+
+/**
+ * @brief Discovery callback of the peer Current Time characteristic.
+ *
+ * Shares the gateway time with the peer so the stored histories use the same time base.
+ */
+static uint8_t cts_discovered(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                              struct bt_gatt_discover_params *params)
+{
+    struct peer *peer = CONTAINER_OF(params, struct peer, disc_params);
+    const struct bt_gatt_chrc *chrc;
+    int err;
+
+    if (attr == NULL) {
+        discover_scan(peer);
+        return BT_GATT_ITER_STOP;
+    }
+
+    chrc = attr->user_data;
+    cts_encode_current_time(time_sync_now_ms(), peer->cts_value);
+
+    peer->write_params.func = cts_written;
+    peer->write_params.handle = chrc->value_handle;
+    peer->write_params.offset = 0;
+    peer->write_params.data = peer->cts_value;
+    peer->write_params.length = sizeof(peer->cts_value);
+
+    err = bt_gatt_write(conn, &peer->write_params);
+    if (err) {
+        discover_scan(peer);
+    }
+
+    return BT_GATT_ITER_STOP;
+}
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+                          struct bt_gatt_exchange_params *params)
+{
+    struct peer *peer = CONTAINER_OF(params, struct peer, mtu_params);
+    int rc;
+
+    if (err || bt_gatt_get_mtu(conn) - 3 < sizeof(struct scan_record)) {
+        peer_fail(peer, "MTU exchange", err ? err : -EMSGSIZE);
+        return;
+    }
+
+    if (!time_sync_is_synced()) {
+        discover_scan(peer);
+        return;
+    }
+
+    peer->disc_params.uuid = &cts_uuid.uuid;
+    peer->disc_params.func = cts_discovered;
+    peer->disc_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    peer->disc_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    peer->disc_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+    rc = bt_gatt_discover(conn, &peer->disc_params);
+    if (rc) {
+        discover_scan(peer);
+    }
+}
+
+static void gw_connected(struct bt_conn *conn, uint8_t err)
+{
+    struct peer *peer = find_peer(conn);
+    int rc;
+
+    if (peer == NULL) {
+        return; // Not a gateway connection
+    }
+
+    if (err) {
+        printk("Gateway connection failed (err %u)\n", err);
+        bt_conn_unref(peer->conn);
+        peer->conn = NULL;
+        peer->state = PEER_FREE;
+        start_scan();
+        return;
+    }
+
+    printk("Gateway peer %u connected\n", peer_index(peer));
+    peer->state = PEER_SETUP;
+
+    peer->mtu_params.func = mtu_exchanged;
+    rc = bt_gatt_exchange_mtu(conn, &peer->mtu_params);
+    if (rc) {
+        peer_fail(peer, "MTU exchange", rc);
+    }
+
+    start_scan();
+}
+
+static void gw_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    struct peer *peer = find_peer(conn);
+
+    if (peer == NULL) {
+        return;
+    }
+
+    printk("Gateway peer %u disconnected (reason %u)\n", peer_index(peer), reason);
+    aggregate_set_streaming(peer_index(peer), false);
+    bt_conn_unref(peer->conn);
+    peer->conn = NULL;
+    peer->state = PEER_FREE;
+
+    start_scan();
+}
+
+BT_CONN_CB_DEFINE(gateway_conn_callbacks) = {
+    .connected    = gw_connected,
+    .disconnected = gw_disconnected,
+};
+
+static bool ad_has_monitor_uuid(struct bt_data *data, void *user_data)
+{
+    bool *found = user_data;
+
+    if (data->type != BT_DATA_UUID128_ALL && data->type != BT_DATA_UUID128_SOME) {
+        return true;
+    }
+
+    for (size_t i = 0; i + 16 <= data->data_len; i += 16) {
+        if (memcmp(&data->data[i], monitor_uuid.val, 16) == 0) {
+            *found = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+                         struct net_buf_simple *ad)
+{
+    struct bt_conn *existing;
+    struct peer *peer;
+    bool found = false;
+    int err;
+
+    bt_data_parse(ad, ad_has_monitor_uuid, &found);
+    if (!found) {
+        return;
+    }
+
+    existing = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+    if (existing) {
+        bt_conn_unref(existing);
+        return;
+    }
+
+    peer = find_state(PEER_FREE);
+    if (peer == NULL) {
+        return;
+    }
+
+    if (bt_le_scan_stop()) {
+        return;
+    }
+    scanning = false;
+
+    err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, &conn_param, &peer->conn);
+    if (err) {
+        printk("Gateway create connection failed (err %d)\n", err);
+        start_scan();
+        return;
+    }
+
+    peer->state = PEER_CONNECTING;
+}
+
+static void start_scan(void)
+{
+    int err;
+
+    if (scanning || find_state(PEER_CONNECTING) || !find_state(PEER_FREE)) {
+        return;
+    }
+
+    err = bt_le_scan_start(&scan_param, device_found);
+    if (err) {
+        printk("Gateway scanning failed to start (err %d)\n", err);
+        return;
+    }
+
+    scanning = true;
+}
+
+void gateway_init(void)
+{
+    printk("Gateway: up to %u peers, connection interval %u x 1.25 ms\n",
+           MAX_PEERS, CONN_INTERVAL);
+    start_scan();
+}
+
+int gateway_format_status(char *buf, size_t buf_size)
+{
+    struct aggregate_stats stats;
+    unsigned int streaming = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+        if (peers[i].state == PEER_STREAMING) {
+            streaming++;
+        }
+    }
+
+    aggregate_stats_get(&stats);
+
+    return snprintf(buf, buf_size, "gw peers %u/%u rows %u complete %u late %u\n",
+                    streaming, MAX_PEERS, stats.rows, stats.complete_rows, stats.late);
+}
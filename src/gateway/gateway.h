@@ -0,0 +1,39 @@
+/**
+ * @file gateway.h
+ * @brief Gateway mode, collects the scans of other battery monitors over BLE connections.
+ *
+ * The gateway scans for monitors advertising the battery service, keeps up to
+ * CONFIG_APP_GATEWAY_MAX_PEERS concurrent connections, subscribes to their Scan
+ * characteristic and merges the streams in the aggregate log (see aggregate.h).
+ */
+
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * @brief Start scanning for monitors.
+ *
+ * Must be called after bluetooth_init().
+ */
+void gateway_init(void);
+
+/**
+ * @brief Print the gateway status (connected peers and aggregation counters) into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int gateway_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GATEWAY_H */
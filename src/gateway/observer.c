@@ -0,0 +1,209 @@
+/**
+ * @file observer.c
+ * @brief Passive scanning of the telemetry broadcast by the monitors.
+ *
+ * The scan window equals the scan interval so the radio listens continuously, and duplicate
+ * filtering is left to the application: the controller filter would hide updated frames.
+ *
+ * Every period, a dedicated thread forwards one FRAME_PACK frame per pack updated since the
+ * previous period, followed by a FRAME_FLEET frame (see frame.h), on the UART stream and on
+ * the live USB export. The thread waits for room in the output buffers, an output that stays
+ * full is skipped until the next period.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gap.h>
+
+#include "observer.h"
+#include "pack_table.h"
+#include "../bluetooth/adv_telemetry.h"
+#include "../output/frame.h"
+#include "../output/uart_stream.h"
+#include "../output/usb_export.h"
+
+#define FORWARD_BATCH 16 ///< Entries copied out of the table at a time
+#define SEND_TIMEOUT  K_MSEC(100) ///< Wait for room in an output before skipping it
+
+/**
+ * @brief Observer counters.
+ */
+struct observer_stats {
+    uint32_t frames;     ///< Telemetry frames received
+    uint32_t duplicates; ///< Frames dropped as repeats of the stored sequence number
+    uint32_t dropped;    ///< Frames dropped because the table was full
+    uint32_t unsent;     ///< Pack frames the wired outputs had no room for
+};
+
+static struct observer_stats stats;
+
+static const struct bt_le_scan_param scan_param =
+    BT_LE_SCAN_PARAM_INIT(BT_LE_SCAN_TYPE_PASSIVE, BT_LE_SCAN_OPT_NONE,
+                          BT_GAP_SCAN_FAST_INTERVAL, BT_GAP_SCAN_FAST_INTERVAL);
+
+/**
+ * @brief Outputs that made room for the frames of the current period.
+ */
+struct forward_outputs {
+    bool uart;
+    bool usb;
+};
+
+/**
+ * @brief Find the telemetry frame in the advertising data.
+ */
+static bool parse_telemetry(struct bt_data *data, void *user_data)
+{
+    struct adv_telemetry *frame = user_data;
+
+    if (data->type != BT_DATA_MANUFACTURER_DATA || data->data_len < sizeof(*frame)) {
+        return true;
+    }
+
+    memcpy(frame, data->data, sizeof(*frame));
+    if (sys_le16_to_cpu(frame->company) != ADV_TELEMETRY_COMPANY_ID ||
+        frame->magic != ADV_TELEMETRY_MAGIC) {
+        frame->magic = 0;
+        return true;
+    }
+
+    return false;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+                         struct net_buf_simple *ad)
+{
+    struct adv_telemetry frame = { 0 };
+    struct pack_entry update;
+    int err;
+
+    if (type != BT_GAP_ADV_TYPE_ADV_IND && type != BT_GAP_ADV_TYPE_ADV_NONCONN_IND &&
+        type != BT_GAP_ADV_TYPE_ADV_SCAN_IND) {
+        return;
+    }
+
+    bt_data_parse(ad, parse_telemetry, &frame);
+    if (frame.magic != ADV_TELEMETRY_MAGIC) {
+        return;
+    }
+
+    stats.frames++;
+
+    bt_addr_le_copy(&update.addr, addr);
+    update.rssi = rssi;
+    update.seq = sys_le16_to_cpu(frame.seq);
+    update.last_seen_ms = k_uptime_get_32();
+    update.pack_cv = sys_le16_to_cpu(frame.pack_cv);
+    update.min_cell_cv = sys_le16_to_cpu(frame.min_cell_cv);
+    update.max_cell_cv = sys_le16_to_cpu(frame.max_cell_cv);
+    update.temp = (int16_t)sys_le16_to_cpu(frame.temp);
+
+    err = pack_table_update(&update);
+    if (err == -EALREADY) {
+        stats.duplicates++;
+    } else if (err == -ENOMEM) {
+        stats.dropped++;
+    }
+}
+
+/**
+ * @brief Send a frame on the wired outputs that still have room in this period.
+ *
+ * @return true if at least one output took the frame.
+ */
+static bool send_frame(struct forward_outputs *out, uint8_t type, const void *payload,
+                       size_t len)
+{
+    bool sent = false;
+
+    if (IS_ENABLED(CONFIG_APP_UART_STREAM) && out->uart) {
+        out->uart = uart_stream_frame(type, payload, len, SEND_TIMEOUT) == 0;
+        sent |= out->uart;
+    }
+
+    // Nothing is sent until the host starts the live stream
+    if (IS_ENABLED(CONFIG_APP_USB_EXPORT) && out->usb) {
+        out->usb = usb_export_frame(type, payload, len, SEND_TIMEOUT) == 0;
+        sent |= out->usb;
+    }
+
+    return sent;
+}
+
+/**
+ * @brief Forward the packs updated since the previous period and expire silent ones.
+ */
+static void forward(void)
+{
+    struct forward_outputs out = { .uart = true, .usb = true };
+    struct pack_entry batch[FORWARD_BATCH];
+    struct frame_fleet fleet;
+    size_t cursor = 0;
+    size_t n;
+
+    while ((n = pack_table_collect(batch, ARRAY_SIZE(batch), &cursor)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            struct frame_pack frame = {
+                .addr_type = batch[i].addr.type,
+                .seq = sys_cpu_to_le16(batch[i].seq),
+                .pack_cv = sys_cpu_to_le16(batch[i].pack_cv),
+                .min_cell_cv = sys_cpu_to_le16(batch[i].min_cell_cv),
+                .max_cell_cv = sys_cpu_to_le16(batch[i].max_cell_cv),
+                .temp = sys_cpu_to_le16(batch[i].temp),
+                .rssi = batch[i].rssi,
+            };
+
+            memcpy(frame.addr, batch[i].addr.a.val, sizeof(frame.addr));
+            if (!send_frame(&out, FRAME_PACK, &frame, sizeof(frame))) {
+                stats.unsent++;
+            }
+        }
+    }
+
+    pack_table_expire(k_uptime_get_32(), CONFIG_APP_OBSERVER_TIMEOUT_S * MSEC_PER_SEC);
+
+    fleet.packs = sys_cpu_to_le16(pack_table_count());
+    fleet.frames = sys_cpu_to_le32(stats.frames);
+    fleet.duplicates = sys_cpu_to_le32(stats.duplicates);
+    fleet.dropped = sys_cpu_to_le32(stats.dropped);
+    fleet.unsent = sys_cpu_to_le32(stats.unsent);
+    send_frame(&out, FRAME_FLEET, &fleet, sizeof(fleet));
+}
+
+static void forward_thread(void *p1, void *p2, void *p3)
+{
+    for (;;) {
+        k_msleep(CONFIG_APP_OBSERVER_FORWARD_MS);
+        forward();
+    }
+}
+
+// Started by observer_init()
+K_THREAD_DEFINE(observer_tid, CONFIG_APP_OBSERVER_STACK_SIZE, forward_thread, NULL, NULL, NULL,
+                K_LOWEST_APPLICATION_THREAD_PRIO, 0, SYS_FOREVER_MS);
+
+void observer_init(void)
+{
+    int err = bt_le_scan_start(&scan_param, device_found);
+
+    if (err) {
+        printk("Observer scanning failed to start (err %d)\n", err);
+        return;
+    }
+
+    printk("Observer started, table of %u packs\n", CONFIG_APP_OBSERVER_TABLE_SIZE);
+    k_thread_start(observer_tid);
+}
+
+int observer_format_status(char *buf, size_t buf_size)
+{
+    return snprintf(buf, buf_size, "obs packs %u frames %u dup %u dropped %u unsent %u\n",
+                    (unsigned int)pack_table_count(), stats.frames, stats.duplicates,
+                    stats.dropped, stats.unsent);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file observer.h
+ * @brief Observer gateway, aggregates the telemetry broadcast by many monitors.
+ *
+ * The observer scans passively, decodes the telemetry frames found in the advertising data
+ * (see adv_telemetry.h), drops repeated frames by sequence number and keeps the latest values
+ * of every pack in a fixed-size table (see pack_table.h). Updated packs are forwarded as
+ * binary frames on the wired outputs every CONFIG_APP_OBSERVER_FORWARD_MS.
+ */
+
+#ifndef OBSERVER_H
+#define OBSERVER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * @brief Start passive scanning and periodic forwarding.
+ *
+ * Must be called after bluetooth_init().
+ */
+void observer_init(void);
+
+/**
+ * @brief Print the observer counters into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int observer_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OBSERVER_H */
@@ -0,0 +1,155 @@
+/**
+ * @file pack_table.c
+ * @brief Open addressing hash map of the latest telemetry per pack.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#include "pack_table.h"
+
+#define TABLE_SIZE  CONFIG_APP_OBSERVER_TABLE_SIZE
+#define TABLE_MASK  (TABLE_SIZE - 1)
+#define MAX_ENTRIES (TABLE_SIZE * 3 / 4)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(TABLE_SIZE), "CONFIG_APP_OBSERVER_TABLE_SIZE must be a power of two");
+
+static struct k_spinlock lock;
+static struct pack_entry table[TABLE_SIZE];
+static size_t count;
+
+/**
+ * @brief FNV-1a hash of an address.
+ */
+static size_t hash_addr(const bt_addr_le_t *addr)
+{
+    uint32_t hash = 2166136261u;
+
+    hash = (hash ^ addr->type) * 16777619u;
+    for (size_t i = 0; i < sizeof(addr->a.val); i++) {
+        hash = (hash ^ addr->a.val[i]) * 16777619u;
+    }
+
+    return hash & TABLE_MASK;
+}
+
+/**
+ * @brief Find the slot of an address, or the empty slot where it would be inserted.
+ */
+static size_t probe(const bt_addr_le_t *addr)
+{
+    size_t i = hash_addr(addr);
+
+    while (table[i].used && !bt_addr_le_eq(&table[i].addr, addr)) {
+        i = (i + 1) & TABLE_MASK;
+    }
+
+    return i;
+}
+
+/**
+ * @brief Remove the entry at a slot and shift back the entries of its probe sequence.
+ */
+static void remove_at(size_t i)
+{
+    size_t j = i;
+
+    for (;;) {
+        table[i].used = false;
+
+        for (;;) {
+            size_t home;
+
+            j = (j + 1) & TABLE_MASK;
+            if (!table[j].used) {
+                return;
+            }
+
+            // An entry stays where it is if its home slot lies cyclically in (i, j]
+            home = hash_addr(&table[j].addr);
+            if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j)) {
+                continue;
+            }
+            break;
+        }
+
+        table[i] = table[j];
+        i = j;
+    }
+}
+
+int pack_table_update(const struct pack_entry *update)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    size_t i = probe(&update->addr);
+    struct pack_entry *entry = &table[i];
+    int err = 0;
+
+    if (entry->used) {
+        if (entry->seq == update->seq) {
+            entry->last_seen_ms = update->last_seen_ms;
+            err = -EALREADY;
+            goto out;
+        }
+    } else if (count >= MAX_ENTRIES) {
+        err = -ENOMEM;
+        goto out;
+    } else {
+        count++;
+    }
+
+    *entry = *update;
+    entry->used = true;
+    entry->dirty = true;
+
+out:
+    k_spin_unlock(&lock, key);
+    return err;
+}
+
+size_t pack_table_collect(struct pack_entry *out, size_t max, size_t *cursor)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    size_t n = 0;
+
+    while (*cursor < TABLE_SIZE && n < max) {
+        struct pack_entry *entry = &table[(*cursor)++];
+
+        if (entry->used && entry->dirty) {
+            entry->dirty = false;
+            out[n++] = *entry;
+        }
+    }
+
+    k_spin_unlock(&lock, key);
+    return n;
+}
+
+size_t pack_table_expire(uint32_t now_ms, uint32_t timeout_ms)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    size_t removed = 0;
+    size_t i = 0;
+
+    while (i < TABLE_SIZE) {
+        if (table[i].used && (now_ms - table[i].last_seen_ms) > timeout_ms) {
+            // The shift may move an unvisited entry into slot i, so check it again
+            remove_at(i);
+            count--;
+            removed++;
+        } else {
+            i++;
+        }
+    }
+
+    k_spin_unlock(&lock, key);
+    return removed;
+}
+
+size_t pack_table_count(void)
+{
+    return count;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file pack_table.h
+ * @brief Fixed-size table with the latest telemetry of every pack heard by the observer.
+ *
+ * Open addressing with linear probing, keyed by the advertiser address. The capacity is
+ * CONFIG_APP_OBSERVER_TABLE_SIZE (a power of two) and inserts are refused above 3/4 load so
+ * probe sequences stay short. Entries not heard for a while are removed with backward-shift
+ * deletion, so no tombstones accumulate.
+ */
+
+#ifndef PACK_TABLE_H
+#define PACK_TABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+/**
+ * @brief Latest telemetry of a pack, in host byte order.
+ */
+struct pack_entry {
+    bt_addr_le_t addr;      ///< Advertiser address, the key
+    bool used;              ///< Slot holds an entry
+    bool dirty;             ///< Updated since it was last collected
+    int8_t rssi;            ///< RSSI of the last frame in dBm
+    uint16_t seq;           ///< Sequence number of the last frame
+    uint32_t last_seen_ms;  ///< Uptime (32 bits) of the last frame
+    uint16_t pack_cv;       ///< Pack voltage in cV
+    uint16_t min_cell_cv;   ///< Lowest battery voltage in cV
+    uint16_t max_cell_cv;   ///< Highest battery voltage in cV
+    int16_t temp;           ///< Internal temperature in 1/10 °C
+};
+
+/**
+ * @brief Insert or update the entry of a pack.
+ *
+ * @param update New values, the key is update->addr.
+ * @return 0 if the entry was inserted or updated, -EALREADY if the frame is a duplicate of
+ *         the stored one (same sequence number), or -ENOMEM if the table is full.
+ */
+int pack_table_update(const struct pack_entry *update);
+
+/**
+ * @brief Copy the entries updated since the last collection and clear their dirty flag.
+ *
+ * @param out Destination array.
+ * @param max Capacity of the destination array.
+ * @param cursor Slot to continue from, 0 to start. Updated for the next call.
+ * @return Number of entries copied, 0 when the whole table has been visited.
+ */
+size_t pack_table_collect(struct pack_entry *out, size_t max, size_t *cursor);
+
+/**
+ * @brief Remove the entries not heard for a while.
+ *
+ * @param now_ms Current uptime (32 bits).
+ * @param timeout_ms Age above which an entry is removed.
+ * @return Number of entries removed.
+ */
+size_t pack_table_expire(uint32_t now_ms, uint32_t timeout_ms);
+
+/**
+ * @brief Get the number of entries.
+ *
+ * @return Number of packs in the table.
+ */
+size_t pack_table_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PACK_TABLE_H */
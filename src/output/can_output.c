@@ -0,0 +1,231 @@
+/**
+ * @file can_output.c
+ * @brief Cyclic CAN telemetry frames.
+ *
+ * The frame layout is computed once at startup: a table gives, for every frame, its identifier
+ * and the range of signals it carries, so a transmission is just filling the signal values and
+ * copying each range. Frames are queued without waiting for a free mailbox; the time between
+ * queueing and the transmit-complete callback is the queueing latency.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "can_output.h"
+#include "../sensor/scan.h"
+#include "../sensor/pack_metrics.h"
+#include "../application/app_config.h"
+
+#define PDO_BASE_ID     0x180
+#define PDO_ID_STEP     0x100
+
+#define FRAME_SIGNALS   CAN_OUTPUT_FRAME_SIGNALS
+#define FRAME_COUNT     CAN_OUTPUT_FRAME_COUNT
+
+BUILD_ASSERT(FRAME_COUNT <= 4, "Signals do not fit in the four transmit PDOs");
+
+/**
+ * @brief Layout of one frame.
+ */
+struct frame_layout {
+    uint16_t id;        ///< Identifier, without the node id
+    uint8_t first;      ///< First signal carried
+    uint8_t count;      ///< Number of signals carried
+};
+
+static struct frame_layout layout[FRAME_COUNT];
+
+static const struct device *const can_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+
+/**
+ * @brief Transmission statistics.
+ */
+struct can_stats {
+    uint32_t queued;          ///< Frames handed to the driver
+    uint32_t sent;            ///< Frames transmitted
+    uint32_t dropped;         ///< Frames not queued (no free mailbox) or failed
+    uint32_t latency_sum_us;  ///< Sum of the queueing latencies of the sent frames
+    uint32_t latency_max_us;  ///< Largest queueing latency
+};
+
+static struct k_spinlock lock;
+static struct can_stats stats;
+static int64_t stats_since;
+static uint32_t queued_at[FRAME_COUNT];  ///< Cycle count when each frame was queued
+static uint16_t last_alarms;
+
+static void send_work_handler(struct k_work *work);
+static K_WORK_DEFINE(send_work, send_work_handler);
+
+static void period_handler(struct k_timer *timer)
+{
+    k_work_submit(&send_work);
+}
+
+static K_TIMER_DEFINE(period_timer, period_handler, NULL);
+
+static void tx_callback(const struct device *dev, int error, void *user_data)
+{
+    uint8_t index = POINTER_TO_UINT(user_data);
+    uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - queued_at[index]);
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (error) {
+        stats.dropped++;
+    } else {
+        stats.sent++;
+        stats.latency_sum_us += latency_us;
+        stats.latency_max_us = MAX(stats.latency_max_us, latency_us);
+    }
+    k_spin_unlock(&lock, key);
+}
+
+/**
+ * @brief Fill the signal values from a scan.
+ */
+static void fill_signals(const struct scan_record *rec, const struct app_config *cfg,
+                         uint16_t *signals)
+{
+    struct pack_metrics m;
+
+    pack_metrics_compute(rec, cfg, &m);
+
+    signals[CAN_SIG_PACK_CV] = m.pack_cv;
+    signals[CAN_SIG_MIN_CELL_CV] = m.min_cell_cv;
+    signals[CAN_SIG_MAX_CELL_CV] = m.max_cell_cv;
+    signals[CAN_SIG_ALARMS] = m.alarms;
+    signals[CAN_SIG_TEMP] = (uint16_t)rec->temp;
+    signals[CAN_SIG_AVG_CELL_CV] = m.avg_cell_cv;
+    signals[CAN_SIG_MIN_MAX_CELL] = m.min_cell | (m.max_cell << 8);
+    signals[CAN_SIG_SEQ] = rec->seq;
+    for (uint8_t i = 0; i < NUMBER_OF_BATTERIES_IN_SERIES; i++) {
+        signals[CAN_SIG_CELL_CV + i] = m.cell_cv[i];
+    }
+}
+
+void can_output_pack(const struct scan_record *rec, const struct app_config *cfg,
+                     struct can_frame *frames)
+{
+    uint16_t signals[CAN_SIG_COUNT];
+
+    fill_signals(rec, cfg, signals);
+
+    for (uint8_t i = 0; i < FRAME_COUNT; i++) {
+        const struct frame_layout *l = &layout[i];
+
+        frames[i] = (struct can_frame){
+            .id = l->id + CONFIG_APP_CAN_NODE_ID,
+            .dlc = can_bytes_to_dlc(l->count * sizeof(uint16_t)),
+            .flags = IS_ENABLED(CONFIG_APP_CAN_FD) ? (CAN_FRAME_FDF | CAN_FRAME_BRS) : 0,
+        };
+        for (uint8_t s = 0; s < l->count; s++) {
+            sys_put_le16(signals[l->first + s], &frames[i].data[s * sizeof(uint16_t)]);
+        }
+    }
+}
+
+static void send_work_handler(struct k_work *work)
+{
+    struct can_frame frames[FRAME_COUNT];
+    struct scan_record rec;
+    struct app_config cfg;
+
+    if (scan_latest_get(&rec)) {
+        return;
+    }
+    app_config_read(&cfg);
+    can_output_pack(&rec, &cfg, frames);
+
+    for (uint8_t i = 0; i < FRAME_COUNT; i++) {
+        k_spinlock_key_t key;
+        int err;
+
+        queued_at[i] = k_cycle_get_32();
+        err = can_send(can_dev, &frames[i], K_NO_WAIT, tx_callback, UINT_TO_POINTER(i));
+
+        key = k_spin_lock(&lock);
+        if (err) {
+            stats.dropped++;
+        } else {
+            stats.queued++;
+        }
+        k_spin_unlock(&lock, key);
+    }
+}
+
+int can_output_init(void)
+{
+    can_mode_t mode = IS_ENABLED(CONFIG_APP_CAN_FD) ? CAN_MODE_FD : CAN_MODE_NORMAL;
+    int err;
+
+    if (!device_is_ready(can_dev)) {
+        printk("CAN controller not ready\n");
+        return -ENODEV;
+    }
+
+    err = can_set_mode(can_dev, mode);
+    if (err) {
+        printk("Failed to set CAN mode (err %d)\n", err);
+        return err;
+    }
+
+    err = can_start(can_dev);
+    if (err) {
+        printk("Failed to start CAN controller (err %d)\n", err);
+        return err;
+    }
+
+    for (uint8_t i = 0; i < FRAME_COUNT; i++) {
+        layout[i].id = PDO_BASE_ID + i * PDO_ID_STEP;
+        layout[i].first = i * FRAME_SIGNALS;
+        layout[i].count = MIN(FRAME_SIGNALS, CAN_SIG_COUNT - layout[i].first);
+    }
+
+    stats_since = k_uptime_get();
+    k_timer_start(&period_timer, K_MSEC(CONFIG_APP_CAN_PERIOD_MS),
+                  K_MSEC(CONFIG_APP_CAN_PERIOD_MS));
+
+    return 0;
+}
+
+void can_output_scan(const struct scan_record *rec)
+{
+    struct app_config cfg;
+    struct pack_metrics m;
+
+    app_config_read(&cfg);
+    pack_metrics_compute(rec, &cfg, &m);
+
+    if (m.alarms != last_alarms) {
+        last_alarms = m.alarms;
+        k_work_submit(&send_work);
+    }
+}
+
+int can_output_format_status(char *buf, size_t buf_size)
+{
+    struct can_stats s;
+    int64_t now = k_uptime_get();
+    int64_t elapsed;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    // Rates cover the time since the previous status request
+    s = stats;
+    elapsed = MAX(now - stats_since, 1);
+    stats = (struct can_stats){ 0 };
+    stats_since = now;
+    k_spin_unlock(&lock, key);
+
+    return snprintf(buf, buf_size, "can %u.%u frames/s queued %u dropped %u latency avg %u max %u us\n",
+                    (uint32_t)((int64_t)s.sent * 1000 / elapsed),
+                    (uint32_t)((int64_t)s.sent * 10000 / elapsed % 10), s.queued, s.dropped,
+                    s.sent ? s.latency_sum_us / s.sent : 0, s.latency_max_us);
+}
@@ -0,0 +1,94 @@
+/**
+ * @file can_output.h
+ * @brief Cyclic CAN telemetry frames, laid out like CANopen transmit PDOs.
+ *
+ * The CAN controller is the devicetree chosen node "zephyr,canbus". Every signal is a
+ * little-endian 16-bit value. The signals are packed in order into 8-byte frames sent with the
+ * identifiers 0x180, 0x280, 0x380 and 0x480 plus the node id, or into a single 64-byte CAN FD
+ * frame with identifier 0x180 plus the node id. Frames are sent every
+ * CONFIG_APP_CAN_PERIOD_MS, and immediately when the alarm bits change.
+ */
+
+#ifndef CAN_OUTPUT_H
+#define CAN_OUTPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/util.h>
+
+#include "../sensor/main_voltage.h"
+
+struct scan_record;
+struct app_config;
+
+/** @brief Signals, in transmission order. */
+enum can_signal {
+    CAN_SIG_PACK_CV,      ///< Pack voltage in cV
+    CAN_SIG_MIN_CELL_CV,  ///< Lowest battery voltage in cV
+    CAN_SIG_MAX_CELL_CV,  ///< Highest battery voltage in cV
+    CAN_SIG_ALARMS,       ///< Alarm bits, see enum pack_alarm
+    CAN_SIG_TEMP,         ///< Internal temperature in 1/10 °C, signed
+    CAN_SIG_AVG_CELL_CV,  ///< Average battery voltage in cV
+    CAN_SIG_MIN_MAX_CELL, ///< Index of the lowest battery, index of the highest one in the high byte
+    CAN_SIG_SEQ,          ///< Scan sequence number
+    CAN_SIG_CELL_CV,      ///< First battery voltage in cV, one signal per battery
+    CAN_SIG_COUNT = CAN_SIG_CELL_CV + NUMBER_OF_BATTERIES_IN_SERIES,
+};
+
+/** @brief Payload length of a telemetry frame in bytes. */
+#if defined(CONFIG_APP_CAN_FD)
+#define CAN_OUTPUT_FRAME_LEN 64
+#else
+#define CAN_OUTPUT_FRAME_LEN 8
+#endif
+
+/** @brief Signals carried by a full telemetry frame. */
+#define CAN_OUTPUT_FRAME_SIGNALS (CAN_OUTPUT_FRAME_LEN / sizeof(uint16_t))
+
+/** @brief Telemetry frames sent per transmission. */
+#define CAN_OUTPUT_FRAME_COUNT DIV_ROUND_UP(CAN_SIG_COUNT, CAN_OUTPUT_FRAME_SIGNALS)
+
+/**
+ * @brief Start the CAN controller and the cyclic transmission.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int can_output_init(void);
+
+/**
+ * @brief Pack the signals of a scan into the telemetry frames.
+ *
+ * Uses the frame layout set up by can_output_init().
+ *
+ * @param rec Scan record.
+ * @param cfg Configuration holding the alarm thresholds.
+ * @param frames Destination, CAN_OUTPUT_FRAME_COUNT frames.
+ */
+void can_output_pack(const struct scan_record *rec, const struct app_config *cfg,
+                     struct can_frame *frames);
+
+/**
+ * @brief Send the frames right away if the alarm bits of a new scan changed.
+ *
+ * @param rec The latest scan.
+ */
+void can_output_scan(const struct scan_record *rec);
+
+/**
+ * @brief Print the transmission statistics (frames/s, queueing latency) into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int can_output_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_OUTPUT_H */
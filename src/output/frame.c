@@ -0,0 +1,75 @@
+/**
+ * @file frame.c
+ * @brief COBS framing with CRC.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+#include "frame.h"
+
+/**
+ * @brief COBS encode a buffer (without terminator).
+ *
+ * @return Encoded length, or -ENOMEM if the destination is too small.
+ */
+static int cobs_encode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size)
+{
+    size_t code_pos = 0;
+    size_t pos = 1;
+    uint8_t code = 1;
+
+    if (out_size == 0) {
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            if (pos >= out_size) {
+                return -ENOMEM;
+            }
+            out[pos++] = in[i];
+            code++;
+        }
+
+        if (in[i] == 0 || code == 0xFF) {
+            if (pos >= out_size) {
+                return -ENOMEM;
+            }
+            out[code_pos] = code;
+            code_pos = pos++;
+            code = 1;
+        }
+    }
+
+    out[code_pos] = code;
+
+    return pos;
+}
+
+int frame_encode(uint8_t type, const void *payload, size_t len, uint8_t *out, size_t out_size)
+{
+    uint8_t raw[1 + FRAME_MAX_PAYLOAD + 2];
+    uint16_t crc;
+    int encoded;
+
+    if (len > FRAME_MAX_PAYLOAD) {
+        return -ENOMEM;
+    }
+
+    raw[0] = type;
+    memcpy(&raw[1], payload, len);
+    crc = crc16_ccitt(0xFFFF, raw, 1 + len);
+    sys_put_le16(crc, &raw[1 + len]);
+
+    encoded = cobs_encode(raw, 1 + len + 2, out, out_size);
+    if (encoded < 0 || (size_t)encoded >= out_size) {
+        return -ENOMEM;
+    }
+
+    out[encoded++] = 0;
+
+    return encoded;
+}
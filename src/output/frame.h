@@ -0,0 +1,91 @@
+/**
+ * @file frame.h
+ * @brief Binary framing shared by the wired outputs.
+ *
+ * A frame is a type byte, the payload and a CRC-16/CCITT (init 0xFFFF, little-endian) over
+ * type and payload, COBS encoded and terminated by a zero byte. A receiver resynchronizes on
+ * the next zero byte after any error.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+#include "../sensor/main_voltage.h"
+
+/** @brief Frame types. */
+enum frame_type {
+    FRAME_SCAN        = 0x01, ///< Payload: struct scan_record
+    FRAME_HISTORY     = 0x02, ///< Payload: struct frame_history
+    FRAME_HISTORY_END = 0x03, ///< Payload: uint16_t number of history frames sent
+    FRAME_PACK        = 0x04, ///< Payload: struct frame_pack (observer gateway)
+    FRAME_FLEET       = 0x05, ///< Payload: struct frame_fleet (observer gateway)
+};
+
+/**
+ * @brief Payload of a FRAME_HISTORY frame. All fields are little-endian.
+ */
+struct frame_history {
+    uint32_t seq;                     ///< Sequence number in the storage log
+    int64_t time_ms;                  ///< Sample time in ms (see time_sync.h)
+    uint16_t tap_cv[TOTAL_CHANNELS];  ///< Tap voltages in cV
+} __packed;
+
+/**
+ * @brief Payload of a FRAME_PACK frame, a pack heard by the observer gateway. All fields are
+ *        little-endian.
+ */
+struct frame_pack {
+    uint8_t addr_type;                ///< Bluetooth address type
+    uint8_t addr[6];                  ///< Bluetooth address, least significant byte first
+    uint16_t seq;                     ///< Sequence number of the telemetry
+    uint16_t pack_cv;                 ///< Pack voltage in cV
+    uint16_t min_cell_cv;             ///< Lowest battery voltage in cV
+    uint16_t max_cell_cv;             ///< Highest battery voltage in cV
+    int16_t temp;                     ///< Temperature in 0.1 °C
+    int8_t rssi;                      ///< RSSI of the last frame in dBm
+} __packed;
+
+/**
+ * @brief Payload of a FRAME_FLEET frame, the observer counters sent after the packs of a
+ *        period. All fields are little-endian.
+ */
+struct frame_fleet {
+    uint16_t packs;                   ///< Packs in the table
+    uint32_t frames;                  ///< Telemetry frames received
+    uint32_t duplicates;              ///< Frames dropped as repeats
+    uint32_t dropped;                 ///< Frames dropped because the table was full
+    uint32_t unsent;                  ///< Pack frames the wired outputs had no room for
+} __packed;
+
+/** @brief Largest payload accepted by frame_encode(). */
+#define FRAME_MAX_PAYLOAD 64
+
+/** @brief Worst case size of an encoded frame with a payload of a given length. */
+#define FRAME_ENCODED_SIZE(payload_len) \
+    ((payload_len) + 3 + ((payload_len) + 3) / 254 + 1 + 1)
+
+/**
+ * @brief Encode a frame.
+ *
+ * @param type Frame type.
+ * @param payload Payload.
+ * @param len Payload length, at most FRAME_MAX_PAYLOAD.
+ * @param out Destination buffer.
+ * @param out_size Size of the destination buffer, FRAME_ENCODED_SIZE(len) is always enough.
+ * @return Length of the encoded frame including the zero terminator, or -ENOMEM.
+ */
+int frame_encode(uint8_t type, const void *payload, size_t len, uint8_t *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_H */
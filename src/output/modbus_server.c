@@ -0,0 +1,150 @@
+/**
+ * @file modbus_server.c
+ * @brief Modbus RTU server backed by a register image of the latest scan.
+ *
+ * The Modbus stack calls the read callback once per register from its own context. The image
+ * is rebuilt once per scan (metrics and alarms included) so the callback is a bounded copy and
+ * the response always meets the inter-frame timing, whatever the acquisition is doing.
+ *
+ * The stack has no per-request hook, so the callback detects the first register of a request
+ * and copies the whole image once for it: the registers of one request are read back to back
+ * at consecutive addresses, while the stack only handles the next request once the line has
+ * been idle for 3.5 characters (at most 1.75 ms). All registers of a response, 32-bit pairs
+ * included, therefore come from the same scan.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/modbus/modbus.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+
+#include "modbus_server.h"
+#include "../sensor/scan.h"
+#include "../sensor/pack_metrics.h"
+#include "../application/app_config.h"
+
+#define MODBUS_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(zephyr_modbus_serial)
+
+// Bits per character on the line: start, 8 data, parity, stop
+#define CHAR_BITS 11
+
+static struct k_spinlock lock;
+static uint16_t image[MB_REG_COUNT];
+static int64_t scan_uptime;
+static uint32_t scans;
+static uint32_t requests;
+
+// Copy of the image served to the request in progress, only used by the Modbus stack context
+static uint16_t request_image[MB_REG_COUNT];
+static uint16_t last_addr = UINT16_MAX;
+static uint32_t last_read_cyc;
+static uint32_t request_gap_cyc;  ///< Idle time after which a read starts a new request
+
+/**
+ * @brief Copy the register image for a new request.
+ */
+static void request_begin(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    requests++;
+    memcpy(request_image, image, sizeof(request_image));
+    request_image[MB_REG_AGE_S] =
+        scans ? MIN((k_uptime_get() - scan_uptime) / MSEC_PER_SEC, UINT16_MAX) : 0;
+    request_image[MB_REG_REQUESTS_LO] = (uint16_t)requests;
+    request_image[MB_REG_REQUESTS_HI] = requests >> 16;
+    k_spin_unlock(&lock, key);
+}
+
+static int input_reg_rd(uint16_t addr, uint16_t *reg)
+{
+    uint32_t now = k_cycle_get_32();
+
+    if (addr >= MB_REG_COUNT) {
+        return -ENOTSUP;
+    }
+
+    if (addr != last_addr + 1 || now - last_read_cyc > request_gap_cyc) {
+        request_begin();
+    }
+    last_addr = addr;
+    last_read_cyc = now;
+
+    *reg = request_image[addr];
+
+    return 0;
+}
+
+static struct modbus_user_callbacks server_cb = {
+    .input_reg_rd = input_reg_rd,
+};
+
+static const struct modbus_iface_param server_param = {
+    .mode = MODBUS_MODE_RTU,
+    .server = {
+        .user_cb = &server_cb,
+        .unit_id = CONFIG_APP_MODBUS_UNIT_ID,
+    },
+    .serial = {
+        .baud = CONFIG_APP_MODBUS_BAUD,
+        .parity = UART_CFG_PARITY_EVEN,
+    },
+};
+
+int modbus_server_init(void)
+{
+    int iface = modbus_iface_get_by_name(DEVICE_DT_NAME(MODBUS_NODE));
+    int err;
+
+    if (iface < 0) {
+        printk("Modbus interface not found (err %d)\n", iface);
+        return iface;
+    }
+
+    // Two characters, at most 1 ms: far above the callbacks of one request, below the end of
+    // frame silence before the next one
+    request_gap_cyc = k_us_to_cyc_ceil32(MIN(2 * CHAR_BITS * USEC_PER_SEC /
+                                             CONFIG_APP_MODBUS_BAUD, 1000));
+
+    err = modbus_init_server(iface, server_param);
+    if (err) {
+        printk("Modbus server init failed (err %d)\n", err);
+    }
+
+    return err;
+}
+
+void modbus_server_update(const struct scan_record *rec)
+{
+    struct app_config cfg;
+    struct pack_metrics m;
+    k_spinlock_key_t key;
+
+    app_config_read(&cfg);
+    pack_metrics_compute(rec, &cfg, &m);
+
+    key = k_spin_lock(&lock);
+    scans++;
+    scan_uptime = k_uptime_get();
+    image[MB_REG_SEQ] = rec->seq;
+    image[MB_REG_TIME_LO] = (uint16_t)rec->time_ms;
+    image[MB_REG_TIME_HI] = rec->time_ms >> 16;
+    image[MB_REG_TEMP] = (uint16_t)rec->temp;
+    image[MB_REG_PACK_CV] = m.pack_cv;
+    image[MB_REG_MIN_CELL_CV] = m.min_cell_cv;
+    image[MB_REG_MAX_CELL_CV] = m.max_cell_cv;
+    image[MB_REG_AVG_CELL_CV] = m.avg_cell_cv;
+    image[MB_REG_MIN_CELL] = m.min_cell;
+    image[MB_REG_MAX_CELL] = m.max_cell;
+    image[MB_REG_ALARMS] = m.alarms;
+    image[MB_REG_SCANS_LO] = (uint16_t)scans;
+    image[MB_REG_SCANS_HI] = scans >> 16;
+    for (uint8_t i = 0; i < NUMBER_OF_BATTERIES_IN_SERIES; i++) {
+        image[MB_REG_CELL_CV + i] = m.cell_cv[i];
+    }
+    k_spin_unlock(&lock, key);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file modbus_server.h
+ * @brief Modbus RTU server exposing the latest scan as input registers.
+ *
+ * The server runs on the "zephyr,modbus-serial" devicetree node, usually behind an RS-485
+ * transceiver. Every value is an input register (function code 0x04), read from a register
+ * image rebuilt after each scan, so a request never waits for the acquisition. All the
+ * registers of one request come from the same scan.
+ */
+
+#ifndef MODBUS_SERVER_H
+#define MODBUS_SERVER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../sensor/main_voltage.h"
+
+struct scan_record;
+
+/**
+ * @brief Input register map.
+ *
+ * Voltages are in cV, temperatures in 1/10 °C (signed). 32-bit values are split in two
+ * registers, low word first.
+ */
+enum modbus_input_reg {
+    MB_REG_SEQ = 0,           ///< Scan sequence number
+    MB_REG_TIME_LO,           ///< Scan time in ms, lower 32 bits (see time_sync.h)
+    MB_REG_TIME_HI,
+    MB_REG_AGE_S,             ///< Seconds since the scan, saturates at 65535
+    MB_REG_TEMP,              ///< Internal temperature
+    MB_REG_PACK_CV,           ///< Pack voltage
+    MB_REG_MIN_CELL_CV,       ///< Lowest battery voltage
+    MB_REG_MAX_CELL_CV,       ///< Highest battery voltage
+    MB_REG_AVG_CELL_CV,       ///< Average battery voltage
+    MB_REG_MIN_CELL,          ///< Index of the lowest battery
+    MB_REG_MAX_CELL,          ///< Index of the highest battery
+    MB_REG_ALARMS,            ///< Alarm bits, see enum pack_alarm
+    MB_REG_SCANS_LO,          ///< Scans since boot
+    MB_REG_SCANS_HI,
+    MB_REG_REQUESTS_LO,       ///< Input register requests served since boot, this one included
+    MB_REG_REQUESTS_HI,
+    MB_REG_CELL_CV,           ///< First battery voltage, one register per battery
+    MB_REG_COUNT = MB_REG_CELL_CV + NUMBER_OF_BATTERIES_IN_SERIES,
+};
+
+/**
+ * @brief Start the Modbus server.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int modbus_server_init(void);
+
+/**
+ * @brief Rebuild the register image from a new scan.
+ *
+ * @param rec The latest scan.
+ */
+void modbus_server_update(const struct scan_record *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODBUS_SERVER_H */
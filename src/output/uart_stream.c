@@ -0,0 +1,143 @@
+/**
+ * @file uart_stream.c
+ * @brief Scan stream over the asynchronous (DMA) UART API.
+ *
+ * Frames are appended to one of two buffers while the other one is transferred by DMA. The
+ * CPU only touches the UART when a buffer is handed over: when the line is idle a frame is
+ * sent right away, otherwise the frames accumulate until the running transfer completes.
+ * A producer in a thread can wait for the transfer to make room instead of dropping.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+
+#include "uart_stream.h"
+#include "frame.h"
+#include "../sensor/scan.h"
+
+#define STREAM_UART DT_CHOSEN(app_telemetry_uart)
+#define BUF_SIZE    CONFIG_APP_UART_STREAM_BUF_SIZE
+
+static const struct device *const uart = DEVICE_DT_GET(STREAM_UART);
+
+static struct k_spinlock lock;
+static uint8_t bufs[2][BUF_SIZE];
+static size_t fill_len;     ///< Bytes in the buffer being filled
+static uint8_t fill;        ///< Index of the buffer being filled
+static bool busy;           ///< The other buffer is being transferred
+static struct uart_stream_stats stats;
+
+static K_SEM_DEFINE(room_sem, 0, 1);  ///< Given when a transfer completes
+
+/**
+ * @brief Start transferring the buffer being filled if the line is idle. Lock must be held.
+ */
+static void start_locked(void)
+{
+    int err;
+
+    if (busy || fill_len == 0) {
+        return;
+    }
+
+    err = uart_tx(uart, bufs[fill], fill_len, SYS_FOREVER_US);
+    if (err) {
+        return; // Retried with the next frame
+    }
+
+    busy = true;
+    stats.transfers++;
+    fill ^= 1;
+    fill_len = 0;
+}
+
+static void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
+{
+    k_spinlock_key_t key;
+
+    switch (evt->type) {
+    case UART_TX_DONE:
+    case UART_TX_ABORTED:
+        key = k_spin_lock(&lock);
+        busy = false;
+        start_locked();
+        k_spin_unlock(&lock, key);
+        k_sem_give(&room_sem);
+        break;
+    default:
+        break;
+    }
+}
+
+int uart_stream_init(void)
+{
+    int err;
+
+    if (!device_is_ready(uart)) {
+        printk("Telemetry UART not ready\n");
+        return -ENODEV;
+    }
+
+    err = uart_callback_set(uart, uart_cb, NULL);
+    if (err) {
+        printk("Telemetry UART has no async API (err %d)\n", err);
+        return err;
+    }
+
+    return 0;
+}
+
+int uart_stream_frame(uint8_t type, const void *payload, size_t len, k_timeout_t timeout)
+{
+    uint8_t frame[FRAME_ENCODED_SIZE(FRAME_MAX_PAYLOAD)];
+    k_timepoint_t end = sys_timepoint_calc(timeout);
+    k_spinlock_key_t key;
+    int n;
+
+    n = frame_encode(type, payload, len, frame, sizeof(frame));
+    if (n < 0) {
+        return n;
+    }
+
+    for (;;) {
+        key = k_spin_lock(&lock);
+        if (fill_len + n <= BUF_SIZE) {
+            memcpy(&bufs[fill][fill_len], frame, n);
+            fill_len += n;
+            stats.frames++;
+            start_locked();
+            k_spin_unlock(&lock, key);
+            return 0;
+        }
+        k_spin_unlock(&lock, key);
+
+        if (k_sem_take(&room_sem, sys_timepoint_timeout(end))) {
+            break;
+        }
+    }
+
+    key = k_spin_lock(&lock);
+    stats.dropped++;
+    k_spin_unlock(&lock, key);
+
+    return -ENOBUFS;
+}
+
+void uart_stream_scan(const struct scan_record *rec)
+{
+    uart_stream_frame(FRAME_SCAN, rec, sizeof(*rec), K_NO_WAIT);
+}
+
+void uart_stream_stats_get(struct uart_stream_stats *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    *out = stats;
+    k_spin_unlock(&lock, key);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file uart_stream.h
+ * @brief Binary stream of every scan on a wired UART.
+ *
+ * The stream UART is the devicetree chosen node "app,telemetry-uart". Every scan is sent as a
+ * FRAME_SCAN frame (see frame.h), there is no command channel. The observer gateway queues
+ * its own frames with uart_stream_frame().
+ */
+
+#ifndef UART_STREAM_H
+#define UART_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+struct scan_record;
+
+/**
+ * @brief Stream counters.
+ */
+struct uart_stream_stats {
+    uint32_t frames;    ///< Frames queued for transmission
+    uint32_t dropped;   ///< Frames dropped because both buffers were full
+    uint32_t transfers; ///< DMA transfers started
+};
+
+/**
+ * @brief Register the UART callback.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int uart_stream_init(void);
+
+/**
+ * @brief Queue a scan for transmission. Never blocks.
+ *
+ * @param rec The scan to send.
+ */
+void uart_stream_scan(const struct scan_record *rec);
+
+/**
+ * @brief Queue a frame for transmission.
+ *
+ * @param type Frame type (see frame.h).
+ * @param payload Payload.
+ * @param len Payload length, at most FRAME_MAX_PAYLOAD.
+ * @param timeout How long to wait for the running transfer to make room, K_NO_WAIT from
+ *                an ISR.
+ * @return 0 on success, -ENOBUFS if the frame was dropped, or a frame_encode() error.
+ */
+int uart_stream_frame(uint8_t type, const void *payload, size_t len, k_timeout_t timeout);
+
+/**
+ * @brief Get a copy of the stream counters.
+ */
+void uart_stream_stats_get(struct uart_stream_stats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_STREAM_H */
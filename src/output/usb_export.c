@@ -0,0 +1,292 @@
+/**
+ * @file usb_export.c
+ * @brief Double-buffered export over the interrupt-driven UART API.
+ *
+ * Two transfer buffers rotate between the producers and the UART interrupt: while the ISR
+ * drains one buffer into the CDC ACM FIFO, frames are encoded into the other one. A buffer is
+ * handed to the ISR when it is full, at the end of a dump, or right away when the line is idle
+ * so live scans are not delayed. History dumps run in their own thread and read the samples
+ * straight from the storage log, blocking only when both buffers are in flight, without
+ * holding the lock of the buffer being filled.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/usb/usb_device.h>
+
+#include "usb_export.h"
+#include "frame.h"
+#include "../sensor/main_voltage.h"
+#include "../sensor/scan.h"
+
+#define EXPORT_UART DT_CHOSEN(app_export_uart)
+#define BUF_SIZE    CONFIG_APP_USB_EXPORT_BUF_SIZE
+
+/**
+ * @brief Transfer buffer.
+ */
+struct tx_buf {
+    uint8_t data[BUF_SIZE];
+    size_t len;
+};
+
+static const struct device *const uart = DEVICE_DT_GET(EXPORT_UART);
+static struct tx_buf bufs[2];
+
+// Buffers owned by the producers, and buffers waiting for the ISR, in order
+static K_MSGQ_DEFINE(free_q, sizeof(struct tx_buf *), ARRAY_SIZE(bufs), sizeof(void *));
+static K_MSGQ_DEFINE(ready_q, sizeof(struct tx_buf *), ARRAY_SIZE(bufs), sizeof(void *));
+
+static K_MUTEX_DEFINE(fill_lock);
+static struct tx_buf *filling;      ///< Buffer being filled, protected by fill_lock
+static struct tx_buf *sending;      ///< Buffer being drained, owned by the ISR
+static size_t sent;                 ///< Bytes of the sending buffer already in the FIFO
+
+static K_SEM_DEFINE(dump_sem, 0, 1);
+static bool live;
+static uint32_t live_dropped;
+
+static void flush_handler(struct k_work *work);
+static K_WORK_DEFINE(flush_work, flush_handler);
+
+/**
+ * @brief Hand the buffer being filled to the ISR. Must be called with fill_lock held.
+ */
+static void submit_locked(void)
+{
+    if (filling == NULL || filling->len == 0) {
+        return;
+    }
+
+    k_msgq_put(&ready_q, &filling, K_NO_WAIT); // Never full, there are only two buffers
+    filling = NULL;
+    uart_irq_tx_enable(uart);
+}
+
+static bool line_idle(void)
+{
+    return sending == NULL && k_msgq_num_used_get(&ready_q) == 0;
+}
+
+/**
+ * @brief Encode a frame into the buffer being filled.
+ *
+ * fill_lock is never held while waiting for a free buffer: a producer that has to wait
+ * releases it, so the live scans and the flush work are not held behind a history dump.
+ *
+ * @param timeout How long to wait for a free buffer.
+ * @param flush Hand the buffer to the ISR right away if the line is idle.
+ * @return 0 on success, -ENOBUFS if no buffer became free in time.
+ */
+static int append(uint8_t type, const void *payload, size_t len, k_timeout_t timeout,
+                  bool flush)
+{
+    uint8_t frame[FRAME_ENCODED_SIZE(FRAME_MAX_PAYLOAD)];
+    int n = frame_encode(type, payload, len, frame, sizeof(frame));
+    struct tx_buf *spare = NULL;
+
+    if (n < 0) {
+        return n;
+    }
+
+    k_mutex_lock(&fill_lock, K_FOREVER);
+
+    for (;;) {
+        if (filling != NULL && filling->len + n > BUF_SIZE) {
+            submit_locked();
+        }
+        if (filling != NULL) {
+            break;
+        }
+        if (spare != NULL) {
+            filling = spare;
+            filling->len = 0;
+            spare = NULL;
+            break;
+        }
+
+        k_mutex_unlock(&fill_lock);
+        if (k_msgq_get(&free_q, &spare, timeout)) {
+            return -ENOBUFS;
+        }
+        // Another producer may have opened a buffer in the meantime, check again
+        k_mutex_lock(&fill_lock, K_FOREVER);
+    }
+
+    memcpy(&filling->data[filling->len], frame, n);
+    filling->len += n;
+
+    if (flush && line_idle()) {
+        submit_locked();
+    }
+
+    k_mutex_unlock(&fill_lock);
+
+    // Not needed after all
+    if (spare != NULL) {
+        k_msgq_put(&free_q, &spare, K_NO_WAIT);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Send what is left in the buffer being filled once the line becomes idle.
+ */
+static void flush_handler(struct k_work *work)
+{
+    k_mutex_lock(&fill_lock, K_FOREVER);
+    submit_locked();
+    k_mutex_unlock(&fill_lock);
+}
+
+static void tx_continue(const struct device *dev)
+{
+    if (sending == NULL && k_msgq_get(&ready_q, &sending, K_NO_WAIT)) {
+        uart_irq_tx_disable(dev);
+        k_work_submit(&flush_work);
+        return;
+    }
+
+    sent += uart_fifo_fill(dev, &sending->data[sent], sending->len - sent);
+
+    if (sent == sending->len) {
+        k_msgq_put(&free_q, &sending, K_NO_WAIT);
+        sending = NULL;
+        sent = 0;
+    }
+}
+
+static void handle_command(uint8_t cmd)
+{
+    switch (cmd) {
+    case 'h':
+        k_sem_give(&dump_sem);
+        break;
+    case 'l':
+        live = true;
+        break;
+    case 's':
+        live = false;
+        break;
+    default:
+        break;
+    }
+}
+
+static void uart_isr(const struct device *dev, void *user_data)
+{
+    while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if (uart_irq_rx_ready(dev)) {
+            uint8_t cmd;
+
+            while (uart_fifo_read(dev, &cmd, 1) == 1) {
+                handle_command(cmd);
+            }
+        }
+
+        if (uart_irq_tx_ready(dev)) {
+            tx_continue(dev);
+        }
+    }
+}
+
+/**
+ * @brief Dump the storage log, one FRAME_HISTORY frame per sample, oldest first.
+ *
+ * Samples overwritten by new scans while the dump runs are skipped.
+ */
+static void dump_history(void)
+{
+    uint32_t first;
+    uint32_t end;
+    uint16_t dumped = 0;
+
+    history_range(&first, &end);
+    for (uint32_t seq = first; seq < end; seq++) {
+        struct frame_history frame = { .seq = seq };
+        uint16_t values[TOTAL_CHANNELS];
+        int64_t time_ms;
+
+        // The frame is packed, read into aligned locals
+        if (history_read(seq, &time_ms, values)) {
+            continue;
+        }
+        frame.time_ms = time_ms;
+        memcpy(frame.tap_cv, values, sizeof(values));
+        append(FRAME_HISTORY, &frame, sizeof(frame), K_FOREVER, false);
+        dumped++;
+    }
+
+    append(FRAME_HISTORY_END, &dumped, sizeof(dumped), K_FOREVER, true);
+
+    k_mutex_lock(&fill_lock, K_FOREVER);
+    submit_locked();
+    k_mutex_unlock(&fill_lock);
+}
+
+static void export_thread(void *p1, void *p2, void *p3)
+{
+    for (;;) {
+        k_sem_take(&dump_sem, K_FOREVER);
+        dump_history();
+    }
+}
+
+K_THREAD_DEFINE(usb_export_tid, CONFIG_APP_USB_EXPORT_STACK_SIZE, export_thread,
+                NULL, NULL, NULL, K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+int usb_export_init(void)
+{
+    int err;
+
+    if (!device_is_ready(uart)) {
+        printk("Export UART not ready\n");
+        return -ENODEV;
+    }
+
+    if (IS_ENABLED(CONFIG_USB_DEVICE_STACK)) {
+        err = usb_enable(NULL);
+        if (err && err != -EALREADY) {
+            printk("Failed to enable USB (err %d)\n", err);
+            return err;
+        }
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(bufs); i++) {
+        struct tx_buf *buf = &bufs[i];
+
+        k_msgq_put(&free_q, &buf, K_NO_WAIT);
+    }
+
+    uart_irq_callback_set(uart, uart_isr);
+    uart_irq_rx_enable(uart);
+
+    return 0;
+}
+
+int usb_export_frame(uint8_t type, const void *payload, size_t len, k_timeout_t timeout)
+{
+    int err;
+
+    if (!live) {
+        return -EAGAIN;
+    }
+
+    err = append(type, payload, len, timeout, true);
+    if (err) {
+        live_dropped++;
+    }
+
+    return err;
+}
+
+void usb_export_scan(const struct scan_record *rec)
+{
+    usb_export_frame(FRAME_SCAN, rec, sizeof(*rec), K_NO_WAIT);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file usb_export.h
+ * @brief High-speed export of the storage log and live scans over USB CDC ACM.
+ *
+ * The export UART is the devicetree chosen node "app,export-uart": the CDC ACM port on the
+ * board, or a pty backed UART on native_sim. Data is sent as frames (see frame.h). The host
+ * controls the export with single byte commands:
+ * - 'h': dump the storage log (FRAME_HISTORY frames followed by FRAME_HISTORY_END), the
+ *   last CONFIG_APP_HISTORY_LOG_LEN scans whether or not they were sent over Bluetooth,
+ * - 'l': start streaming live scans (FRAME_SCAN) and, on an observer gateway, the packs it
+ *   hears (FRAME_PACK, FRAME_FLEET),
+ * - 's': stop streaming live scans.
+ */
+
+#ifndef USB_EXPORT_H
+#define USB_EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+struct scan_record;
+
+/**
+ * @brief Enable USB and start listening for export commands.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int usb_export_init(void);
+
+/**
+ * @brief Queue a live scan for export, if live streaming is enabled.
+ *
+ * Never blocks: the scan is dropped if both transfer buffers are busy.
+ *
+ * @param rec The scan to export.
+ */
+void usb_export_scan(const struct scan_record *rec);
+
+/**
+ * @brief Queue a live frame for export, if live streaming is enabled.
+ *
+ * @param type Frame type (see frame.h).
+ * @param payload Payload.
+ * @param len Payload length, at most FRAME_MAX_PAYLOAD.
+ * @param timeout How long to wait for a free transfer buffer.
+ * @return 0 on success, -EAGAIN if live streaming is off, -ENOBUFS if the frame was dropped,
+ *         or a frame_encode() error.
+ */
+int usb_export_frame(uint8_t type, const void *payload, size_t len, k_timeout_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USB_EXPORT_H */
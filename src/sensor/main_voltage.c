@@ -7,6 +7,7 @@
  * Bluetooth.
  */
 
+#include <string.h>
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/adc.h>
 #include <hal/nrf_saadc.h>
@@ -18,45 +19,53 @@
 #include <zephyr/storage/flash_map.h>
 
 #include "../sensor/main_voltage.h"
+#include "../sensor/scan.h"
+#include "../sensor/internal_temp.h"
+#include "../sensor/radio_quiet.h"
+#include "../sensor/pack_monitor.h"
 #include "../bluetooth/bluetooth.h"
 #include "../bluetooth/service.h"
+#include "../bluetooth/buf_stats.h"
 #include "../hardware/mux.h"
+#include "../application/app_config.h"
+#include "../application/time_sync.h"
 #include <bluetooth/services/nus.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(main_voltage);  // Use your module name
 
-#define NUMBER_OF_BATTERIES_IN_SERIES 5
-#define NUMBER_OF_MUXES 2
-#define NUMBER_OF_MUX_CHANNELS 4
-#define TOTAL_CHANNELS (NUMBER_OF_MUXES * NUMBER_OF_MUX_CHANNELS)
-
 typedef struct {
-    int64_t timestamp;
+    uint32_t dt_ms;                       /* Milliseconds since the block epoch */
     uint16_t adc_values[TOTAL_CHANNELS];  /* Adjusted size to store all channels */
 } adc_sample_t;
 
-#define MAX_SAMPLES 128
-
-static adc_sample_t samples[MAX_SAMPLES];
+static adc_sample_t samples[CONFIG_APP_MAX_SAMPLES];
 static uint8_t sample_index = 0;
 
+/* A block is the set of samples buffered between two transfers. Samples store a compact
+ * millisecond delta against the wall-clock time of the first sample in the block. */
+static int64_t block_epoch_ms;      ///< Wall-clock time (ms since Unix epoch) of the first sample
+static int64_t block_start_uptime;  ///< Uptime of the first sample, reference for the deltas
+
 // Constants and configurations
 #define ADC_DEVICE_NAME DT_NODE_FULL_NAME(DT_NODELABEL(adc)) ///< ADC device node label
-#define R1              240000                              ///< Voltage divider resistor R1 (in ohms)
-#define R2              10000                               ///< Voltage divider resistor R2 (in kohms)
 #define ADC_REF_CV      330                                ///< Reference voltage in cV (centi volts)
 #define ADC_RESOLUTION  1024                                ///< ADC resolution (10-bit)
 
-#define ADC_SAMPLE_INTERVAL	20 ///< Sampling interval in milliseconds
 #define BATTERY_VOLTAGE(sample) (sample * 6 * 600 / 1024) ///< Macro for calculating battery voltage
 
 #define NVS_PARTITION		storage_partition
 #define NVS_PARTITION_OFFSET FIXED_PARTITION_OFFSET(nvs_storage)
 #define NVS_PARTITION_DEVICE FIXED_PARTITION_DEVICE(nvs_storage)
+#define NVS_PARTITION_SIZE   FIXED_PARTITION_SIZE(nvs_storage)
 
 #define ADDRESS_ID 1
 #define KEY_ID 2
+#define BLOCK_EPOCH_ID 0x100
+#define HISTORY_LOG_ID 0x200  ///< First NVS ID of the storage log ring
+
+BUILD_ASSERT(HISTORY_LOG_ID + CONFIG_APP_HISTORY_LOG_LEN <= UINT16_MAX,
+             "The storage log does not fit in the NVS ID space");
 
 // ADC configuration
 const struct device *adc_dev;
@@ -80,12 +89,15 @@ static struct adc_sequence sequence = {
  * reference voltage and the voltage divider circuit.
  *
  * @param adc_value Raw ADC reading.
+ * @param cfg Configuration holding the voltage divider.
  * @return Calculated scaled voltage
  */
-uint16_t convert_adc_to_scaled_voltage(uint32_t adc_value)
+uint16_t convert_adc_to_scaled_voltage(uint32_t adc_value, const struct app_config *cfg)
 {
     uint32_t v_adc = ((uint32_t)adc_value * ADC_REF_CV) / ADC_RESOLUTION; // ADC value to cV (centi volts)
-    uint16_t v_in = v_adc * (R1 + R2) / R2;                 // Adjust using voltage divider
+    uint16_t v_in;
+
+    v_in = (uint64_t)v_adc * (cfg->r1_ohm + cfg->r2_ohm) / cfg->r2_ohm; // Adjust using voltage divider
     return v_in;
 }
 
@@ -99,6 +111,7 @@ uint16_t convert_adc_to_scaled_voltage(uint32_t adc_value)
  */
 static int adc_sample(void)
 {
+	struct app_config cfg;
 	int err = adc_read(adc_dev, &sequence);
 	if (err) {
 		bt_send_voltage(3);
@@ -106,7 +119,8 @@ static int adc_sample(void)
         bt_send_voltage(err);
 		return err;
 	}
-	bt_send_voltage(convert_adc_to_scaled_voltage(adc_buffer[0])); // Send voltage in 0.1V units
+	app_config_read(&cfg);
+	bt_send_voltage(convert_adc_to_scaled_voltage(adc_buffer[0], &cfg)); // Send voltage in 0.1V units
 	return 0;
 }
 
@@ -115,6 +129,93 @@ static struct nvs_fs fs;
 #define FLASH_OFFSET 0xFE000  // adjust based on available space in flash
 #define FLASH_SECTOR_SIZE 4096  // common sector size, check your flash definition
 
+/* The storage log is a ring of CONFIG_APP_HISTORY_LOG_LEN NVS entries, independent from the
+ * transfer block: scan seq is stored at HISTORY_LOG_ID + seq % CONFIG_APP_HISTORY_LOG_LEN.
+ * Times never decrease with seq, the readers bisect on them. */
+typedef struct {
+    uint32_t seq;                     /* Sequence number, identifies the scan in its slot */
+    uint8_t synced;                   /* Time from a synchronized clock, as taken */
+    int64_t time_ms;                  /* Scan time in ms (see time_sync.h) */
+    uint16_t tap_cv[TOTAL_CHANNELS];
+} history_record_t;
+
+/* NVS keeps one sector free for garbage collection, closes every sector with two allocation
+ * table entries (ATE) and writes one ATE next to every entry. The newest copy of the samples
+ * of a full block, of the storage log and of the small entries must fit in the other sectors. */
+#define NVS_ATE_SIZE        8
+#define NVS_USABLE_SIZE     ((NVS_PARTITION_SIZE / FLASH_SECTOR_SIZE - 1) * \
+                             (FLASH_SECTOR_SIZE - 2 * NVS_ATE_SIZE))
+#define NVS_SAMPLES_SIZE    (CONFIG_APP_MAX_SAMPLES * (sizeof(adc_sample_t) + NVS_ATE_SIZE))
+#define NVS_HISTORY_SIZE    (CONFIG_APP_HISTORY_LOG_LEN * (sizeof(history_record_t) + NVS_ATE_SIZE))
+#define NVS_SMALL_SIZE      (4 * (16 + NVS_ATE_SIZE))  ///< Address, key, block epoch and spare
+
+BUILD_ASSERT(NVS_SAMPLES_SIZE + NVS_HISTORY_SIZE + NVS_SMALL_SIZE <= NVS_USABLE_SIZE,
+             "CONFIG_APP_HISTORY_LOG_LEN does not fit in the nvs_storage partition");
+
+static uint32_t history_next;          ///< Sequence number of the next scan
+static int64_t history_last_ms;        ///< Time of the newest scan, floor of the next one
+static struct k_spinlock history_lock;
+
+/**
+ * @brief Find the end of the storage log after a reboot.
+ *
+ * The newest scan is the slot holding the highest sequence number.
+ */
+static void history_init(void)
+{
+    history_record_t rec;
+    uint32_t next = 0;
+    int64_t last_ms = INT64_MIN;
+    k_spinlock_key_t key;
+
+    for (uint16_t slot = 0; slot < CONFIG_APP_HISTORY_LOG_LEN; slot++) {
+        if (nvs_read(&fs, HISTORY_LOG_ID + slot, &rec, sizeof(rec)) == sizeof(rec) &&
+            rec.seq % CONFIG_APP_HISTORY_LOG_LEN == slot && rec.seq >= next) {
+            next = rec.seq + 1;
+            last_ms = rec.time_ms;
+        }
+    }
+
+    key = k_spin_lock(&history_lock);
+    history_next = next;
+    history_last_ms = last_ms;
+    k_spin_unlock(&history_lock, key);
+
+    printk("Storage log: %u scans stored\n", MIN(next, CONFIG_APP_HISTORY_LOG_LEN));
+}
+
+/**
+ * @brief Append a scan to the storage log, overwriting the oldest one when it is full.
+ *
+ * Only called from the main loop, readers see the scan once it is in flash. The clock may
+ * restart from boot before the first time sync, or be set back by one: the time is then
+ * raised to the one of the previous scan and the record is not flagged as synced.
+ */
+static void history_append(int64_t time_ms, const uint16_t *values)
+{
+    history_record_t rec = { 0 };
+    k_spinlock_key_t key;
+    int rc;
+
+    key = k_spin_lock(&history_lock);
+    rec.seq = history_next;
+    rec.time_ms = MAX(time_ms, history_last_ms);
+    k_spin_unlock(&history_lock, key);
+    rec.synced = time_sync_is_synced() && rec.time_ms == time_ms;
+    memcpy(rec.tap_cv, values, sizeof(rec.tap_cv));
+
+    rc = nvs_write(&fs, HISTORY_LOG_ID + rec.seq % CONFIG_APP_HISTORY_LOG_LEN, &rec, sizeof(rec));
+    if (rc < 0) {
+        printk("Failed to log scan %u (err %d)\n", rec.seq, rc);
+        return;
+    }
+
+    key = k_spin_lock(&history_lock);
+    history_next = rec.seq + 1;
+    history_last_ms = rec.time_ms;
+    k_spin_unlock(&history_lock, key);
+}
+
 void flash_init(void)
 {
     printk("Flash init\n");
@@ -126,7 +227,7 @@ void flash_init(void)
 
     /* define the nvs file system by settings with:
 	 *	sector_size equal to the pagesize,
-	 *	3 sectors7
+	 *	as many sectors as the nvs_storage partition holds
 	 *	starting at NVS_PARTITION_OFFSET
 	 */
 	fs.flash_device = NVS_PARTITION_DEVICE;
@@ -144,7 +245,12 @@ void flash_init(void)
 		return 0;
 	}
 	fs.sector_size = info.size;
-	fs.sector_count = 3U;
+	fs.sector_count = NVS_PARTITION_SIZE / info.size;
+	if (info.size != FLASH_SECTOR_SIZE) {
+        // The log length is only checked at build time against FLASH_SECTOR_SIZE
+        printk("NVS sector size %u, the storage log bound assumes %u\n", info.size,
+               FLASH_SECTOR_SIZE);
+	}
 
     snprintf(debug_buf, sizeof(debug_buf), "Offset: 0x%x, Sector size: %u, Sector count: %u", fs.offset, fs.sector_size, fs.sector_count);
     bt_nus_send(NULL, debug_buf, strlen(debug_buf));
@@ -165,6 +271,7 @@ void flash_init(void)
     } else {
         snprintf(debug_buf, sizeof(debug_buf), "NVS mounted successfully at offset 0x%x\n. NVS ready: %d", fs.offset, fs.ready);
         bt_nus_send(NULL, debug_buf, strlen(debug_buf));
+        history_init();
     }
 
     /* ADDRESS_ID is used to store an address, lets see if we can
@@ -246,7 +353,7 @@ int format_csv(char *buffer, size_t buf_size) {
 
     // Write each sample
     for (uint8_t j = 0; j < sample_index; j++) { 
-        int written = snprintf(buffer + offset, buf_size - offset, "%lld", samples[j].timestamp);
+        int written = snprintf(buffer + offset, buf_size - offset, "%lld", block_epoch_ms + samples[j].dt_ms);
 
         if (written < 0 || (size_t)written >= buf_size - offset) {
             printf("Warning: Buffer too small, data truncated!\n");
@@ -300,7 +407,7 @@ int format_csv_nvs(char *buffer, size_t buf_size) {
 
     // Write each sample
     for (uint8_t j = 0; j < sample_index; j++) { 
-        int written = snprintf(buffer + offset, buf_size - offset, "%lld", samples[j].timestamp);
+        int written = snprintf(buffer + offset, buf_size - offset, "%lld", block_epoch_ms + samples[j].dt_ms);
 
         if (written < 0 || (size_t)written >= buf_size - offset) {
             printf("Warning: Buffer too small, data truncated!\n");
@@ -333,62 +440,344 @@ int format_csv_nvs(char *buffer, size_t buf_size) {
     return 0; // Success
 }
 
+/**
+ * @brief Get the timestamp of the sample about to be stored at sample_index.
+ *
+ * The first sample of a block opens a new epoch; later samples get the drift-corrected
+ * time elapsed since then.
+ *
+ * @return Milliseconds since the block epoch.
+ */
+static uint32_t next_sample_timestamp(void)
+{
+    if (sample_index == 0) {
+        block_start_uptime = k_uptime_get();
+        block_epoch_ms = time_sync_now_ms();
+        return 0;
+    }
+
+    return (uint32_t)time_sync_elapsed_ms(block_start_uptime);
+}
+
 void store_sample(void) {
+    struct app_config cfg;
     int err = adc_read(adc_dev, &sequence);
-    int64_t timestamp = k_uptime_get() / 1000;
 
-    if (sample_index < MAX_SAMPLES && err == 0) {
-        samples[sample_index].timestamp = timestamp;
+    app_config_read(&cfg);
+    if (sample_index < cfg.max_samples && err == 0) {
+        samples[sample_index].dt_ms = next_sample_timestamp();
 
         for (uint8_t mux = 0; mux < NUMBER_OF_MUXES; mux++) {
             for (uint8_t channel = 0; channel < NUMBER_OF_MUX_CHANNELS; channel++) {
                 adc_read(adc_dev, &sequence);
                 set_mux_channel(mux, channel);
-                k_sleep(K_USEC(50));  /* Allow settling */
+                k_sleep(K_USEC(cfg.settle_us));  /* Allow settling */
                 
                 // Ensure adc_buffer is properly used
-                samples[sample_index].adc_values[mux * NUMBER_OF_MUX_CHANNELS + channel] = convert_adc_to_scaled_voltage(adc_buffer[0]);
+                samples[sample_index].adc_values[mux * NUMBER_OF_MUX_CHANNELS + channel] = convert_adc_to_scaled_voltage(adc_buffer[0], &cfg);
             }
         }
         sample_index++;
     }
 }
 
-void store_sample_nvs(void) {
-    int err = adc_read(adc_dev, &sequence);
-    int64_t timestamp = k_uptime_get() / 1000;
-    char debug_buf[128];
+#if defined(CONFIG_APP_PACK_SENSOR)
+#define PACK_MONITOR_NODE DT_NODELABEL(pack_monitor)
 
-    if (sample_index < MAX_SAMPLES && err == 0) {
-        samples[sample_index].timestamp = timestamp;
+BUILD_ASSERT(2 * DT_PROP(PACK_MONITOR_NODE, channels_per_mux) == TOTAL_CHANNELS,
+             "The pack monitor must scan TOTAL_CHANNELS taps");
 
-        for (uint8_t mux = 0; mux < NUMBER_OF_MUXES; mux++) {
-            for (uint8_t channel = 0; channel < NUMBER_OF_MUX_CHANNELS; channel++) {
-                set_mux_channel(mux, channel);
-                k_sleep(K_USEC(50));  // Allow settling
+SENSOR_DT_READ_IODEV(pack_iodev, PACK_MONITOR_NODE, {SENSOR_CHAN_VOLTAGE, 0});
+RTIO_DEFINE(pack_rtio, 1, 1);
 
-                adc_read(adc_dev, &sequence);
-                samples[sample_index].adc_values[mux * NUMBER_OF_MUX_CHANNELS + channel] =
-                    convert_adc_to_scaled_voltage(adc_buffer[0]);
+static uint8_t pack_buf[PACK_MONITOR_BUF_SIZE(TOTAL_CHANNELS, 1)] __aligned(8);
+static struct app_config pack_cfg;  ///< Settings last given to the driver
+static bool pack_configured;
+
+/**
+ * @brief Give the driver the settings of the configuration that changed since the last scan.
+ *
+ * @param cfg Active configuration.
+ */
+static void pack_sensor_configure(const struct app_config *cfg)
+{
+    const struct device *dev = DEVICE_DT_GET(PACK_MONITOR_NODE);
+    struct sensor_value val = { 0 };
+
+    // The configuration can change at runtime, keep the decoder scale in step
+    if (!pack_configured || cfg->settle_us != pack_cfg.settle_us) {
+        val.val1 = cfg->settle_us;
+        sensor_attr_set(dev, SENSOR_CHAN_ALL, PACK_MONITOR_ATTR_SETTLE_US, &val);
+    }
+    if (!pack_configured || cfg->r1_ohm != pack_cfg.r1_ohm) {
+        val.val1 = cfg->r1_ohm;
+        sensor_attr_set(dev, SENSOR_CHAN_ALL, PACK_MONITOR_ATTR_DIVIDER_R1, &val);
+    }
+    if (!pack_configured || cfg->r2_ohm != pack_cfg.r2_ohm) {
+        val.val1 = cfg->r2_ohm;
+        sensor_attr_set(dev, SENSOR_CHAN_ALL, PACK_MONITOR_ATTR_DIVIDER_R2, &val);
+    }
+
+    pack_cfg = *cfg;
+    pack_configured = true;
+}
+
+/**
+ * @brief Submit a read of all taps to the pack monitor sensor.
+ *
+ * The driver scans in the RTIO work queue, the read ends with an entry in the completion
+ * queue of pack_rtio.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+static int scan_sensor_submit(void)
+{
+    struct rtio_sqe *sqe = rtio_sqe_acquire(&pack_rtio);
+
+    if (sqe == NULL) {
+        return -ENOMEM;
+    }
+    rtio_sqe_prep_read(sqe, &pack_iodev, RTIO_PRIO_NORM, pack_buf, sizeof(pack_buf), NULL);
+
+    return rtio_submit(&pack_rtio, 0);
+}
+
+/**
+ * @brief Take the completion of the read and decode the taps.
+ *
+ * @param values Destination for the TOTAL_CHANNELS tap voltages in cV.
+ * @param cfg Configuration of the scan.
+ * @return 0 on success, -EAGAIN if the read is still running, or the negative error code of
+ *         the read.
+ */
+static int scan_sensor_complete(uint16_t *values, const struct app_config *cfg)
+{
+    struct rtio_cqe *cqe = rtio_cqe_consume(&pack_rtio);
+    const uint16_t *raw = pack_monitor_frame(pack_buf, 0);
+    int result;
+
+    if (cqe == NULL) {
+        return -EAGAIN;
+    }
+    result = cqe->result;
+    rtio_cqe_release(&pack_rtio, cqe);
+    if (result) {
+        return result;
+    }
+
+    for (uint8_t i = 0; i < TOTAL_CHANNELS; i++) {
+        values[i] = convert_adc_to_scaled_voltage(raw[i], cfg);
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief Publish a scan as the latest snapshot and notify subscribed clients.
+ *
+ * @param values The TOTAL_CHANNELS tap voltages in cV.
+ */
+static void publish_scan(const uint16_t *values)
+{
+    struct scan_record rec = {
+        .time_ms = (uint32_t)time_sync_now_ms(),
+        .temp    = (int16_t)read_temperature_int(),
+    };
+
+    memcpy(rec.tap_cv, values, sizeof(rec.tap_cv));
+    scan_publish(&rec);
+}
+
+/**
+ * @brief Append a scan to the storage log and to the block of the next CSV transfer.
+ *
+ * @param values The TOTAL_CHANNELS tap voltages in cV.
+ * @param cfg Configuration of the scan.
+ */
+static void store_scan(const uint16_t *values, const struct app_config *cfg)
+{
+    int rc;
+
+    if (sample_index >= cfg->max_samples) {
+        // The transfer block is full until the next successful transfer
+        history_append(time_sync_now_ms(), values);
+        return;
+    }
+
+    samples[sample_index].dt_ms = next_sample_timestamp();
+    if (sample_index == 0) {
+        nvs_write(&fs, BLOCK_EPOCH_ID, &block_epoch_ms, sizeof(block_epoch_ms));
+    }
+    memcpy(samples[sample_index].adc_values, values, sizeof(samples[sample_index].adc_values));
+    history_append(block_epoch_ms + samples[sample_index].dt_ms, values);
+
+    rc = nvs_write(&fs, sample_index, &samples[sample_index], sizeof(samples[sample_index]));
+    if (rc < 0) {
+        printk("Failed to store sample %u (err %d)\n", sample_index, rc);
+        return;
+    }
+    sample_index++;
+}
+
+#if defined(CONFIG_APP_RADIO_QUIET)
+#define QUIET_RETRIES CONFIG_APP_RADIO_QUIET_MAX_RETRIES
+#else
+#define QUIET_RETRIES 0
+#endif
+
+/**
+ * @brief Scan in progress. Every step ends by raising the signal given to sample_scan_start():
+ *        the settling timer after a multiplexer switch, the radio notification at the end of
+ *        the radio event a conversion waits for, the ADC driver after a conversion. The read
+ *        of the pack monitor sensor ends in its completion queue instead.
+ */
+static struct {
+    struct k_poll_signal *signal;
+    enum { SCAN_IDLE, SCAN_SETTLING, SCAN_WAIT_QUIET, SCAN_CONVERTING, SCAN_READING } state;
+    uint8_t index;                    ///< Channel being settled or converted
+    uint8_t attempt;                  ///< Conversions of the channel overlapped by the radio
+    uint32_t token;                   ///< Radio-quiet token of the conversion
+    struct app_config cfg;            ///< Configuration read once at the start of the scan
+    uint16_t values[TOTAL_CHANNELS];
+} job;
+
+static void settle_expiry(struct k_timer *timer)
+{
+    k_poll_signal_raise(job.signal, 0);
+}
+
+static K_TIMER_DEFINE(settle_timer, settle_expiry, NULL);
+
+static void select_channel(void)
+{
+    set_mux_channel(job.index / NUMBER_OF_MUX_CHANNELS, job.index % NUMBER_OF_MUX_CHANNELS);
+    job.state = SCAN_SETTLING;
+    k_timer_start(&settle_timer, K_USEC(job.cfg.settle_us), K_NO_WAIT);
+}
+
+static int start_conversion(void)
+{
+    if (IS_ENABLED(CONFIG_APP_RADIO_QUIET) &&
+        radio_quiet_begin(job.signal, &job.token) == -EBUSY) {
+        // The signal is raised again at the end of the radio event
+        job.state = SCAN_WAIT_QUIET;
+        return 0;
+    }
+    job.state = SCAN_CONVERTING;
+
+    return adc_read_async(adc_dev, &sequence, job.signal);
+}
+
+static bool scan_abort(int err)
+{
+    printk("Scan aborted on channel %u (err %d)\n", job.index, err);
+    job.state = SCAN_IDLE;
+    return true;
+}
+
+static void scan_finish(void)
+{
+    publish_scan(job.values);
+    store_scan(job.values, &job.cfg);
+    job.state = SCAN_IDLE;
+}
+
+int sample_scan_start(struct k_poll_signal *signal)
+{
+    if (job.state != SCAN_IDLE) {
+        return -EBUSY;
+    }
+
+    job.signal = signal;
+    job.index = 0;
+    job.attempt = 0;
+    // A configuration change takes effect at the next scan
+    app_config_read(&job.cfg);
+
+#if defined(CONFIG_APP_PACK_SENSOR)
+    // The driver scans in the RTIO work queue, the read completes the whole scan
+    int err;
+
+    pack_sensor_configure(&job.cfg);
+    err = scan_sensor_submit();
+    if (err) {
+        printk("Pack monitor read not submitted (err %d)\n", err);
+        return err;
+    }
+    job.state = SCAN_READING;
+    return 0;
+#endif
+
+    select_channel();
+    return 0;
+}
+
+void sample_scan_poll_event_init(struct k_poll_event *event, struct k_poll_signal *signal)
+{
+#if defined(CONFIG_APP_PACK_SENSOR)
+    ARG_UNUSED(signal);
+    k_poll_event_init(event, K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+                      pack_rtio.consume_sem);
+#else
+    k_poll_event_init(event, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, signal);
+#endif
+}
+
+bool sample_scan_continue(int result)
+{
+    int err;
+
+    switch (job.state) {
+    case SCAN_SETTLING:
+    case SCAN_WAIT_QUIET:
+        err = start_conversion();
+        return err ? scan_abort(err) : false;
+
+    case SCAN_CONVERTING:
+        if (result) {
+            return scan_abort(result);
+        }
+
+        if (IS_ENABLED(CONFIG_APP_RADIO_QUIET)) {
+            if (!radio_quiet_end(job.token) && job.attempt < QUIET_RETRIES) {
+                job.attempt++;
+                err = start_conversion();
+                return err ? scan_abort(err) : false;
             }
+            radio_quiet_sample(job.index, adc_buffer[0]);
+        }
+
+        job.values[job.index] = convert_adc_to_scaled_voltage(adc_buffer[0], &job.cfg);
+        job.attempt = 0;
+        if (++job.index < TOTAL_CHANNELS) {
+            select_channel();
+            return false;
         }
 
-        int rc = nvs_write(&fs, sample_index, &samples[sample_index], sizeof(samples[sample_index])+1);
-        if (rc >= 0)
-        {
-            snprintf(debug_buf, sizeof(debug_buf), "Stored sample %d\n", sample_index);
-            bt_nus_send(NULL, debug_buf, strlen(debug_buf));
-            sample_index++;
+        if (IS_ENABLED(CONFIG_APP_RADIO_QUIET)) {
+            radio_quiet_scan_done();
         }
-        else
-        {
-            snprintf(debug_buf, sizeof(debug_buf), "Failed to store sample: %d\n", rc);
-            bt_nus_send(NULL, debug_buf, strlen(debug_buf));
+        scan_finish();
+        return true;
+
+#if defined(CONFIG_APP_PACK_SENSOR)
+    case SCAN_READING:
+        err = scan_sensor_complete(job.values, &job.cfg);
+        if (err == -EAGAIN) {
+            return false;
         }
+        if (err) {
+            // Nothing is published or stored for a failed read
+            return scan_abort(err);
+        }
+        scan_finish();
+        return true;
+#endif
+
+    default:
+        return false;
     }
-    
-    snprintf(debug_buf, sizeof(debug_buf), "Sample index: %d\n", sample_index);
-    bt_nus_send(NULL, debug_buf, strlen(debug_buf));
 }
 
 void attempt_send() {
@@ -398,6 +787,9 @@ void attempt_send() {
     format_csv(csv_buffer, sizeof(csv_buffer));
 
     err = bt_nus_send(NULL, csv_buffer, strlen(csv_buffer));
+    if (IS_ENABLED(CONFIG_APP_BUF_STATS)) {
+        buf_stats_tx(NULL, strlen(csv_buffer), err);
+    }
 
     if (!err) {
         sample_index = 0;
@@ -408,13 +800,55 @@ void attempt_send() {
 
 void load_samples_from_nvs(void) {
     sample_index = 0;
-    while (sample_index < MAX_SAMPLES) {
+    if (nvs_read(&fs, BLOCK_EPOCH_ID, &block_epoch_ms, sizeof(block_epoch_ms)) <= 0) {
+        return;  // No block stored
+    }
+    while (sample_index < CONFIG_APP_MAX_SAMPLES) {
         int rc = nvs_read(&fs, sample_index, &samples[sample_index], sizeof(samples[sample_index]));
         if (rc <= 0) {
             break;  // No more samples
         }
         sample_index++;
     }
+
+    /* The uptime of the block start is lost with the reboot. Rebase it so the deltas of the
+     * next samples continue after the last restored one: the time spent rebooting is not
+     * counted, but the times of the block never go backwards. */
+    if (sample_index > 0) {
+        block_start_uptime = k_uptime_get() - samples[sample_index - 1].dt_ms - 1;
+    }
+}
+
+void history_range(uint32_t *first, uint32_t *end)
+{
+    k_spinlock_key_t key = k_spin_lock(&history_lock);
+
+    *end = history_next;
+    k_spin_unlock(&history_lock, key);
+    *first = *end > CONFIG_APP_HISTORY_LOG_LEN ? *end - CONFIG_APP_HISTORY_LOG_LEN : 0;
+}
+
+int history_read(uint32_t seq, int64_t *time_ms, uint16_t *values)
+{
+    history_record_t rec;
+    int rc;
+
+    rc = nvs_read(&fs, HISTORY_LOG_ID + seq % CONFIG_APP_HISTORY_LOG_LEN, &rec, sizeof(rec));
+    if (rc < 0) {
+        return rc;
+    }
+    if (rc < (int)sizeof(rec)) {
+        return -EIO;
+    }
+    // The slot holds an older or newer scan
+    if (rec.seq != seq) {
+        return -ENOENT;
+    }
+
+    *time_ms = rec.time_ms;
+    memcpy(values, rec.tap_cv, sizeof(rec.tap_cv));
+
+    return 0;
 }
 
 void nvs_debug()
@@ -5,6 +5,17 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <stdint.h>
+
+struct k_poll_event;
+struct k_poll_signal;
+
+#define NUMBER_OF_BATTERIES_IN_SERIES 5
+#define NUMBER_OF_MUXES 2
+#define NUMBER_OF_MUX_CHANNELS 4
+#define TOTAL_CHANNELS (NUMBER_OF_MUXES * NUMBER_OF_MUX_CHANNELS)
+
 /**
  * @brief Initializes the ADC (Analog-to-Digital Converter) for voltage measurement.
  * 
@@ -21,12 +32,70 @@ void attempt_send(void);
 
 void load_samples_from_nvs(void);
 
-void store_sample_nvs(void);
+/**
+ * @brief Start a scan of all channels, stored in the storage log when complete.
+ *
+ * The scan runs as a sequence of steps (multiplexer settling, ADC conversion) that do not
+ * block: each step raises the signal when it ends, and the caller then runs the next one
+ * with sample_scan_continue().
+ *
+ * @param signal Signal raised at the end of each step, reset by the caller.
+ * @return 0 if the scan started, -EBUSY if a scan is in progress, or the negative error code
+ *         of the pack monitor read submission.
+ */
+int sample_scan_start(struct k_poll_signal *signal);
+
+/**
+ * @brief Initialize the poll event that fires at the end of each scan step.
+ *
+ * The event waits for the signal given to sample_scan_start(), or with
+ * CONFIG_APP_PACK_SENSOR for the completion of the sensor read (K_POLL_TYPE_SEM_AVAILABLE),
+ * which sample_scan_continue() consumes.
+ *
+ * @param event The event to initialize.
+ * @param signal Signal given to sample_scan_start().
+ */
+void sample_scan_poll_event_init(struct k_poll_event *event, struct k_poll_signal *signal);
+
+/**
+ * @brief Run the next step of the scan in progress.
+ *
+ * @param result Result of the signal (ADC conversion result), 0 for the sensor read.
+ * @return true when the scan has ended, published and stored, or aborted on an error.
+ */
+bool sample_scan_continue(int result);
 
 void nvs_debug(void);
 
 void flash_init(void);
 
+/**
+ * @brief Get the range of the storage log.
+ *
+ * The storage log keeps the last CONFIG_APP_HISTORY_LOG_LEN scans in NVS, whether or not
+ * they have been sent as CSV. Every scan gets the next sequence number, which survives a
+ * reboot, so a reader can resume from the last sequence number it received.
+ *
+ * @param first Destination for the sequence number of the oldest scan.
+ * @param end Destination for the sequence number the next scan will get.
+ */
+void history_range(uint32_t *first, uint32_t *end);
+
+/**
+ * @brief Read a scan from the storage log.
+ *
+ * The scan is read from NVS, not from a RAM buffer.
+ *
+ * @param seq Sequence number of the scan.
+ * @param time_ms Destination for the scan time (see time_sync.h). Times never decrease with
+ *                the sequence number, a scan taken with the clock behind gets the time of
+ *                the previous one.
+ * @param values Destination for the TOTAL_CHANNELS tap voltages in cV.
+ * @return 0 on success, -ENOENT if the scan is not in the log (overwritten or not taken
+ *         yet), or a negative error code.
+ */
+int history_read(uint32_t seq, int64_t *time_ms, uint16_t *values);
+
 #ifdef __cplusplus
 }
 #endif
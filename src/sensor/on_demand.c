@@ -0,0 +1,207 @@
+/**
+ * @file on_demand.c
+ * @brief On-demand sampling: no periodic scans, client reads trigger them.
+ *
+ * GATT reads run in the Bluetooth RX thread and wait on a condition variable for the main loop
+ * to complete the scan. NUS commands run in the main loop itself, so they cannot wait: the
+ * client is remembered and answered when the scan ends. A scan generation counter tells the
+ * waiters whether the scan that ended was published or aborted.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/sys/printk.h>
+#include <bluetooth/services/nus.h>
+
+#include "on_demand.h"
+#include "scan.h"
+#include "../application/application.h"
+
+#define WINDOW_MS CONFIG_APP_ON_DEMAND_WINDOW_MS
+
+/**
+ * @brief Request counters.
+ */
+struct on_demand_stats {
+    uint32_t requests;   ///< Reads and "scan" commands
+    uint32_t scans;      ///< Scans started for them
+    uint32_t shared;     ///< Requests answered with a recent or running scan
+    uint32_t timeouts;   ///< Reads answered with an older scan
+};
+
+static K_MUTEX_DEFINE(lock);
+static K_CONDVAR_DEFINE(scan_done);
+static struct scan_record latest;
+static int64_t latest_ms;           ///< Uptime of the latest scan, 0 if none
+static uint32_t generation;         ///< Scans published
+static uint32_t ended;              ///< Scans ended, published or aborted
+static bool requested;              ///< A scan is requested or running
+static uint32_t requested_gen;      ///< Generation when the scan was requested
+static struct bt_conn *waiting[CONFIG_BT_MAX_CONN];  ///< NUS clients waiting for the scan
+static struct on_demand_stats stats;
+
+/**
+ * @brief Check whether the latest scan can answer a request. Must be called with lock held.
+ */
+static bool fresh_locked(void)
+{
+    return latest_ms != 0 && k_uptime_get() - latest_ms <= WINDOW_MS;
+}
+
+/**
+ * @brief Make sure a scan is requested or running. Must be called with lock held.
+ */
+static void request_locked(void)
+{
+    if (requested) {
+        stats.shared++;
+        return;
+    }
+
+    requested = true;
+    requested_gen = generation;
+    stats.scans++;
+    application_request_scan();
+}
+
+int on_demand_read(struct scan_record *rec)
+{
+    k_timepoint_t deadline = sys_timepoint_calc(K_MSEC(CONFIG_APP_ON_DEMAND_READ_TIMEOUT_MS));
+    uint32_t gen;
+    uint32_t end;
+    int err = 0;
+
+    k_mutex_lock(&lock, K_FOREVER);
+    stats.requests++;
+
+    if (fresh_locked()) {
+        stats.shared++;
+        *rec = latest;
+        k_mutex_unlock(&lock);
+        return 0;
+    }
+
+    gen = generation;
+    end = ended;
+    request_locked();
+
+    while (ended == end) {
+        if (k_condvar_wait(&scan_done, &lock, sys_timepoint_timeout(deadline))) {
+            break;
+        }
+    }
+
+    if (generation != gen) {
+        *rec = latest;
+    } else {
+        stats.timeouts++;
+        err = -EAGAIN;
+    }
+
+    k_mutex_unlock(&lock);
+    return err;
+}
+
+/**
+ * @brief Send a scan to a client as a NUS text line.
+ */
+static void send_scan(struct bt_conn *conn, const struct scan_record *rec)
+{
+    char line[96];
+    int len = snprintf(line, sizeof(line), "scan %u,%u", rec->seq, rec->time_ms);
+
+    for (int i = 0; i < TOTAL_CHANNELS; i++) {
+        len += snprintf(&line[len], sizeof(line) - len, ",%u", rec->tap_cv[i]);
+    }
+    len += snprintf(&line[len], sizeof(line) - len, ",%d\n", rec->temp);
+
+    bt_nus_send(conn, line, strlen(line));
+}
+
+void on_demand_reply(struct bt_conn *conn)
+{
+    static const char busy[] = "scan busy\n";
+    struct scan_record rec;
+    int i;
+
+    k_mutex_lock(&lock, K_FOREVER);
+    stats.requests++;
+
+    if (fresh_locked()) {
+        stats.shared++;
+        rec = latest;
+        k_mutex_unlock(&lock);
+        send_scan(conn, &rec);
+        return;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(waiting); i++) {
+        if (waiting[i] == conn) {
+            break;  // Already waiting, one answer is enough
+        }
+        if (waiting[i] == NULL) {
+            waiting[i] = bt_conn_ref(conn);
+            break;
+        }
+    }
+    if (i == ARRAY_SIZE(waiting)) {
+        // Slots still held by clients that disconnected before the scan ended
+        k_mutex_unlock(&lock);
+        bt_nus_send(conn, busy, strlen(busy));
+        return;
+    }
+    request_locked();
+
+    k_mutex_unlock(&lock);
+}
+
+void on_demand_scan(const struct scan_record *rec)
+{
+    k_mutex_lock(&lock, K_FOREVER);
+    latest = *rec;
+    latest_ms = k_uptime_get();
+    generation++;
+    k_mutex_unlock(&lock);
+}
+
+void on_demand_scan_ended(void)
+{
+    static const char failed[] = "scan failed\n";
+    struct bt_conn *conns[ARRAY_SIZE(waiting)];
+    struct scan_record rec;
+    bool published;
+
+    k_mutex_lock(&lock, K_FOREVER);
+    ended++;
+    requested = false;
+    published = generation != requested_gen;
+    rec = latest;
+    memcpy(conns, waiting, sizeof(conns));
+    memset(waiting, 0, sizeof(waiting));
+    k_condvar_broadcast(&scan_done);
+    k_mutex_unlock(&lock);
+
+    for (int i = 0; i < ARRAY_SIZE(conns) && conns[i] != NULL; i++) {
+        if (published) {
+            send_scan(conns[i], &rec);
+        } else {
+            bt_nus_send(conns[i], failed, strlen(failed));
+        }
+        bt_conn_unref(conns[i]);
+    }
+}
+
+int on_demand_format_status(char *buf, size_t buf_size)
+{
+    struct on_demand_stats s;
+
+    k_mutex_lock(&lock, K_FOREVER);
+    s = stats;
+    k_mutex_unlock(&lock);
+
+    return snprintf(buf, buf_size, "on-demand requests %u scans %u shared %u timeouts %u\n",
+                    s.requests, s.scans, s.shared, s.timeouts);
+}
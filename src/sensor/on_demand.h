@@ -0,0 +1,68 @@
+/**
+ * @file on_demand.h
+ * @brief On-demand sampling: no periodic scans, client reads trigger them.
+ *
+ * With CONFIG_APP_ON_DEMAND the main loop never scans on its own. A read of the Scan
+ * characteristic or the NUS command "scan" requests a scan and is answered with it. Requests
+ * arriving within CONFIG_APP_ON_DEMAND_WINDOW_MS of the last scan get that scan, and requests
+ * arriving while a scan runs wait for it, so readers close in time share one scan.
+ */
+
+#ifndef ON_DEMAND_H
+#define ON_DEMAND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+struct bt_conn;
+struct scan_record;
+
+/**
+ * @brief Get a fresh scan, waiting for a new one if needed.
+ *
+ * Blocks for at most CONFIG_APP_ON_DEMAND_READ_TIMEOUT_MS. Must not be called from the main
+ * loop, which runs the scan.
+ *
+ * @param rec Destination for the scan.
+ * @return 0 on success, -EAGAIN if the scan did not complete in time.
+ */
+int on_demand_read(struct scan_record *rec);
+
+/**
+ * @brief Send a fresh scan to a client over NUS, now or when the next scan completes.
+ *
+ * Called from the main loop (NUS command).
+ *
+ * @param conn The client.
+ */
+void on_demand_reply(struct bt_conn *conn);
+
+/**
+ * @brief Record a published scan as the latest one served on demand.
+ *
+ * @param rec The scan.
+ */
+void on_demand_scan(const struct scan_record *rec);
+
+/**
+ * @brief Answer the requests waiting for the scan that just ended, completed or aborted.
+ */
+void on_demand_scan_ended(void);
+
+/**
+ * @brief Print the request counters into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int on_demand_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ON_DEMAND_H */
@@ -0,0 +1,49 @@
+/**
+ * @file pack_metrics.c
+ * @brief Pack level values derived from a scan.
+ */
+
+#include "pack_metrics.h"
+#include "scan.h"
+#include "../application/app_config.h"
+
+void pack_metrics_compute(const struct scan_record *rec, const struct app_config *cfg,
+                          struct pack_metrics *out)
+{
+    uint32_t sum = 0;
+
+    out->min_cell = 0;
+    out->max_cell = 0;
+
+    for (uint8_t i = 0; i < NUMBER_OF_BATTERIES_IN_SERIES; i++) {
+        uint16_t cell = scan_cell_cv(rec, i);
+
+        out->cell_cv[i] = cell;
+        sum += cell;
+        if (cell < out->cell_cv[out->min_cell]) {
+            out->min_cell = i;
+        }
+        if (cell > out->cell_cv[out->max_cell]) {
+            out->max_cell = i;
+        }
+    }
+
+    out->pack_cv = scan_pack_cv(rec);
+    out->min_cell_cv = out->cell_cv[out->min_cell];
+    out->max_cell_cv = out->cell_cv[out->max_cell];
+    out->avg_cell_cv = sum / NUMBER_OF_BATTERIES_IN_SERIES;
+
+    out->alarms = 0;
+    if (out->min_cell_cv < cfg->cell_low_cv) {
+        out->alarms |= PACK_ALARM_CELL_LOW;
+    }
+    if (out->max_cell_cv > cfg->cell_high_cv) {
+        out->alarms |= PACK_ALARM_CELL_HIGH;
+    }
+    if (out->max_cell_cv - out->min_cell_cv > cfg->imbalance_cv) {
+        out->alarms |= PACK_ALARM_IMBALANCE;
+    }
+    if (rec->temp > (int16_t)cfg->temp_high_dc) {
+        out->alarms |= PACK_ALARM_TEMP_HIGH;
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * @file pack_metrics.h
+ * @brief Pack level values derived from a scan, and alarm evaluation.
+ */
+
+#ifndef PACK_METRICS_H
+#define PACK_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+
+#include "main_voltage.h"
+
+struct scan_record;
+struct app_config;
+
+/** @brief Alarm bits of struct pack_metrics. */
+enum pack_alarm {
+    PACK_ALARM_CELL_LOW  = BIT(0), ///< A battery is below the cell_low threshold
+    PACK_ALARM_CELL_HIGH = BIT(1), ///< A battery is above the cell_high threshold
+    PACK_ALARM_IMBALANCE = BIT(2), ///< Highest minus lowest battery exceeds the imbalance threshold
+    PACK_ALARM_TEMP_HIGH = BIT(3), ///< Temperature above the temp_high threshold
+};
+
+/**
+ * @brief Values derived from a scan.
+ */
+struct pack_metrics {
+    uint16_t cell_cv[NUMBER_OF_BATTERIES_IN_SERIES]; ///< Battery voltages in cV
+    uint16_t pack_cv;      ///< Pack voltage in cV
+    uint16_t min_cell_cv;  ///< Lowest battery voltage in cV
+    uint16_t max_cell_cv;  ///< Highest battery voltage in cV
+    uint16_t avg_cell_cv;  ///< Average battery voltage in cV
+    uint8_t min_cell;      ///< Index of the lowest battery
+    uint8_t max_cell;      ///< Index of the highest battery
+    uint16_t alarms;       ///< Active alarms, see enum pack_alarm
+};
+
+/**
+ * @brief Derive the pack metrics of a scan and evaluate the alarms.
+ *
+ * @param rec Scan record.
+ * @param cfg Configuration holding the alarm thresholds.
+ * @param out Destination.
+ */
+void pack_metrics_compute(const struct scan_record *rec, const struct app_config *cfg,
+                          struct pack_metrics *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PACK_METRICS_H */
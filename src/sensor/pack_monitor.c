@@ -0,0 +1,475 @@
+/**
+ * @file pack_monitor.c
+ * @brief Sensor driver for the battery pack taps ("promicro,pack-monitor").
+ *
+ * A scan switches the multiplexers through every tap and converts each one, so it blocks for
+ * the settling times and conversions. Submissions therefore never scan in the caller: one-shot
+ * reads and stream periods are handed to the RTIO work queue, where the scan is written into
+ * the buffer of the submission and completed. A stream keeps its buffer across periods until
+ * the batch is full, then completes it and gets the next buffer when RTIO resubmits the
+ * multishot submission.
+ */
+
+#define DT_DRV_COMPAT promicro_pack_monitor
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/rtio/rtio.h>
+#include <zephyr/rtio/work.h>
+#include <zephyr/sys/printk.h>
+
+#include "pack_monitor.h"
+
+#define MUX_SELECT_LINES 4
+#define NO_TRIGGER       0xFF
+
+struct pack_monitor_config {
+    struct adc_dt_spec adc;
+    struct gpio_dt_spec mux[2][MUX_SELECT_LINES];
+    uint8_t channels_per_mux;
+    uint16_t settle_us;
+    uint32_t r1_ohm;
+    uint32_t r2_ohm;
+    uint32_t stream_period_ms;
+    uint16_t batch_frames;
+};
+
+struct pack_monitor_data {
+    const struct device *dev;
+    struct k_mutex scan_lock;       ///< Serializes the scans of reads and streams
+    struct k_mutex stream_lock;     ///< Serializes the stream periods, protects the batch
+
+    // Settings, changed with sensor_attr_set()
+    uint32_t r1_ohm;
+    uint32_t r2_ohm;
+    uint16_t settle_us;
+    uint16_t batch_frames;
+    uint32_t period_ns;
+
+    // Stream state
+    struct k_spinlock lock;
+    struct rtio_iodev_sqe *stream_sqe;  ///< Submission the next scans are written to, lock
+    uint8_t *batch_buf;                 ///< Buffer of the batch in progress, stream_lock
+    uint16_t batch_cap;                 ///< Scans that fit in batch_buf, stream_lock
+    struct k_timer stream_timer;
+    struct k_work tick_work;
+
+    // Last scan of the legacy fetch API
+    uint16_t last[PACK_MONITOR_MAX_CHANNELS];
+};
+
+static uint8_t channel_count(const struct device *dev)
+{
+    const struct pack_monitor_config *cfg = dev->config;
+
+    return 2 * cfg->channels_per_mux;
+}
+
+/**
+ * @brief Scan every tap.
+ *
+ * @param dev The pack monitor.
+ * @param raw Destination for the raw ADC count of each tap.
+ * @return 0 on success, or a negative error code.
+ */
+static int scan(const struct device *dev, uint16_t *raw)
+{
+    const struct pack_monitor_config *cfg = dev->config;
+    struct pack_monitor_data *data = dev->data;
+    int16_t sample;
+    struct adc_sequence sequence = {
+        .buffer = &sample,
+        .buffer_size = sizeof(sample),
+    };
+    int err = adc_sequence_init_dt(&cfg->adc, &sequence);
+
+    if (err) {
+        return err;
+    }
+
+    k_mutex_lock(&data->scan_lock, K_FOREVER);
+
+    for (uint8_t mux = 0; mux < 2 && !err; mux++) {
+        for (uint8_t input = 0; input < cfg->channels_per_mux; input++) {
+            for (int line = 0; line < MUX_SELECT_LINES; line++) {
+                gpio_pin_set_dt(&cfg->mux[mux][line], (input >> line) & 1);
+            }
+            k_sleep(K_USEC(data->settle_us));  // Allow settling
+
+            err = adc_read_dt(&cfg->adc, &sequence);
+            if (err) {
+                break;
+            }
+            raw[mux * cfg->channels_per_mux + input] = MAX(sample, 0);
+        }
+    }
+
+    k_mutex_unlock(&data->scan_lock);
+    return err;
+}
+
+/**
+ * @brief Tap voltage of one ADC count in nV, with the current divider.
+ */
+static uint32_t nv_per_lsb(const struct device *dev)
+{
+    const struct pack_monitor_config *cfg = dev->config;
+    struct pack_monitor_data *data = dev->data;
+    int32_t full_scale_mv = BIT(cfg->adc.resolution);
+
+    adc_raw_to_millivolts_dt(&cfg->adc, &full_scale_mv);
+
+    return (uint64_t)full_scale_mv * NSEC_PER_MSEC * (data->r1_ohm + data->r2_ohm) /
+           data->r2_ohm / BIT(cfg->adc.resolution);
+}
+
+static void header_init(const struct device *dev, struct pack_monitor_header *hdr,
+                        uint32_t period_ns, uint8_t trigger)
+{
+    hdr->timestamp_ns = k_ticks_to_ns_floor64(k_uptime_ticks());
+    hdr->period_ns = period_ns;
+    hdr->nv_per_lsb = nv_per_lsb(dev);
+    hdr->frame_count = 0;
+    hdr->channels = channel_count(dev);
+    hdr->trigger = trigger;
+}
+
+/**
+ * @brief Serve a one-shot read, in the RTIO work queue.
+ */
+static void read_handler(struct rtio_iodev_sqe *iodev_sqe)
+{
+    const struct sensor_read_config *read_cfg = iodev_sqe->sqe.iodev->data;
+    const struct device *dev = read_cfg->sensor;
+    uint32_t size = PACK_MONITOR_BUF_SIZE(channel_count(dev), 1);
+    struct pack_monitor_header *hdr;
+    uint8_t *buf;
+    uint32_t buf_len;
+    int err = rtio_sqe_rx_buf(iodev_sqe, size, size, &buf, &buf_len);
+
+    if (err) {
+        rtio_iodev_sqe_err(iodev_sqe, err);
+        return;
+    }
+
+    hdr = (struct pack_monitor_header *)buf;
+    header_init(dev, hdr, 0, NO_TRIGGER);
+
+    err = scan(dev, (uint16_t *)(buf + sizeof(*hdr)));
+    if (err) {
+        rtio_iodev_sqe_err(iodev_sqe, err);
+        return;
+    }
+    hdr->frame_count = 1;
+
+    rtio_iodev_sqe_ok(iodev_sqe, 0);
+}
+
+/**
+ * @brief Clear the stream and fail its submission. Must be called with stream_lock held.
+ */
+static void stream_fail(struct pack_monitor_data *data, struct rtio_iodev_sqe *iodev_sqe, int err)
+{
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    data->stream_sqe = NULL;
+    k_spin_unlock(&data->lock, key);
+    data->batch_buf = NULL;
+    rtio_iodev_sqe_err(iodev_sqe, err);
+}
+
+/**
+ * @brief Scan one stream period into the batch in progress, in the RTIO work queue.
+ */
+static void stream_handler(struct rtio_iodev_sqe *iodev_sqe)
+{
+    const struct sensor_read_config *read_cfg = iodev_sqe->sqe.iodev->data;
+    const struct device *dev = read_cfg->sensor;
+    struct pack_monitor_data *data = dev->data;
+    uint8_t channels = channel_count(dev);
+    struct pack_monitor_header *hdr;
+    k_spinlock_key_t key;
+    int err;
+
+    k_mutex_lock(&data->stream_lock, K_FOREVER);
+
+    // The submission completed or failed while this period was queued
+    if (data->stream_sqe != iodev_sqe) {
+        goto out;
+    }
+
+    if (iodev_sqe->sqe.flags & RTIO_SQE_CANCELED) {
+        stream_fail(data, iodev_sqe, -ECANCELED);
+        goto out;
+    }
+
+    if (data->batch_buf == NULL) {
+        uint8_t trigger = read_cfg->triggers[0].trigger;
+        uint16_t frames = trigger == SENSOR_TRIG_FIFO_WATERMARK ? data->batch_frames : 1;
+        uint32_t buf_len;
+
+        err = rtio_sqe_rx_buf(iodev_sqe, PACK_MONITOR_BUF_SIZE(channels, 1),
+                              PACK_MONITOR_BUF_SIZE(channels, frames), &data->batch_buf,
+                              &buf_len);
+        if (err) {
+            stream_fail(data, iodev_sqe, err);
+            goto out;
+        }
+        data->batch_cap = MIN(frames, (buf_len - sizeof(*hdr)) / (channels * sizeof(uint16_t)));
+        header_init(dev, (struct pack_monitor_header *)data->batch_buf, data->period_ns,
+                    trigger);
+    }
+
+    hdr = (struct pack_monitor_header *)data->batch_buf;
+    err = scan(dev, (uint16_t *)pack_monitor_frame(data->batch_buf, hdr->frame_count));
+    if (err) {
+        stream_fail(data, iodev_sqe, err);
+        goto out;
+    }
+
+    if (++hdr->frame_count == data->batch_cap) {
+        // A multishot submission is resubmitted from the completion, clear it first
+        key = k_spin_lock(&data->lock);
+        data->stream_sqe = NULL;
+        k_spin_unlock(&data->lock, key);
+        data->batch_buf = NULL;
+        rtio_iodev_sqe_ok(iodev_sqe, 0);
+    }
+
+out:
+    k_mutex_unlock(&data->stream_lock);
+}
+
+/**
+ * @brief Hand the stream period to the RTIO work queue, or stop when nobody streams.
+ */
+static void tick_work_handler(struct k_work *work)
+{
+    struct pack_monitor_data *data = CONTAINER_OF(work, struct pack_monitor_data, tick_work);
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+    struct rtio_iodev_sqe *iodev_sqe = data->stream_sqe;
+    struct rtio_work_req *req;
+
+    k_spin_unlock(&data->lock, key);
+
+    if (iodev_sqe == NULL) {
+        k_timer_stop(&data->stream_timer);
+        return;
+    }
+
+    req = rtio_work_req_alloc();
+    if (req == NULL) {
+        return;  // Work queue busy, skip this period
+    }
+    rtio_work_req_submit(req, iodev_sqe, stream_handler);
+}
+
+static void stream_timer_expiry(struct k_timer *timer)
+{
+    struct pack_monitor_data *data = CONTAINER_OF(timer, struct pack_monitor_data, stream_timer);
+
+    k_work_submit(&data->tick_work);
+}
+
+static void pack_monitor_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
+{
+    const struct sensor_read_config *read_cfg = iodev_sqe->sqe.iodev->data;
+    struct pack_monitor_data *data = dev->data;
+    struct rtio_work_req *req;
+    k_spinlock_key_t key;
+    bool running;
+
+    if (!read_cfg->is_streaming) {
+        req = rtio_work_req_alloc();
+        if (req == NULL) {
+            rtio_iodev_sqe_err(iodev_sqe, -ENOMEM);
+            return;
+        }
+        rtio_work_req_submit(req, iodev_sqe, read_handler);
+        return;
+    }
+
+    if (read_cfg->count == 0 ||
+        (read_cfg->triggers[0].trigger != SENSOR_TRIG_DATA_READY &&
+         read_cfg->triggers[0].trigger != SENSOR_TRIG_FIFO_WATERMARK)) {
+        rtio_iodev_sqe_err(iodev_sqe, -ENOTSUP);
+        return;
+    }
+
+    key = k_spin_lock(&data->lock);
+    if (data->stream_sqe != NULL && data->stream_sqe != iodev_sqe) {
+        k_spin_unlock(&data->lock, key);
+        rtio_iodev_sqe_err(iodev_sqe, -EBUSY);  // One stream at a time
+        return;
+    }
+    data->stream_sqe = iodev_sqe;
+    k_spin_unlock(&data->lock, key);
+
+    // Multishot resubmissions keep the running timer, so the period does not drift
+    running = k_timer_remaining_ticks(&data->stream_timer) > 0;
+    if (!running) {
+        k_timeout_t period = K_NSEC(data->period_ns);
+
+        k_timer_start(&data->stream_timer, period, period);
+    }
+}
+
+static int pack_monitor_attr_set(const struct device *dev, enum sensor_channel chan,
+                                 enum sensor_attribute attr, const struct sensor_value *val)
+{
+    struct pack_monitor_data *data = dev->data;
+    int64_t micro_hz;
+
+    switch ((int)attr) {
+    case SENSOR_ATTR_SAMPLING_FREQUENCY:
+        micro_hz = sensor_value_to_micro(val);
+        if (micro_hz <= 0) {
+            return -EINVAL;
+        }
+        data->period_ns = MIN((int64_t)NSEC_PER_SEC * USEC_PER_SEC / micro_hz, UINT32_MAX);
+        return 0;
+    case PACK_MONITOR_ATTR_DIVIDER_R1:
+        if (val->val1 <= 0) {
+            return -EINVAL;
+        }
+        data->r1_ohm = val->val1;
+        return 0;
+    case PACK_MONITOR_ATTR_DIVIDER_R2:
+        if (val->val1 <= 0) {
+            return -EINVAL;
+        }
+        data->r2_ohm = val->val1;
+        return 0;
+    case PACK_MONITOR_ATTR_SETTLE_US:
+        if (val->val1 < 0 || val->val1 > UINT16_MAX) {
+            return -EINVAL;
+        }
+        data->settle_us = val->val1;
+        return 0;
+    case PACK_MONITOR_ATTR_BATCH:
+        if (val->val1 < 1 || val->val1 > UINT16_MAX) {
+            return -EINVAL;
+        }
+        data->batch_frames = val->val1;
+        return 0;
+    default:
+        return -ENOTSUP;
+    }
+}
+
+static int pack_monitor_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+    struct pack_monitor_data *data = dev->data;
+
+    if (chan != SENSOR_CHAN_ALL && chan != SENSOR_CHAN_VOLTAGE) {
+        return -ENOTSUP;
+    }
+
+    return scan(dev, data->last);
+}
+
+/**
+ * @brief Get the taps of the last fetched scan, one sensor_value per tap.
+ */
+static int pack_monitor_channel_get(const struct device *dev, enum sensor_channel chan,
+                                    struct sensor_value *val)
+{
+    struct pack_monitor_data *data = dev->data;
+    uint64_t nv = nv_per_lsb(dev);
+
+    if (chan != SENSOR_CHAN_VOLTAGE) {
+        return -ENOTSUP;
+    }
+
+    for (uint8_t i = 0; i < channel_count(dev); i++) {
+        sensor_value_from_micro(&val[i], data->last[i] * nv / NSEC_PER_USEC);
+    }
+
+    return 0;
+}
+
+static const struct sensor_driver_api pack_monitor_api = {
+    .attr_set = pack_monitor_attr_set,
+    .sample_fetch = pack_monitor_sample_fetch,
+    .channel_get = pack_monitor_channel_get,
+    .submit = pack_monitor_submit,
+    .get_decoder = pack_monitor_get_decoder,
+};
+
+static int pack_monitor_init(const struct device *dev)
+{
+    const struct pack_monitor_config *cfg = dev->config;
+    struct pack_monitor_data *data = dev->data;
+    int err;
+
+    if (!adc_is_ready_dt(&cfg->adc)) {
+        printk("Pack monitor ADC not ready\n");
+        return -ENODEV;
+    }
+
+    err = adc_channel_setup_dt(&cfg->adc);
+    if (err) {
+        printk("Failed to set up the pack monitor ADC channel (err %d)\n", err);
+        return err;
+    }
+
+    for (int mux = 0; mux < 2; mux++) {
+        for (int line = 0; line < MUX_SELECT_LINES; line++) {
+            if (!gpio_is_ready_dt(&cfg->mux[mux][line])) {
+                return -ENODEV;
+            }
+            err = gpio_pin_configure_dt(&cfg->mux[mux][line], GPIO_OUTPUT_INACTIVE);
+            if (err) {
+                return err;
+            }
+        }
+    }
+
+    data->dev = dev;
+    data->r1_ohm = cfg->r1_ohm;
+    data->r2_ohm = cfg->r2_ohm;
+    data->settle_us = cfg->settle_us;
+    data->batch_frames = cfg->batch_frames;
+    data->period_ns = cfg->stream_period_ms * NSEC_PER_MSEC;
+    k_mutex_init(&data->scan_lock);
+    k_mutex_init(&data->stream_lock);
+    k_timer_init(&data->stream_timer, stream_timer_expiry, NULL);
+    k_work_init(&data->tick_work, tick_work_handler);
+
+    return 0;
+}
+
+#define MUX_LINES(inst, prop)                                   \
+    {                                                           \
+        GPIO_DT_SPEC_INST_GET_BY_IDX(inst, prop, 0),            \
+        GPIO_DT_SPEC_INST_GET_BY_IDX(inst, prop, 1),            \
+        GPIO_DT_SPEC_INST_GET_BY_IDX(inst, prop, 2),            \
+        GPIO_DT_SPEC_INST_GET_BY_IDX(inst, prop, 3),            \
+    }
+
+#define PACK_MONITOR_DEFINE(inst)                                                   \
+    BUILD_ASSERT(2 * DT_INST_PROP(inst, channels_per_mux) <= PACK_MONITOR_MAX_CHANNELS); \
+                                                                                    \
+    static const struct pack_monitor_config pack_monitor_config_##inst = {          \
+        .adc = ADC_DT_SPEC_INST_GET(inst),                                          \
+        .mux = { MUX_LINES(inst, mux_a_gpios), MUX_LINES(inst, mux_b_gpios) },      \
+        .channels_per_mux = DT_INST_PROP(inst, channels_per_mux),                   \
+        .settle_us = DT_INST_PROP(inst, settle_us),                                 \
+        .r1_ohm = DT_INST_PROP(inst, divider_r1_ohms),                              \
+        .r2_ohm = DT_INST_PROP(inst, divider_r2_ohms),                              \
+        .stream_period_ms = DT_INST_PROP(inst, stream_period_ms),                   \
+        .batch_frames = DT_INST_PROP(inst, batch_frames),                           \
+    };                                                                              \
+    static struct pack_monitor_data pack_monitor_data_##inst;                       \
+                                                                                    \
+    SENSOR_DEVICE_DT_INST_DEFINE(inst, pack_monitor_init, NULL,                     \
+                                 &pack_monitor_data_##inst,                         \
+                                 &pack_monitor_config_##inst, POST_KERNEL,          \
+                                 CONFIG_SENSOR_INIT_PRIORITY, &pack_monitor_api);
+
+DT_INST_FOREACH_STATUS_OKAY(PACK_MONITOR_DEFINE)
@@ -0,0 +1,83 @@
+/**
+ * @file pack_monitor.h
+ * @brief Sensor driver for the battery pack taps ("promicro,pack-monitor").
+ *
+ * The driver scans every tap through the multiplexers and the ADC, and serves the scans through
+ * the Zephyr sensor API:
+ * - sensor_read() / sensor_read_async_mempool(): one scan per read,
+ * - sensor_stream(): a scan every stream period. A stream triggered on SENSOR_TRIG_DATA_READY
+ *   completes every scan, one triggered on SENSOR_TRIG_FIFO_WATERMARK completes the scans in
+ *   batches of PACK_MONITOR_ATTR_BATCH (or as many as fit in the buffer).
+ *
+ * The scans are written straight into the RTIO buffer as raw ADC counts, in the layout below.
+ * The decoder (sensor_get_decoder()) converts them to volts, one SENSOR_CHAN_VOLTAGE channel
+ * per tap; consumers that know the layout can use the counts directly.
+ */
+
+#ifndef PACK_MONITOR_H
+#define PACK_MONITOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/drivers/sensor.h>
+
+/** @brief Most taps a pack monitor can scan (two multiplexers of 16 inputs). */
+#define PACK_MONITOR_MAX_CHANNELS 32
+
+/** @brief Driver specific attributes, set with sensor_attr_set() on SENSOR_CHAN_ALL. */
+enum pack_monitor_attribute {
+    /** Upper resistor of the voltage divider in ohms, used by the decoder */
+    PACK_MONITOR_ATTR_DIVIDER_R1 = SENSOR_ATTR_PRIV_START,
+    /** Lower resistor of the voltage divider in ohms, used by the decoder */
+    PACK_MONITOR_ATTR_DIVIDER_R2,
+    /** Multiplexer settling time in microseconds */
+    PACK_MONITOR_ATTR_SETTLE_US,
+    /** Scans completed together by a SENSOR_TRIG_FIFO_WATERMARK stream */
+    PACK_MONITOR_ATTR_BATCH,
+};
+
+/**
+ * @brief Header of a buffer filled by the driver, followed by frame_count frames of
+ *        channels uint16_t raw ADC counts each.
+ */
+struct pack_monitor_header {
+    uint64_t timestamp_ns;  ///< Uptime of the first scan in ns
+    uint32_t period_ns;     ///< Time between two scans of the buffer, 0 for a single scan
+    uint32_t nv_per_lsb;    ///< Tap voltage of one ADC count in nV, divider included
+    uint16_t frame_count;   ///< Scans in the buffer
+    uint8_t channels;       ///< Taps per scan
+    uint8_t trigger;        ///< Stream trigger (enum sensor_trigger_type), 0xFF for a read
+} __packed;
+
+/** @brief Size of a buffer holding a number of scans of a number of taps. */
+#define PACK_MONITOR_BUF_SIZE(channels, frames) \
+    (sizeof(struct pack_monitor_header) + (frames) * (channels) * sizeof(uint16_t))
+
+/**
+ * @brief Get the raw ADC counts of a scan in a buffer filled by the driver.
+ *
+ * @param buf The buffer.
+ * @param frame Index of the scan, below the frame count of the header.
+ * @return The channels counts of the scan.
+ */
+static inline const uint16_t *pack_monitor_frame(const uint8_t *buf, uint16_t frame)
+{
+    const struct pack_monitor_header *hdr = (const struct pack_monitor_header *)buf;
+
+    return (const uint16_t *)(buf + sizeof(*hdr)) + (size_t)frame * hdr->channels;
+}
+
+/**
+ * @brief Get the decoder of the driver, see sensor_get_decoder().
+ */
+int pack_monitor_get_decoder(const struct device *dev, const struct sensor_decoder_api **decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PACK_MONITOR_H */
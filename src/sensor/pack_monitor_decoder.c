@@ -0,0 +1,98 @@
+/**
+ * @file pack_monitor_decoder.c
+ * @brief Decoder of the buffers filled by the pack monitor driver.
+ *
+ * Each tap decodes as SENSOR_CHAN_VOLTAGE with the tap index as channel index, in volts as
+ * q31 with a fixed shift. The scale travels in the buffer header, so a buffer decodes the same
+ * after the divider attributes change.
+ */
+
+#define DT_DRV_COMPAT promicro_pack_monitor
+
+#include <errno.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/drivers/sensor_data_types.h>
+#include <zephyr/sys/util.h>
+
+#include "pack_monitor.h"
+
+#define VOLTAGE_SHIFT 7  ///< q31 range of +/-128 V
+
+static int decoder_get_frame_count(const uint8_t *buffer, struct sensor_chan_spec chan_spec,
+                                   uint16_t *frame_count)
+{
+    const struct pack_monitor_header *hdr = (const struct pack_monitor_header *)buffer;
+
+    if (chan_spec.chan_type != SENSOR_CHAN_VOLTAGE || chan_spec.chan_idx >= hdr->channels) {
+        return -ENOTSUP;
+    }
+
+    *frame_count = hdr->frame_count;
+    return 0;
+}
+
+static int decoder_get_size_info(struct sensor_chan_spec chan_spec, size_t *base_size,
+                                 size_t *frame_size)
+{
+    if (chan_spec.chan_type != SENSOR_CHAN_VOLTAGE) {
+        return -ENOTSUP;
+    }
+
+    *base_size = sizeof(struct sensor_q31_data);
+    *frame_size = sizeof(struct sensor_q31_sample_data);
+    return 0;
+}
+
+static int decoder_decode(const uint8_t *buffer, struct sensor_chan_spec chan_spec,
+                          uint32_t *fit, uint16_t max_count, void *data_out)
+{
+    const struct pack_monitor_header *hdr = (const struct pack_monitor_header *)buffer;
+    struct sensor_q31_data *out = data_out;
+    uint16_t count = 0;
+
+    if (chan_spec.chan_type != SENSOR_CHAN_VOLTAGE || chan_spec.chan_idx >= hdr->channels) {
+        return -ENOTSUP;
+    }
+
+    if (*fit >= hdr->frame_count) {
+        return 0;
+    }
+
+    out->header.base_timestamp_ns = hdr->timestamp_ns + (uint64_t)*fit * hdr->period_ns;
+    out->shift = VOLTAGE_SHIFT;
+
+    while (count < max_count && *fit < hdr->frame_count) {
+        uint16_t raw = pack_monitor_frame(buffer, *fit)[chan_spec.chan_idx];
+        int64_t nv = (int64_t)raw * hdr->nv_per_lsb;
+
+        out->readings[count].timestamp_delta = count * hdr->period_ns;
+        out->readings[count].value = (q31_t)(nv * BIT64(31 - VOLTAGE_SHIFT) / NSEC_PER_SEC);
+        count++;
+        (*fit)++;
+    }
+
+    out->header.reading_count = count;
+    return count;
+}
+
+static bool decoder_has_trigger(const uint8_t *buffer, enum sensor_trigger_type trigger)
+{
+    const struct pack_monitor_header *hdr = (const struct pack_monitor_header *)buffer;
+
+    return hdr->trigger == trigger;
+}
+
+SENSOR_DECODER_API_DT_DEFINE() = {
+    .get_frame_count = decoder_get_frame_count,
+    .get_size_info = decoder_get_size_info,
+    .decode = decoder_decode,
+    .has_trigger = decoder_has_trigger,
+};
+
+int pack_monitor_get_decoder(const struct device *dev, const struct sensor_decoder_api **decoder)
+{
+    ARG_UNUSED(dev);
+    *decoder = &SENSOR_DECODER_NAME();
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file radio_quiet.c
+ * @brief ADC conversions in the idle time between radio events.
+ *
+ * The notification interrupt fires before and after every radio event, so the number of
+ * notifications is odd while the radio is active. A conversion records that count before it
+ * starts and compares it afterwards: any change means a radio event started (or its 420 µs
+ * lead-in did) during the conversion.
+ *
+ * The noise is the absolute deviation of each conversion from a slow moving average of its
+ * channel, in ADC counts. Battery voltages move much slower than the scan rate, so the
+ * deviation is dominated by the conversion noise.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/irq.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <mpsl_radio_notification.h>
+
+#include "radio_quiet.h"
+#include "main_voltage.h"
+
+#define NOTIFY_IRQn   SWI1_EGU1_IRQn   ///< Free software interrupt, not used by MPSL
+#define MAX_EVENT     K_MSEC(20)       ///< Longest radio event waited for
+#define AVG_SHIFT     4                ///< Fixed point of the channel averages
+#define AVG_WEIGHT    8                ///< Time constant of the channel averages, in scans
+
+/**
+ * @brief Statistics of one mode (placement on or off).
+ */
+struct quiet_stats {
+    uint32_t scans;
+    uint32_t conversions;   ///< Conversions including the repeated ones
+    uint32_t overlaps;      ///< Conversions that overlapped a radio event
+    uint32_t waits;         ///< Conversions delayed until the end of a radio event
+    uint32_t resyncs;       ///< Waits that timed out, the radio state was lost
+    uint64_t wait_us;
+    uint32_t samples;       ///< Conversions accounted in the noise
+    uint64_t deviation;     ///< Sum of the absolute deviations, fixed point AVG_SHIFT
+};
+
+static atomic_t edges;
+static atomic_t armed;                  ///< A wait is pending and its signal not raised yet
+static struct k_poll_signal *wait_signal;
+static bool waiting;                    ///< A wait was armed, accounted by the next begin
+static bool wait_timeout;               ///< The wait ended on MAX_EVENT, not on the idle edge
+static int64_t wait_start;
+static bool enabled = true;
+static struct quiet_stats stats[2];   ///< Indexed by enabled
+static int32_t avg[TOTAL_CHANNELS];
+static uint32_t avg_valid;
+
+BUILD_ASSERT(TOTAL_CHANNELS <= 32, "avg_valid is a 32-bit mask");
+
+/**
+ * @brief End the pending wait, once: by the idle edge or by the timer, whichever comes first.
+ */
+static void wait_done(bool timeout)
+{
+    if (atomic_cas(&armed, 1, 0)) {
+        wait_timeout = timeout;
+        k_poll_signal_raise(wait_signal, 0);
+    }
+}
+
+static void wait_expiry(struct k_timer *timer)
+{
+    wait_done(true);
+}
+
+static K_TIMER_DEFINE(wait_timer, wait_expiry, NULL);
+
+static void notify_isr(const void *arg)
+{
+    // Even count after this edge: the radio event is over
+    if (atomic_inc(&edges) & 1) {
+        wait_done(false);
+    }
+}
+
+int radio_quiet_init(void)
+{
+    int err;
+
+    IRQ_CONNECT(NOTIFY_IRQn, IRQ_PRIO_LOWEST, notify_isr, NULL, 0);
+    irq_enable(NOTIFY_IRQn);
+
+    err = mpsl_radio_notification_cfg_set(MPSL_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH,
+                                          MPSL_RADIO_NOTIFICATION_DISTANCE_420US, NOTIFY_IRQn);
+    if (err) {
+        printk("Radio notification failed (err %d)\n", err);
+        return err;
+    }
+
+    return 0;
+}
+
+void radio_quiet_set_enabled(bool on)
+{
+    enabled = on;
+}
+
+int radio_quiet_begin(struct k_poll_signal *signal, uint32_t *token)
+{
+    struct quiet_stats *s = &stats[enabled];
+    atomic_val_t count;
+
+    if (waiting) {
+        // Called again after the signal of the wait
+        k_timer_stop(&wait_timer);
+        atomic_clear(&armed);
+        waiting = false;
+        if (wait_timeout && (atomic_get(&edges) & 1)) {
+            // An edge was missed (e.g. notification enabled during an event), resynchronize
+            atomic_inc(&edges);
+            s->resyncs++;
+        }
+        s->waits++;
+        s->wait_us += k_ticks_to_us_floor64(k_uptime_ticks() - wait_start);
+    }
+
+    count = atomic_get(&edges);
+    if (!enabled || !(count & 1)) {
+        *token = count;
+        return 0;
+    }
+
+    wait_signal = signal;
+    wait_timeout = false;
+    wait_start = k_uptime_ticks();
+    waiting = true;
+    atomic_set(&armed, 1);
+    k_timer_start(&wait_timer, MAX_EVENT, K_NO_WAIT);
+
+    // The event may have ended before the wait was armed
+    if (atomic_get(&edges) != count) {
+        wait_done(false);
+    }
+
+    return -EBUSY;
+}
+
+bool radio_quiet_end(uint32_t token)
+{
+    struct quiet_stats *s = &stats[enabled];
+
+    s->conversions++;
+    if ((uint32_t)atomic_get(&edges) == token && !(token & 1)) {
+        return true;
+    }
+
+    s->overlaps++;
+    return !enabled;
+}
+
+void radio_quiet_sample(uint8_t channel, uint32_t raw)
+{
+    struct quiet_stats *s = &stats[enabled];
+    int32_t value = (int32_t)raw << AVG_SHIFT;
+    int32_t delta;
+
+    if (channel >= TOTAL_CHANNELS) {
+        return;
+    }
+
+    if (!(avg_valid & BIT(channel))) {
+        avg[channel] = value;
+        avg_valid |= BIT(channel);
+        return;
+    }
+
+    delta = value - avg[channel];
+    avg[channel] += delta / AVG_WEIGHT;
+    s->deviation += abs(delta);
+    s->samples++;
+}
+
+void radio_quiet_scan_done(void)
+{
+    stats[enabled].scans++;
+}
+
+int radio_quiet_format_status(char *buf, size_t buf_size)
+{
+    size_t offset = 0;
+
+    for (int mode = 1; mode >= 0; mode--) {
+        const struct quiet_stats *s = &stats[mode];
+        // Mean absolute deviation in hundredths of a count
+        uint32_t noise = s->samples ?
+            (uint32_t)((s->deviation * 100) / ((uint64_t)s->samples << AVG_SHIFT)) : 0;
+        int written;
+
+        written = snprintf(buf + offset, buf_size - offset,
+                           "quiet %s%s: scans %u overlap %u/%u wait %u (%u us) resync %u "
+                           "noise %u.%02u\n",
+                           mode ? "on" : "off", mode == enabled ? "*" : "", s->scans,
+                           s->overlaps, s->conversions, s->waits, (uint32_t)s->wait_us,
+                           s->resyncs, noise / 100, noise % 100);
+        if (written < 0 || (size_t)written >= buf_size - offset) {
+            return -ENOMEM;
+        }
+        offset += written;
+    }
+
+    return offset;
+}
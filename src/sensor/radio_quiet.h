@@ -0,0 +1,84 @@
+/**
+ * @file radio_quiet.h
+ * @brief Placement of the ADC conversions outside of the radio events.
+ *
+ * The MPSL radio notification signals the start (420 µs ahead) and
+ * the end of every radio event. A conversion only starts while the radio is idle, and is
+ * repeated if a radio event began before it completed. Every conversion is also compared to a
+ * slow per-channel average to estimate the noise, with the placement on and off, so the gain
+ * can be measured on the same board.
+ */
+
+#ifndef RADIO_QUIET_H
+#define RADIO_QUIET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct k_poll_signal;
+
+/**
+ * @brief Enable the radio notification.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int radio_quiet_init(void);
+
+/**
+ * @brief Enable or disable the placement of the conversions. The statistics are kept apart.
+ */
+void radio_quiet_set_enabled(bool enabled);
+
+/**
+ * @brief Check, if enabled, that the radio is idle before a conversion. Does not block.
+ *
+ * While a radio event is in progress, the signal is raised when it ends, or after the longest
+ * radio event if its end was missed. Call radio_quiet_begin() again then.
+ *
+ * @param signal Signal raised at the end of the wait.
+ * @param token Destination for the token to pass to radio_quiet_end().
+ * @return 0 if the conversion can start, -EBUSY if the caller must wait for the signal.
+ */
+int radio_quiet_begin(struct k_poll_signal *signal, uint32_t *token);
+
+/**
+ * @brief Check that a conversion did not overlap a radio event.
+ *
+ * @param token Value returned by radio_quiet_begin() before the conversion.
+ * @return False if the conversion overlapped a radio event and must be repeated. Always true
+ *         when the placement is disabled, the overlap is only counted.
+ */
+bool radio_quiet_end(uint32_t token);
+
+/**
+ * @brief Account a conversion in the noise statistics.
+ *
+ * @param channel Channel index, below TOTAL_CHANNELS.
+ * @param raw Raw ADC value.
+ */
+void radio_quiet_sample(uint8_t channel, uint32_t raw);
+
+/**
+ * @brief Account a complete scan.
+ */
+void radio_quiet_scan_done(void);
+
+/**
+ * @brief Print the statistics with the placement on and off into a buffer.
+ *
+ * @param buf Destination buffer.
+ * @param buf_size Size of the destination buffer.
+ * @return Number of characters written, or a negative error code.
+ */
+int radio_quiet_format_status(char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RADIO_QUIET_H */
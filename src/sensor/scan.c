@@ -0,0 +1,122 @@
+/**
+ * @file scan.c
+ * @brief Latest scan snapshot shared between the sampling loop and the data consumers.
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+
+#include "scan.h"
+#include "on_demand.h"
+#include "../bluetooth/bluetooth.h"
+#include "../bluetooth/service.h"
+#include "../bluetooth/mesh_sensor.h"
+#include "../bluetooth/battery_level.h"
+#include "../bluetooth/ess.h"
+#include "../bluetooth/adv_sched.h"
+#include "../bluetooth/notify_sched.h"
+#include "../bluetooth/compact_scan.h"
+#include "../bluetooth/long_range.h"
+#include "../application/app_config.h"
+#include "../output/usb_export.h"
+#include "../output/uart_stream.h"
+#include "../output/modbus_server.h"
+#include "../output/can_output.h"
+
+static struct k_spinlock lock;
+static struct scan_record latest;
+static bool have_latest;
+static uint16_t next_seq;
+
+/**
+ * @brief Publish the compact form of a scan: notification and Coded PHY advertising data.
+ */
+static void publish_compact(const struct scan_record *rec)
+{
+    struct app_config cfg;
+    struct pack_metrics m;
+    struct compact_scan compact;
+
+    app_config_read(&cfg);
+    pack_metrics_compute(rec, &cfg, &m);
+    compact_scan_encode(rec, &m, &compact);
+
+    bt_send_compact_scan(&compact);
+
+    if (IS_ENABLED(CONFIG_APP_CODED_PHY)) {
+        long_range_update(&compact);
+    }
+}
+
+void scan_publish(struct scan_record *rec)
+{
+    k_spinlock_key_t key;
+
+    rec->seq = next_seq++;
+
+    key = k_spin_lock(&lock);
+    latest = *rec;
+    have_latest = true;
+    k_spin_unlock(&lock, key);
+
+    if (IS_ENABLED(CONFIG_APP_ON_DEMAND)) {
+        on_demand_scan(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_NOTIFY_SCHED)) {
+        notify_sched_scan(rec);
+    } else {
+        bt_send_scan(rec);
+    }
+    publish_compact(rec);
+
+    if (IS_ENABLED(CONFIG_APP_BAS)) {
+        battery_level_update(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_ESS)) {
+        ess_update_temperature(rec->temp);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_ADV_TELEMETRY)) {
+        bluetooth_update_telemetry(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_ADV_SCHED)) {
+        adv_sched_scan(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_USB_EXPORT)) {
+        usb_export_scan(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_UART_STREAM)) {
+        uart_stream_scan(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_MODBUS)) {
+        modbus_server_update(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_CAN_OUTPUT)) {
+        can_output_scan(rec);
+    }
+
+    if (IS_ENABLED(CONFIG_APP_MESH_SENSOR)) {
+        mesh_sensor_scan(rec);
+    }
+}
+
+int scan_latest_get(struct scan_record *rec)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int err = have_latest ? 0 : -ENODATA;
+
+    if (have_latest) {
+        *rec = latest;
+    }
+    k_spin_unlock(&lock, key);
+
+    return err;
+}
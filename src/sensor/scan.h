@@ -0,0 +1,82 @@
+/**
+ * @file scan.h
+ * @brief Latest scan of the battery pack and its packed wire format.
+ *
+ * A scan is one pass over all multiplexer channels plus the internal temperature. Each
+ * channel measures the tap at the positive terminal of a battery, so channel i holds the
+ * cumulative voltage of batteries 0..i and the last battery in series holds the pack voltage.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+#include "main_voltage.h"
+
+/**
+ * @brief Packed scan record, as notified on the scan characteristic.
+ *
+ * All fields are little-endian.
+ */
+struct scan_record {
+    uint16_t seq;                     ///< Scan sequence number, wraps around
+    uint32_t time_ms;                 ///< Lower 32 bits of the scan time in ms (see time_sync.h)
+    int16_t temp;                     ///< Internal temperature in 1/10 °C
+    uint16_t tap_cv[TOTAL_CHANNELS];  ///< Tap voltages in cV
+} __packed;
+
+/**
+ * @brief Get the pack voltage of a scan.
+ *
+ * @param rec Scan record.
+ * @return Pack voltage in cV.
+ */
+static inline uint16_t scan_pack_cv(const struct scan_record *rec)
+{
+    return rec->tap_cv[NUMBER_OF_BATTERIES_IN_SERIES - 1];
+}
+
+/**
+ * @brief Get the voltage of a single battery of a scan.
+ *
+ * @param rec Scan record.
+ * @param cell Battery index, 0 is the battery at the negative end of the pack.
+ * @return Battery voltage in cV, 0 if the taps are inconsistent.
+ */
+static inline uint16_t scan_cell_cv(const struct scan_record *rec, uint8_t cell)
+{
+    uint16_t low = cell ? rec->tap_cv[cell - 1] : 0;
+
+    return rec->tap_cv[cell] > low ? rec->tap_cv[cell] - low : 0;
+}
+
+/**
+ * @brief Publish a completed scan.
+ *
+ * Stores the scan as the latest snapshot and notifies subscribed clients.
+ *
+ * @param rec Completed scan, the sequence number is assigned by this function.
+ */
+void scan_publish(struct scan_record *rec);
+
+/**
+ * @brief Copy the latest scan.
+ *
+ * Safe to call from any thread.
+ *
+ * @param rec Destination of the copy.
+ * @return 0 on success, or -ENODATA if no scan has been published yet.
+ */
+int scan_latest_get(struct scan_record *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCAN_H */
@@ -0,0 +1,110 @@
+/**
+ * @file main.c
+ * @brief Tests of the telemetry of the advertising data (src/bluetooth/adv_telemetry.h).
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#include "bluetooth/adv_telemetry.h"
+
+/** @brief Size of the legacy advertising data. */
+#define LEGACY_ADV_DATA_LEN 31
+
+/** @brief Name characters bluetooth.c keeps next to the telemetry. */
+#define ADV_NAME_LEN 11
+
+/**
+ * @brief A scan with batteries of 330, 340, 350, 360 and 370 cV, 21.5 °C.
+ */
+static void make_scan(struct scan_record *rec)
+{
+    static const uint16_t taps[TOTAL_CHANNELS] = { 330, 670, 1020, 1380, 1750, 0, 0, 0 };
+
+    memset(rec, 0, sizeof(*rec));
+    rec->seq = 0x1234;
+    rec->temp = 215;
+    memcpy(rec->tap_cv, taps, sizeof(taps));
+}
+
+ZTEST(adv_telemetry, test_layout)
+{
+    zassert_equal(sizeof(struct adv_telemetry), 13);
+    zassert_equal(offsetof(struct adv_telemetry, company), 0);
+    zassert_equal(offsetof(struct adv_telemetry, magic), 2);
+    zassert_equal(offsetof(struct adv_telemetry, seq), 3);
+    zassert_equal(offsetof(struct adv_telemetry, pack_cv), 5);
+    zassert_equal(offsetof(struct adv_telemetry, min_cell_cv), 7);
+    zassert_equal(offsetof(struct adv_telemetry, max_cell_cv), 9);
+    zassert_equal(offsetof(struct adv_telemetry, temp), 11);
+}
+
+ZTEST(adv_telemetry, test_fits_legacy_adv)
+{
+    // Flags AD (3 bytes), manufacturer data AD and shortened name AD, each with length and type
+    zassert_true(3 + 2 + sizeof(struct adv_telemetry) + 2 + ADV_NAME_LEN <= LEGACY_ADV_DATA_LEN);
+}
+
+ZTEST(adv_telemetry, test_encode_bytes)
+{
+    static const uint8_t expected[] = {
+        0xFF, 0xFF,                     // Company identifier
+        ADV_TELEMETRY_MAGIC,
+        0x34, 0x12,                     // Sequence number
+        0xD6, 0x06,                     // 1750 cV
+        0x4A, 0x01,                     // 330 cV
+        0x72, 0x01,                     // 370 cV
+        0xD7, 0x00,                     // 21.5 °C
+    };
+    struct adv_telemetry frame;
+    struct scan_record rec;
+
+    make_scan(&rec);
+    adv_telemetry_encode(&rec, &frame);
+
+    zassert_equal(sizeof(frame), sizeof(expected));
+    zassert_mem_equal(&frame, expected, sizeof(expected));
+}
+
+ZTEST(adv_telemetry, test_min_max)
+{
+    struct adv_telemetry frame;
+    struct scan_record rec;
+
+    // Lowest battery last, highest in the middle
+    make_scan(&rec);
+    rec.tap_cv[2] = 670 + 410;
+    rec.tap_cv[3] = 1080 + 340;
+    rec.tap_cv[4] = 1420 + 300;
+    adv_telemetry_encode(&rec, &frame);
+    zassert_equal(sys_le16_to_cpu(frame.min_cell_cv), 300);
+    zassert_equal(sys_le16_to_cpu(frame.max_cell_cv), 410);
+    zassert_equal(sys_le16_to_cpu(frame.pack_cv), 1720);
+
+    // Inconsistent taps read as an empty battery
+    make_scan(&rec);
+    rec.tap_cv[1] = 300;
+    adv_telemetry_encode(&rec, &frame);
+    zassert_equal(sys_le16_to_cpu(frame.min_cell_cv), 0);
+    zassert_equal(sys_le16_to_cpu(frame.max_cell_cv), 720);
+}
+
+ZTEST(adv_telemetry, test_round_trip)
+{
+    struct adv_telemetry frame;
+    struct scan_record rec;
+
+    make_scan(&rec);
+    rec.seq = 0xFFFF;
+    rec.temp = -105;
+    adv_telemetry_encode(&rec, &frame);
+
+    // Decoded as the gateway observer does
+    zassert_equal(sys_le16_to_cpu(frame.company), ADV_TELEMETRY_COMPANY_ID);
+    zassert_equal(frame.magic, ADV_TELEMETRY_MAGIC);
+    zassert_equal(sys_le16_to_cpu(frame.seq), 0xFFFF);
+    zassert_equal((int16_t)sys_le16_to_cpu(frame.temp), -105);
+}
+
+ZTEST_SUITE(adv_telemetry, NULL, NULL, NULL, NULL, NULL);
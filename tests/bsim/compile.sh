@@ -0,0 +1,16 @@
+#!/usr/bin/env bash
+#
+# Compile the BabbleSim tests of the application. Needs ZEPHYR_BASE, BSIM_OUT_PATH and
+# BSIM_COMPONENTS_PATH, see the BabbleSim section of the Zephyr documentation.
+#
+set -ue
+
+: "${ZEPHYR_BASE:?ZEPHYR_BASE must be set to point to the zephyr root directory}"
+
+source ${ZEPHYR_BASE}/tests/bsim/compile.source
+
+app_root=$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)
+
+app=tests/bsim/reconnect compile
+
+wait_for_background_jobs
@@ -0,0 +1,279 @@
+/**
+ * @file main.c
+ * @brief Reconnection time of the staged advertising (src/bluetooth/reconnect.c) in BabbleSim.
+ *
+ * The peripheral runs the reconnection stages. The central connects through the open stage and
+ * bonds, then disconnects and reconnects RECONNECTIONS times. Every reconnection must go
+ * through the directed advertising stage and complete within MAX_RECONNECT_MS, measured on
+ * both sides from the disconnection to the next connection.
+ */
+
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+
+#include "bs_types.h"
+#include "bs_tracing.h"
+#include "time_machine.h"
+#include "bstests.h"
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/reconnect.h"
+
+#define RECONNECTIONS    5
+#define MAX_RECONNECT_MS 100
+#define STEP_TIMEOUT     K_SECONDS(10)
+#define TEST_TIMEOUT_US  (60 * USEC_PER_SEC)
+
+extern enum bst_result_t bst_result;
+
+#define FAIL(...)                                       \
+    do {                                                \
+        bst_result = Failed;                            \
+        bs_trace_error_time_line(__VA_ARGS__);          \
+    } while (0)
+
+#define PASS(...)                                       \
+    do {                                                \
+        bst_result = Passed;                            \
+        bs_trace_info_time(1, __VA_ARGS__);             \
+    } while (0)
+
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
+};
+
+static bool is_central;
+static struct bt_conn *conn;        ///< Connection of the central
+static bt_addr_le_t peer;           ///< Address of the peripheral, seen by the central
+static int64_t connected_at;
+static int64_t disconnected_at;
+
+static K_SEM_DEFINE(found_sem, 0, 1);
+static K_SEM_DEFINE(connected_sem, 0, RECONNECTIONS + 1);
+static K_SEM_DEFINE(disconnected_sem, 0, 1);
+static K_SEM_DEFINE(bonded_sem, 0, 1);
+
+// Stand-in for bluetooth.c
+int bluetooth_adv_start(const struct bt_le_adv_param *param)
+{
+    return bt_le_adv_start(param, ad, ARRAY_SIZE(ad), NULL, 0);
+}
+
+static void connected(struct bt_conn *c, uint8_t err)
+{
+    if (err) {
+        // The central owns the reference of a failed connection attempt
+        if (is_central && c == conn) {
+            bt_conn_unref(conn);
+            conn = NULL;
+        }
+        return;
+    }
+
+    connected_at = k_uptime_get();
+    k_sem_give(&connected_sem);
+}
+
+static void disconnected(struct bt_conn *c, uint8_t reason)
+{
+    disconnected_at = k_uptime_get();
+
+    // The peripheral holds no reference, so the stage restarts when the object is recycled
+    if (is_central && c == conn) {
+        bt_conn_unref(conn);
+        conn = NULL;
+    }
+    k_sem_give(&disconnected_sem);
+}
+
+BT_CONN_CB_DEFINE(test_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+};
+
+static void pairing_complete(struct bt_conn *c, bool bonded)
+{
+    if (!bonded) {
+        FAIL("Paired without a bond\n");
+        return;
+    }
+    k_sem_give(&bonded_sem);
+}
+
+static void pairing_failed(struct bt_conn *c, enum bt_security_err reason)
+{
+    FAIL("Pairing failed (reason %d)\n", reason);
+}
+
+static struct bt_conn_auth_info_cb auth_info = {
+    .pairing_complete = pairing_complete,
+    .pairing_failed = pairing_failed,
+};
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+                         struct net_buf_simple *ad_buf)
+{
+    if (type != BT_GAP_ADV_TYPE_ADV_IND || bt_le_scan_stop()) {
+        return;
+    }
+
+    bt_addr_le_copy(&peer, addr);
+    k_sem_give(&found_sem);
+}
+
+static void central_main(void)
+{
+    const struct bt_le_scan_param scan = BT_LE_SCAN_PARAM_INIT(
+        BT_LE_SCAN_TYPE_PASSIVE, BT_LE_SCAN_OPT_NONE, BT_GAP_SCAN_FAST_INTERVAL,
+        BT_GAP_SCAN_FAST_INTERVAL);
+    uint32_t max_ms = 0;
+    int err;
+
+    is_central = true;
+
+    err = bt_enable(NULL);
+    if (err) {
+        FAIL("Bluetooth init failed (err %d)\n", err);
+        return;
+    }
+    bt_conn_auth_info_cb_register(&auth_info);
+
+    // First connection through the open stage, and bond
+    err = bt_le_scan_start(&scan, device_found);
+    if (err || k_sem_take(&found_sem, STEP_TIMEOUT)) {
+        FAIL("Peripheral not found (err %d)\n", err);
+        return;
+    }
+    err = bt_conn_le_create(&peer, BT_CONN_LE_CREATE_CONN, BT_LE_CONN_PARAM_DEFAULT, &conn);
+    if (err || k_sem_take(&connected_sem, STEP_TIMEOUT)) {
+        FAIL("First connection failed (err %d)\n", err);
+        return;
+    }
+    err = bt_conn_set_security(conn, BT_SECURITY_L2);
+    if (err || k_sem_take(&bonded_sem, STEP_TIMEOUT)) {
+        FAIL("Bonding failed (err %d)\n", err);
+        return;
+    }
+
+    for (int i = 0; i < RECONNECTIONS; i++) {
+        uint32_t elapsed;
+
+        err = bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+        if (err || k_sem_take(&disconnected_sem, STEP_TIMEOUT)) {
+            FAIL("Disconnection %d failed (err %d)\n", i, err);
+            return;
+        }
+
+        // The initiator scans continuously and answers the directed advertising
+        err = bt_conn_le_create(&peer, BT_CONN_LE_CREATE_CONN, BT_LE_CONN_PARAM_DEFAULT, &conn);
+        if (err || k_sem_take(&connected_sem, STEP_TIMEOUT)) {
+            FAIL("Reconnection %d failed (err %d)\n", i, err);
+            return;
+        }
+
+        elapsed = connected_at - disconnected_at;
+        max_ms = MAX(max_ms, elapsed);
+        printk("Reconnection %d in %u ms\n", i, elapsed);
+        if (elapsed > MAX_RECONNECT_MS) {
+            FAIL("Reconnection %d took %u ms, more than %u ms\n", i, elapsed, MAX_RECONNECT_MS);
+            return;
+        }
+    }
+
+    PASS("Central: %d reconnections, longest %u ms\n", RECONNECTIONS, max_ms);
+}
+
+static void peripheral_main(void)
+{
+    unsigned int directed, accept_list, open, last_ms, max_ms;
+    char status[96];
+    int err;
+
+    err = bt_enable(NULL);
+    if (err) {
+        FAIL("Bluetooth init failed (err %d)\n", err);
+        return;
+    }
+    reconnect_start();
+
+    for (int i = 0; i <= RECONNECTIONS; i++) {
+        if (k_sem_take(&connected_sem, STEP_TIMEOUT)) {
+            FAIL("Connection %d missing\n", i);
+            return;
+        }
+    }
+
+    // Let the reconnect.c callbacks of the last connection run
+    k_sleep(K_MSEC(100));
+
+    reconnect_format_status(status, sizeof(status));
+    printk("%s", status);
+    if (sscanf(status, "reconn directed %u accept-list %u open %u last %u max %u", &directed,
+               &accept_list, &open, &last_ms, &max_ms) != 5) {
+        FAIL("Unexpected status line\n");
+        return;
+    }
+    if (open != 1 || directed != RECONNECTIONS || accept_list != 0) {
+        FAIL("Connections per stage: open %u directed %u accept-list %u\n", open, directed,
+             accept_list);
+        return;
+    }
+    if (max_ms > MAX_RECONNECT_MS) {
+        FAIL("Longest reconnection %u ms, more than %u ms\n", max_ms, MAX_RECONNECT_MS);
+        return;
+    }
+
+    PASS("Peripheral: last reconnection %u ms, longest %u ms\n", last_ms, max_ms);
+}
+
+static void test_init(void)
+{
+    bst_ticker_set_next_tick_absolute(TEST_TIMEOUT_US);
+    bst_result = In_progress;
+}
+
+static void test_tick(bs_time_t HW_device_time)
+{
+    if (bst_result != Passed) {
+        FAIL("Test timed out\n");
+    }
+}
+
+static const struct bst_test_instance test_defs[] = {
+    {
+        .test_id = "peripheral",
+        .test_descr = "Staged advertising of the monitor, checks its reconnection counters",
+        .test_post_init_f = test_init,
+        .test_tick_f = test_tick,
+        .test_main_f = peripheral_main,
+    },
+    {
+        .test_id = "central",
+        .test_descr = "Bonds, then disconnects and measures every reconnection",
+        .test_post_init_f = test_init,
+        .test_tick_f = test_tick,
+        .test_main_f = central_main,
+    },
+    BSTEST_END_MARKER
+};
+
+static struct bst_test_list *test_reconnect_install(struct bst_test_list *tests)
+{
+    return bst_add_tests(tests, test_defs);
+}
+
+bst_test_install_t test_installers[] = {
+    test_reconnect_install,
+    NULL
+};
+
+int main(void)
+{
+    bst_main();
+    return 0;
+}
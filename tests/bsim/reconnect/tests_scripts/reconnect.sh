@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+#
+# A central bonds with the peripheral, then disconnects and reconnects RECONNECTIONS times.
+# Both sides check the time from the disconnection to the next connection.
+#
+source ${ZEPHYR_BASE}/tests/bsim/sh_common.source
+
+simulation_id="reconnect"
+verbosity_level=2
+EXECUTE_TIMEOUT=120
+
+cd ${BSIM_OUT_PATH}/bin
+
+Execute ./bs_${BOARD_TS}_tests_bsim_reconnect_prj_conf \
+  -v=${verbosity_level} -s=${simulation_id} -d=0 -testid=peripheral -RealEncryption=1
+
+Execute ./bs_${BOARD_TS}_tests_bsim_reconnect_prj_conf \
+  -v=${verbosity_level} -s=${simulation_id} -d=1 -testid=central -RealEncryption=1
+
+Execute ./bs_2G4_phy_v1 -v=${verbosity_level} -s=${simulation_id} -D=2 -sim_length=60e6 $@
+
+wait_for_background_jobs
@@ -0,0 +1,135 @@
+/**
+ * @file main.c
+ * @brief Tests of the CAN telemetry frame packing (src/output/can_output.c).
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "output/can_output.h"
+#include "sensor/scan.h"
+#include "sensor/pack_metrics.h"
+#include "application/app_config.h"
+
+static struct app_config test_cfg = {
+    .cell_low_cv = 300,
+    .cell_high_cv = 420,
+    .imbalance_cv = 50,
+    .temp_high_dc = 600,
+};
+
+// Stand-ins for the modules can_output.c reads from
+
+void app_config_read(struct app_config *cfg)
+{
+    *cfg = test_cfg;
+}
+
+int scan_latest_get(struct scan_record *rec)
+{
+    ARG_UNUSED(rec);
+    return -ENODATA;
+}
+
+/**
+ * @brief A scan with batteries of 330, 340, 350, 360 and 370 cV, 21.5 °C.
+ */
+static void make_scan(struct scan_record *rec)
+{
+    static const uint16_t taps[TOTAL_CHANNELS] = { 330, 670, 1020, 1380, 1750, 0, 0, 0 };
+
+    memset(rec, 0, sizeof(*rec));
+    rec->seq = 0x1234;
+    rec->temp = 215;
+    memcpy(rec->tap_cv, taps, sizeof(taps));
+}
+
+/**
+ * @brief Get a signal from the packed frames.
+ */
+static uint16_t signal_at(const struct can_frame *frames, enum can_signal sig)
+{
+    const struct can_frame *f = &frames[sig / CAN_OUTPUT_FRAME_SIGNALS];
+
+    return sys_get_le16(&f->data[(sig % CAN_OUTPUT_FRAME_SIGNALS) * sizeof(uint16_t)]);
+}
+
+static void *setup(void)
+{
+    zassert_ok(can_output_init());
+    return NULL;
+}
+
+ZTEST(can_output, test_layout)
+{
+    struct can_frame frames[CAN_OUTPUT_FRAME_COUNT];
+    struct scan_record rec;
+    size_t signals = 0;
+
+    make_scan(&rec);
+    can_output_pack(&rec, &test_cfg, frames);
+
+    for (size_t i = 0; i < CAN_OUTPUT_FRAME_COUNT; i++) {
+        size_t len = can_dlc_to_bytes(frames[i].dlc);
+
+        // Transmit PDO identifiers 0x180, 0x280, ... plus the node id
+        zassert_equal(frames[i].id, 0x180 + i * 0x100 + CONFIG_APP_CAN_NODE_ID);
+        zassert_equal((frames[i].flags & CAN_FRAME_FDF) != 0, IS_ENABLED(CONFIG_APP_CAN_FD));
+        zassert_true(len <= CAN_OUTPUT_FRAME_LEN);
+        // Only the last frame may be partly filled
+        if (i + 1 < CAN_OUTPUT_FRAME_COUNT) {
+            zassert_equal(len, CAN_OUTPUT_FRAME_LEN, "frame %zu is %zu bytes", i, len);
+        }
+        signals += len / sizeof(uint16_t);
+    }
+
+    // An FD frame rounds up to a valid length, classic frames carry exactly the signals
+    if (!IS_ENABLED(CONFIG_APP_CAN_FD)) {
+        zassert_equal(signals, CAN_SIG_COUNT);
+    } else {
+        zassert_true(signals >= CAN_SIG_COUNT);
+    }
+}
+
+ZTEST(can_output, test_signals)
+{
+    struct can_frame frames[CAN_OUTPUT_FRAME_COUNT];
+    struct scan_record rec;
+
+    make_scan(&rec);
+    can_output_pack(&rec, &test_cfg, frames);
+
+    zassert_equal(signal_at(frames, CAN_SIG_PACK_CV), 1750);
+    zassert_equal(signal_at(frames, CAN_SIG_MIN_CELL_CV), 330);
+    zassert_equal(signal_at(frames, CAN_SIG_MAX_CELL_CV), 370);
+    zassert_equal(signal_at(frames, CAN_SIG_ALARMS), 0);
+    zassert_equal(signal_at(frames, CAN_SIG_TEMP), 215);
+    zassert_equal(signal_at(frames, CAN_SIG_AVG_CELL_CV), 350);
+    zassert_equal(signal_at(frames, CAN_SIG_MIN_MAX_CELL), 0 | (4 << 8));
+    zassert_equal(signal_at(frames, CAN_SIG_SEQ), 0x1234);
+    for (uint8_t i = 0; i < NUMBER_OF_BATTERIES_IN_SERIES; i++) {
+        zassert_equal(signal_at(frames, CAN_SIG_CELL_CV + i), 330 + 10 * i, "battery %u", i);
+    }
+}
+
+ZTEST(can_output, test_alarms_and_negative_temp)
+{
+    struct can_frame frames[CAN_OUTPUT_FRAME_COUNT];
+    struct scan_record rec;
+
+    make_scan(&rec);
+    rec.tap_cv[0] = 250;   // First battery low, 250 to 420 cV exceeds the imbalance threshold
+    rec.temp = -105;
+    can_output_pack(&rec, &test_cfg, frames);
+
+    zassert_equal(signal_at(frames, CAN_SIG_ALARMS),
+                  PACK_ALARM_CELL_LOW | PACK_ALARM_IMBALANCE);
+    zassert_equal((int16_t)signal_at(frames, CAN_SIG_TEMP), -105);
+    zassert_equal(signal_at(frames, CAN_SIG_CELL_CV + 1), 420);
+    zassert_equal(signal_at(frames, CAN_SIG_MIN_MAX_CELL), 0 | (1 << 8));
+}
+
+ZTEST_SUITE(can_output, NULL, setup, NULL, NULL, NULL);
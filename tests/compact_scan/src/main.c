@@ -0,0 +1,138 @@
+/**
+ * @file main.c
+ * @brief Tests of the compact scan payload of the long range profile (src/bluetooth/compact_scan.h).
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#include "bluetooth/compact_scan.h"
+
+/** @brief Size of the legacy advertising data. */
+#define LEGACY_ADV_DATA_LEN 31
+
+/**
+ * @brief A scan of 21.5 °C with metrics for batteries of 330, 340, 600, 335 and 360 cV.
+ *
+ * The third battery is 270 cV above the lowest one, beyond the range of an offset.
+ */
+static void make_scan(struct scan_record *rec, struct pack_metrics *m)
+{
+    static const uint16_t cells[NUMBER_OF_BATTERIES_IN_SERIES] = { 330, 340, 600, 335, 360 };
+
+    memset(rec, 0, sizeof(*rec));
+    rec->seq = 0x1234;
+    rec->temp = 215;
+
+    memset(m, 0, sizeof(*m));
+    memcpy(m->cell_cv, cells, sizeof(cells));
+    m->pack_cv = 1965;
+    m->min_cell_cv = 330;
+    m->max_cell_cv = 600;
+    m->alarms = PACK_ALARM_CELL_HIGH | PACK_ALARM_IMBALANCE;
+}
+
+ZTEST(compact_scan, test_layout)
+{
+    zassert_equal(sizeof(struct compact_scan), 13);
+    zassert_equal(offsetof(struct compact_scan, magic), 0);
+    zassert_equal(offsetof(struct compact_scan, seq), 1);
+    zassert_equal(offsetof(struct compact_scan, pack_cv), 2);
+    zassert_equal(offsetof(struct compact_scan, min_cell_cv), 4);
+    zassert_equal(offsetof(struct compact_scan, cell_offset_cv), 6);
+    zassert_equal(offsetof(struct compact_scan, temp_c), 11);
+    zassert_equal(offsetof(struct compact_scan, alarms), 12);
+}
+
+ZTEST(compact_scan, test_fits_legacy_adv)
+{
+    // Flags AD (3 bytes), then the manufacturer data AD: length, type, company id, scan
+    zassert_true(3 + 2 + sizeof(uint16_t) + sizeof(struct compact_scan) <= LEGACY_ADV_DATA_LEN);
+}
+
+ZTEST(compact_scan, test_encode_bytes)
+{
+    static const uint8_t expected[] = {
+        COMPACT_SCAN_MAGIC,
+        0x34,                           // Lower 8 bits of the sequence number
+        0xAD, 0x07,                     // 1965 cV
+        0x4A, 0x01,                     // 330 cV
+        0, 10, 255, 5, 30,              // Offsets, the third one saturated
+        21,                             // °C
+        PACK_ALARM_CELL_HIGH | PACK_ALARM_IMBALANCE,
+    };
+    struct compact_scan out;
+    struct pack_metrics m;
+    struct scan_record rec;
+
+    make_scan(&rec, &m);
+    compact_scan_encode(&rec, &m, &out);
+
+    zassert_equal(sizeof(out), sizeof(expected));
+    zassert_mem_equal(&out, expected, sizeof(expected));
+}
+
+ZTEST(compact_scan, test_temperature)
+{
+    static const struct {
+        int16_t temp;
+        int8_t temp_c;
+    } cases[] = {
+        { 0, 0 },
+        { 9, 0 },
+        { -105, -10 },   // Truncated toward zero
+        { 1270, 127 },
+        { 1280, 127 },   // Clamped to the range of the field
+        { -1280, -128 },
+        { -2000, -128 },
+    };
+    struct compact_scan out;
+    struct pack_metrics m;
+    struct scan_record rec;
+
+    make_scan(&rec, &m);
+    for (size_t i = 0; i < ARRAY_SIZE(cases); i++) {
+        rec.temp = cases[i].temp;
+        compact_scan_encode(&rec, &m, &out);
+        zassert_equal(out.temp_c, cases[i].temp_c, "%d dC encoded as %d °C", cases[i].temp,
+                      out.temp_c);
+    }
+}
+
+ZTEST(compact_scan, test_offsets)
+{
+    struct compact_scan out;
+    struct pack_metrics m;
+    struct scan_record rec;
+
+    make_scan(&rec, &m);
+    m.cell_cv[2] = 330 + 254;
+    m.cell_cv[3] = 330 + 255;
+    m.cell_cv[4] = UINT16_MAX;
+    compact_scan_encode(&rec, &m, &out);
+
+    zassert_equal(out.cell_offset_cv[0], 0);
+    zassert_equal(out.cell_offset_cv[1], 10);
+    zassert_equal(out.cell_offset_cv[2], 254);
+    zassert_equal(out.cell_offset_cv[3], 255);
+    zassert_equal(out.cell_offset_cv[4], 255);
+}
+
+ZTEST(compact_scan, test_seq_wraps)
+{
+    struct compact_scan out;
+    struct pack_metrics m;
+    struct scan_record rec;
+
+    make_scan(&rec, &m);
+    rec.seq = 0xFF;
+    compact_scan_encode(&rec, &m, &out);
+    zassert_equal(out.seq, 0xFF);
+
+    rec.seq = 0x100;
+    compact_scan_encode(&rec, &m, &out);
+    zassert_equal(out.seq, 0);
+}
+
+ZTEST_SUITE(compact_scan, NULL, NULL, NULL, NULL, NULL);
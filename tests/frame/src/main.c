@@ -0,0 +1,141 @@
+/**
+ * @file main.c
+ * @brief Tests of the COBS/CRC framing (src/output/frame.c).
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+#include <zephyr/sys/crc.h>
+
+#include "output/frame.h"
+
+/**
+ * @brief COBS decode a frame, as a host receiver does.
+ *
+ * @param in Encoded frame, without the zero terminator.
+ * @param len Length of the encoded frame.
+ * @param out Destination, at least len bytes.
+ * @return Decoded length, or -EINVAL if the frame holds a zero byte or a truncated block.
+ */
+static int cobs_decode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t pos = 0;
+    size_t n = 0;
+
+    while (pos < len) {
+        uint8_t code = in[pos++];
+
+        if (code == 0 || pos + code - 1 > len) {
+            return -EINVAL;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            if (in[pos] == 0) {
+                return -EINVAL;
+            }
+            out[n++] = in[pos++];
+        }
+        if (code != 0xFF && pos < len) {
+            out[n++] = 0;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * @brief Encode a frame, check its framing and return the decoded type, payload and CRC.
+ *
+ * @return Decoded length (type, payload and CRC).
+ */
+static int encode_decode(uint8_t type, const uint8_t *payload, size_t len, uint8_t *raw)
+{
+    uint8_t out[FRAME_ENCODED_SIZE(FRAME_MAX_PAYLOAD)];
+    int encoded = frame_encode(type, payload, len, out, FRAME_ENCODED_SIZE(len));
+
+    zassert_true(encoded > 0, "encode failed (err %d)", encoded);
+    zassert_true(encoded <= (int)FRAME_ENCODED_SIZE(len), "frame longer than the worst case");
+    zassert_equal(out[encoded - 1], 0, "missing terminator");
+    zassert_is_null(memchr(out, 0, encoded - 1), "zero byte inside the frame");
+
+    return cobs_decode(out, encoded - 1, raw);
+}
+
+ZTEST(frame, test_known_vector)
+{
+    static const uint8_t payload[] = { 0x00, 0x11, 0x00 };
+    static const uint8_t expected[] = { 0x02, 0x01, 0x02, 0x11, 0x03, 0xD3, 0x93, 0x00 };
+    uint8_t out[FRAME_ENCODED_SIZE(sizeof(payload))];
+    int encoded = frame_encode(0x01, payload, sizeof(payload), out, sizeof(out));
+
+    zassert_equal(encoded, sizeof(expected));
+    zassert_mem_equal(out, expected, sizeof(expected));
+}
+
+ZTEST(frame, test_crc_check_value)
+{
+    // CRC-16/CCITT with init 0xFFFF, reflected, as documented in frame.h
+    zassert_equal(crc16_ccitt(0xFFFF, (const uint8_t *)"123456789", 9), 0x6F91);
+}
+
+ZTEST(frame, test_round_trip)
+{
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    uint8_t raw[1 + FRAME_MAX_PAYLOAD + 2];
+
+    // Zero runs at the start, middle and end, and a payload without any zero
+    for (size_t pattern = 0; pattern < 4; pattern++) {
+        for (size_t len = 0; len <= FRAME_MAX_PAYLOAD; len++) {
+            int n;
+
+            for (size_t i = 0; i < len; i++) {
+                payload[i] = (pattern == 3 || (i + pattern) % 3) ? (uint8_t)(i * 7 + 1) : 0;
+            }
+
+            n = encode_decode(FRAME_HISTORY, payload, len, raw);
+            zassert_equal(n, 1 + len + 2, "length %zu: decoded %d bytes", len, n);
+            zassert_equal(raw[0], FRAME_HISTORY);
+            zassert_mem_equal(&raw[1], payload, len, "length %zu: payload differs", len);
+            // The CRC residue over type, payload and little-endian CRC is zero
+            zassert_equal(crc16_ccitt(0xFFFF, raw, n), 0, "length %zu: bad CRC", len);
+        }
+    }
+}
+
+ZTEST(frame, test_all_zero_payload)
+{
+    uint8_t payload[FRAME_MAX_PAYLOAD] = { 0 };
+    uint8_t raw[1 + FRAME_MAX_PAYLOAD + 2];
+    int n = encode_decode(FRAME_SCAN, payload, sizeof(payload), raw);
+
+    zassert_equal(n, 1 + sizeof(payload) + 2);
+    zassert_mem_equal(&raw[1], payload, sizeof(payload));
+}
+
+ZTEST(frame, test_payload_too_long)
+{
+    uint8_t payload[FRAME_MAX_PAYLOAD + 1] = { 0 };
+    uint8_t out[FRAME_ENCODED_SIZE(FRAME_MAX_PAYLOAD + 1)];
+
+    zassert_equal(frame_encode(FRAME_SCAN, payload, sizeof(payload), out, sizeof(out)),
+                  -ENOMEM);
+}
+
+ZTEST(frame, test_buffer_too_small)
+{
+    uint8_t payload[16];
+    uint8_t out[FRAME_ENCODED_SIZE(sizeof(payload))];
+    int needed;
+
+    memset(payload, 0xA5, sizeof(payload));
+    needed = frame_encode(FRAME_SCAN, payload, sizeof(payload), out, sizeof(out));
+    zassert_true(needed > 0);
+
+    for (int size = 0; size < needed; size++) {
+        zassert_equal(frame_encode(FRAME_SCAN, payload, sizeof(payload), out, size), -ENOMEM,
+                      "size %d accepted, %d needed", size, needed);
+    }
+    zassert_equal(frame_encode(FRAME_SCAN, payload, sizeof(payload), out, needed), needed);
+}
+
+ZTEST_SUITE(frame, NULL, NULL, NULL, NULL, NULL);
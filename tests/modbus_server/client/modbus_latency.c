@@ -0,0 +1,230 @@
+/**
+ * @file modbus_latency.c
+ * @brief Host Modbus RTU client: polls the server under test and measures the response latency.
+ *
+ * Usage: modbus_latency <tty> [requests] [max latency us]
+ *
+ * Every round reads all the input registers and checks that they come from a single scan (see
+ * src/main.c for the relation between the values). It then reads the registers below the
+ * request counter, and the counter with a request that starts right after the end of the
+ * previous one: the server must still count both requests. The latency is the time from the
+ * end of the request write to the last byte of the response. Exits with 1 on any error, torn response or latency above the bound.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "output/modbus_server.h"
+
+#define UNIT_ID         1
+#define FC_READ_INPUT   0x04
+#define TIMEOUT_MS      1000
+
+static uint16_t crc16_modbus(const uint8_t *buf, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+
+    return crc;
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Read exactly len bytes, or fail after TIMEOUT_MS.
+ */
+static int read_exact(int fd, uint8_t *buf, size_t len)
+{
+    size_t got = 0;
+
+    while (got < len) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        ssize_t n;
+
+        if (poll(&pfd, 1, TIMEOUT_MS) <= 0) {
+            return -ETIMEDOUT;
+        }
+        n = read(fd, &buf[got], len - got);
+        if (n < 0) {
+            return -errno;
+        }
+        got += n;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read input registers.
+ *
+ * @param latency_us Destination for the response latency.
+ * @return 0 on success, a Modbus exception code, or a negative error code.
+ */
+static int read_input(int fd, uint16_t addr, uint16_t count, uint16_t *regs, int64_t *latency_us)
+{
+    uint8_t req[8] = { UNIT_ID, FC_READ_INPUT, addr >> 8, addr, count >> 8, count };
+    uint8_t rsp[5 + 2 * MB_REG_COUNT];
+    size_t len = 5 + 2 * count;
+    uint16_t crc = crc16_modbus(req, 6);
+    int64_t start;
+    int err;
+
+    req[6] = crc;
+    req[7] = crc >> 8;
+
+    tcflush(fd, TCIFLUSH);
+    if (write(fd, req, sizeof(req)) != sizeof(req)) {
+        return -EIO;
+    }
+    tcdrain(fd);
+    start = now_us();
+
+    // Header first: an exception response is only 5 bytes long
+    err = read_exact(fd, rsp, 3);
+    if (err) {
+        return err;
+    }
+    if (rsp[1] == (FC_READ_INPUT | 0x80)) {
+        err = read_exact(fd, &rsp[3], 2);
+        return err ? err : rsp[2];
+    }
+    if (rsp[0] != UNIT_ID || rsp[1] != FC_READ_INPUT || rsp[2] != 2 * count) {
+        return -EBADMSG;
+    }
+    err = read_exact(fd, &rsp[3], len - 3);
+    if (err) {
+        return err;
+    }
+    *latency_us = now_us() - start;
+
+    crc = crc16_modbus(rsp, len - 2);
+    if (rsp[len - 2] != (uint8_t)crc || rsp[len - 1] != crc >> 8) {
+        return -EBADMSG;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        regs[i] = (rsp[3 + 2 * i] << 8) | rsp[4 + 2 * i];
+    }
+
+    return 0;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 2 ? atoi(argv[2]) : 200;
+    int64_t max_us = argc > 3 ? atoll(argv[3]) : 50000;
+    int64_t *latency;
+    int64_t sum = 0;
+    int samples = 0;
+    int torn = 0;
+    int lost = 0;
+    struct termios tio;
+    int fd;
+
+    if (argc < 2 || rounds <= 0) {
+        fprintf(stderr, "usage: %s <tty> [requests] [max latency us]\n", argv[0]);
+        return 2;
+    }
+
+    fd = open(argv[1], O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B19200);
+    tio.c_cflag |= PARENB;
+    tcsetattr(fd, TCSANOW, &tio);
+
+    latency = calloc(3 * rounds, sizeof(*latency));
+    if (latency == NULL) {
+        return 1;
+    }
+
+    for (int round = 0; round < rounds; round++) {
+        uint16_t regs[MB_REG_COUNT];
+        uint16_t counter[2];
+        uint32_t requests;
+        uint16_t seq;
+        int err;
+
+        err = read_input(fd, 0, MB_REG_COUNT, regs, &latency[samples]);
+        if (err) {
+            fprintf(stderr, "round %d: read failed (%d)\n", round, err);
+            lost++;
+            continue;
+        }
+        sum += latency[samples++];
+
+        seq = regs[MB_REG_SEQ];
+        if (regs[MB_REG_TIME_LO] != seq || regs[MB_REG_TIME_HI] != seq ||
+            regs[MB_REG_SCANS_LO] != (uint16_t)(seq + 1) ||
+            regs[MB_REG_CELL_CV] != 300 + seq % 50) {
+            fprintf(stderr, "round %d: torn response seq %u time %u/%u scans %u cell %u\n",
+                    round, seq, regs[MB_REG_TIME_LO], regs[MB_REG_TIME_HI],
+                    regs[MB_REG_SCANS_LO], regs[MB_REG_CELL_CV]);
+            torn++;
+        }
+        requests = regs[MB_REG_REQUESTS_LO] | ((uint32_t)regs[MB_REG_REQUESTS_HI] << 16);
+
+        // Read up to the counter, then the counter right after: still two requests
+        err = read_input(fd, 0, MB_REG_REQUESTS_LO, regs, &latency[samples]);
+        if (!err) {
+            sum += latency[samples++];
+            err = read_input(fd, MB_REG_REQUESTS_LO, 2, counter, &latency[samples]);
+        }
+        if (err) {
+            fprintf(stderr, "round %d: counter read failed (%d)\n", round, err);
+            lost++;
+            continue;
+        }
+        sum += latency[samples++];
+        if ((counter[0] | ((uint32_t)counter[1] << 16)) != requests + 2) {
+            fprintf(stderr, "round %d: request counter %u, expected %u\n", round,
+                    counter[0] | ((uint32_t)counter[1] << 16), requests + 2);
+            torn++;
+        }
+    }
+
+    close(fd);
+
+    if (samples == 0) {
+        printf("no response\n");
+        return 1;
+    }
+
+    qsort(latency, samples, sizeof(*latency), compare_latency);
+    printf("%d requests, %d lost, %d torn, latency min %lld avg %lld p99 %lld max %lld us\n",
+           samples, lost, torn, (long long)latency[0], (long long)(sum / samples),
+           (long long)latency[samples * 99 / 100], (long long)latency[samples - 1]);
+
+    return lost || torn || latency[samples - 1] > max_us;
+}
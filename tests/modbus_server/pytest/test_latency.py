@@ -0,0 +1,34 @@
+#
+# Polls the Modbus server of the native_sim image through its pty with the C client in
+# ../client, which checks every response and measures the latency.
+#
+
+import re
+import shutil
+import subprocess
+from pathlib import Path
+
+from twister_harness import DeviceAdapter
+
+TEST_DIR = Path(__file__).resolve().parents[1]
+APP_SRC = TEST_DIR.parents[1] / "src"
+CLIENT = TEST_DIR / "client" / "modbus_latency.c"
+
+ROUNDS = 300
+MAX_LATENCY_US = 50000
+
+
+def test_latency(dut: DeviceAdapter, tmp_path: Path):
+    lines = dut.readlines_until(regex="Modbus server ready", timeout=10)
+    ptys = [m.group(1) for m in (re.search(r"uart2 connected to pseudotty: (\S+)", line)
+                                 for line in lines) if m]
+    assert ptys, "pty of the Modbus UART not found"
+
+    client = tmp_path / "modbus_latency"
+    subprocess.run([shutil.which("cc") or "gcc", "-O2", "-Wall", f"-I{APP_SRC}",
+                    "-o", str(client), str(CLIENT)], check=True)
+
+    result = subprocess.run([str(client), ptys[0], str(ROUNDS), str(MAX_LATENCY_US)],
+                            capture_output=True, text=True, timeout=120)
+    print(result.stdout)
+    assert result.returncode == 0, result.stdout + result.stderr
@@ -0,0 +1,247 @@
+/**
+ * @file main.c
+ * @brief Tests of the pack table of the gateway observer (src/gateway/pack_table.c).
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "gateway/pack_table.h"
+
+#define TABLE_SIZE  CONFIG_APP_OBSERVER_TABLE_SIZE
+#define MAX_ENTRIES (TABLE_SIZE * 3 / 4)
+
+#define OLD_MS      100   ///< Last seen time of the entries to expire
+#define NOW_MS      5000  ///< Last seen time of the fresh entries, and expiry time
+#define TIMEOUT_MS  1000
+
+/**
+ * @brief Home slot of an address, as pack_table.c hashes it.
+ */
+static size_t home_slot(const bt_addr_le_t *addr)
+{
+    uint32_t hash = 2166136261u;
+
+    hash = (hash ^ addr->type) * 16777619u;
+    for (size_t i = 0; i < sizeof(addr->a.val); i++) {
+        hash = (hash ^ addr->a.val[i]) * 16777619u;
+    }
+
+    return hash & (TABLE_SIZE - 1);
+}
+
+/**
+ * @brief Get the n-th random static address whose home slot is the given one.
+ */
+static bt_addr_le_t addr_at(size_t slot, size_t n)
+{
+    bt_addr_le_t addr = { .type = BT_ADDR_LE_RANDOM };
+
+    for (uint32_t k = 0;; k++) {
+        sys_put_le32(k, addr.a.val);
+        addr.a.val[5] = 0xC0;
+        if (home_slot(&addr) == slot && n-- == 0) {
+            return addr;
+        }
+    }
+}
+
+static struct pack_entry make_entry(const bt_addr_le_t *addr, uint16_t seq, uint32_t seen_ms)
+{
+    struct pack_entry entry = {
+        .addr = *addr,
+        .rssi = -70,
+        .seq = seq,
+        .last_seen_ms = seen_ms,
+        .pack_cv = 1750,
+        .min_cell_cv = 330,
+        .max_cell_cv = 370,
+        .temp = 215,
+    };
+
+    return entry;
+}
+
+/**
+ * @brief Check that an entry is stored with its sequence number.
+ *
+ * A stored entry is reported as a duplicate, anything else would be inserted.
+ */
+static void assert_stored(const struct pack_entry *entry)
+{
+    size_t count = pack_table_count();
+
+    zassert_equal(pack_table_update(entry), -EALREADY, "seq %u not found", entry->seq);
+    zassert_equal(pack_table_count(), count);
+}
+
+/**
+ * @brief Collect all the dirty entries, in batches of the given size.
+ */
+static size_t collect_all(struct pack_entry *out, size_t batch)
+{
+    size_t cursor = 0;
+    size_t total = 0;
+    size_t n;
+
+    do {
+        n = pack_table_collect(&out[total], batch, &cursor);
+        zassert_true(n <= batch);
+        total += n;
+    } while (n > 0);
+
+    return total;
+}
+
+static void empty_table(void *fixture)
+{
+    struct pack_entry out[TABLE_SIZE];
+
+    ARG_UNUSED(fixture);
+
+    pack_table_expire(NOW_MS + TIMEOUT_MS + 1, 0);
+    zassert_equal(pack_table_count(), 0);
+    zassert_equal(collect_all(out, TABLE_SIZE), 0);
+}
+
+ZTEST(pack_table, test_insert_update)
+{
+    bt_addr_le_t addr = addr_at(3, 0);
+    struct pack_entry entry = make_entry(&addr, 1, NOW_MS);
+    struct pack_entry out[TABLE_SIZE];
+
+    zassert_ok(pack_table_update(&entry));
+    zassert_equal(pack_table_count(), 1);
+
+    zassert_equal(collect_all(out, TABLE_SIZE), 1);
+    zassert_true(bt_addr_le_eq(&out[0].addr, &addr));
+    zassert_equal(out[0].seq, 1);
+    zassert_equal(out[0].pack_cv, 1750);
+    zassert_equal(out[0].temp, 215);
+    // Collected entries are clean until the next update
+    zassert_equal(collect_all(out, TABLE_SIZE), 0);
+
+    entry.seq = 2;
+    entry.pack_cv = 1700;
+    zassert_ok(pack_table_update(&entry));
+    zassert_equal(pack_table_count(), 1);
+    zassert_equal(collect_all(out, TABLE_SIZE), 1);
+    zassert_equal(out[0].seq, 2);
+    zassert_equal(out[0].pack_cv, 1700);
+}
+
+ZTEST(pack_table, test_duplicate)
+{
+    bt_addr_le_t addr = addr_at(5, 0);
+    struct pack_entry entry = make_entry(&addr, 7, OLD_MS);
+    struct pack_entry out[TABLE_SIZE];
+
+    zassert_ok(pack_table_update(&entry));
+    zassert_equal(collect_all(out, TABLE_SIZE), 1);
+
+    // A repeated frame is not forwarded again but keeps the pack alive
+    entry.last_seen_ms = NOW_MS;
+    zassert_equal(pack_table_update(&entry), -EALREADY);
+    zassert_equal(collect_all(out, TABLE_SIZE), 0);
+    zassert_equal(pack_table_expire(NOW_MS, TIMEOUT_MS), 0);
+    zassert_equal(pack_table_count(), 1);
+}
+
+ZTEST(pack_table, test_full)
+{
+    struct pack_entry entry;
+    bt_addr_le_t addr;
+
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        addr = addr_at(i % TABLE_SIZE, i / TABLE_SIZE);
+        entry = make_entry(&addr, i, NOW_MS);
+        zassert_ok(pack_table_update(&entry), "entry %zu refused", i);
+    }
+    zassert_equal(pack_table_count(), MAX_ENTRIES);
+
+    addr = addr_at(0, 1);
+    entry = make_entry(&addr, 100, NOW_MS);
+    zassert_equal(pack_table_update(&entry), -ENOMEM);
+    zassert_equal(pack_table_count(), MAX_ENTRIES);
+
+    // Packs already in the table are still updated
+    addr = addr_at(0, 0);
+    entry = make_entry(&addr, 101, NOW_MS);
+    zassert_ok(pack_table_update(&entry));
+}
+
+ZTEST(pack_table, test_collect_batches)
+{
+    struct pack_entry out[TABLE_SIZE];
+    uint32_t seen = 0;
+    size_t n;
+
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        bt_addr_le_t addr = addr_at((i * 5) % TABLE_SIZE, 0);
+        struct pack_entry entry = make_entry(&addr, i, NOW_MS);
+
+        zassert_ok(pack_table_update(&entry));
+    }
+
+    n = collect_all(out, 2);
+    zassert_equal(n, MAX_ENTRIES);
+    for (size_t i = 0; i < n; i++) {
+        zassert_false(seen & BIT(out[i].seq), "seq %u collected twice", out[i].seq);
+        seen |= BIT(out[i].seq);
+    }
+    zassert_equal(seen, BIT(MAX_ENTRIES) - 1);
+}
+
+ZTEST(pack_table, test_expire_shifts_back)
+{
+    struct pack_entry entries[5];
+    bt_addr_le_t addr;
+
+    // Four packs homed at slot 14 fill slots 14, 15, 0 and 1, the fifth one homed at slot 0
+    // is pushed to slot 2
+    for (size_t i = 0; i < 4; i++) {
+        addr = addr_at(TABLE_SIZE - 2, i);
+        entries[i] = make_entry(&addr, i, NOW_MS);
+    }
+    addr = addr_at(0, 0);
+    entries[4] = make_entry(&addr, 4, NOW_MS);
+    // Expire the entries of slots 15 and 0
+    entries[1].last_seen_ms = OLD_MS;
+    entries[2].last_seen_ms = OLD_MS;
+
+    for (size_t i = 0; i < ARRAY_SIZE(entries); i++) {
+        zassert_ok(pack_table_update(&entries[i]));
+    }
+
+    zassert_equal(pack_table_expire(NOW_MS, TIMEOUT_MS), 2);
+    zassert_equal(pack_table_count(), 3);
+
+    // The remaining packs are still found, across the end of the table
+    assert_stored(&entries[0]);
+    assert_stored(&entries[3]);
+    assert_stored(&entries[4]);
+}
+
+ZTEST(pack_table, test_expire_all)
+{
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        bt_addr_le_t addr = addr_at(TABLE_SIZE - 1, i);
+        struct pack_entry entry = make_entry(&addr, i, i % 2 ? OLD_MS : NOW_MS);
+
+        zassert_ok(pack_table_update(&entry));
+    }
+
+    zassert_equal(pack_table_expire(NOW_MS, TIMEOUT_MS), MAX_ENTRIES / 2);
+    zassert_equal(pack_table_count(), MAX_ENTRIES - MAX_ENTRIES / 2);
+
+    for (size_t i = 0; i < MAX_ENTRIES; i += 2) {
+        bt_addr_le_t addr = addr_at(TABLE_SIZE - 1, i);
+        struct pack_entry entry = make_entry(&addr, i, NOW_MS);
+
+        assert_stored(&entry);
+    }
+}
+
+ZTEST_SUITE(pack_table, NULL, NULL, NULL, empty_table, NULL);
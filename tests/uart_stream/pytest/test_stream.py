@@ -0,0 +1,93 @@
+#
+# Reads the scan stream of the native_sim image from its pty, decodes the COBS/CRC frames
+# (src/output/frame.h) and checks that every scan arrives once, in order and intact.
+#
+
+import os
+import re
+import select
+import struct
+import time
+import tty
+
+from twister_harness import DeviceAdapter
+
+SCAN_COUNT = 2000          # As in src/main.c
+FRAME_SCAN = 0x01
+SCAN_RECORD = struct.Struct("<HIh8H")
+TIMEOUT_S = 30
+
+
+def crc16_ccitt(data: bytes) -> int:
+    """CRC-16/CCITT, init 0xFFFF, reflected, as frame_encode() computes it."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def cobs_decode(data: bytes) -> bytes:
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        if code == 0 or pos + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[pos + 1:pos + code]
+        pos += code
+        if code != 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def expected_scan(n: int) -> tuple:
+    return (n, n * 1000, n % 500) + tuple(300 + n % 100 + i for i in range(8))
+
+
+def test_stream(dut: DeviceAdapter):
+    lines = dut.readlines_until(regex="UART stream ready", timeout=10)
+    ptys = [m.group(1) for m in (re.search(r"uart2 connected to pseudotty: (\S+)", line)
+                                 for line in lines) if m]
+    assert ptys, "pty of the stream UART not found"
+
+    fd = os.open(ptys[0], os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+
+    pending = b""
+    scans = []
+    bad = 0
+    deadline = time.monotonic() + TIMEOUT_S
+    try:
+        while len(scans) < SCAN_COUNT and time.monotonic() < deadline:
+            if not select.select([fd], [], [], 1)[0]:
+                continue
+            pending += os.read(fd, 4096)
+            *frames, pending = pending.split(b"\0")
+            for frame in frames:
+                try:
+                    raw = cobs_decode(frame)
+                except ValueError:
+                    bad += 1
+                    continue
+                # The CRC residue over type, payload and little-endian CRC is zero
+                if (len(raw) != 1 + SCAN_RECORD.size + 2 or raw[0] != FRAME_SCAN or
+                        crc16_ccitt(raw)):
+                    bad += 1
+                    continue
+                scans.append(SCAN_RECORD.unpack(raw[1:-2]))
+    finally:
+        os.close(fd)
+
+    assert bad == 0, f"{bad} frames failed to decode"
+    assert len(scans) == SCAN_COUNT, f"{len(scans)} of {SCAN_COUNT} scans received"
+    for n, scan in enumerate(scans):
+        assert scan == expected_scan(n), f"scan {n} decoded as {scan}"
+
+    lines = dut.readlines_until(regex="UART stream done", timeout=10)
+    stats = re.search(r"frames (\d+) dropped (\d+) transfers (\d+)", lines[-1])
+    assert stats, lines[-1]
+    frames, dropped, transfers = map(int, stats.groups())
+    print(f"{frames} frames, {dropped} dropped, {transfers} transfers")
+    assert frames == SCAN_COUNT and dropped == 0